@@ -0,0 +1,148 @@
+/*
+ * This example runs a physics simulation and a world of entities without
+ * opening a window and prints a hash of their final state. The world's
+ * entities fall asleep and move between update frequency buckets, and the
+ * order they're updated in is part of the hash too. When v2d and this example are both built with
+ * V2D_DETERMINISTIC, the hash should be the same for every compiler,
+ * optimization level and CPU, so it can be used to check that two builds of a
+ * game will stay in lockstep:
+ *
+ *   make CPPFLAGS=-DV2D_DETERMINISTIC && make -C examples CPPFLAGS=-DV2D_DETERMINISTIC determinism
+ *   examples/determinism
+ *
+ * Passing a hash printed by another build as an argument makes the program
+ * exit with an error if the hashes differ.
+ */
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <v2d.h>
+
+#define TICKS 600
+#define DT (1 / 60.0)
+
+static uint64_t hash = UINT64_C(14695981039346656037);
+
+// Hash the exact bits of a number, so that even the smallest difference changes the result
+static void hash_real(double x) {
+	unsigned char bytes[sizeof x];
+	memcpy(bytes, &x, sizeof x);
+	for (size_t i = 0; i < sizeof x; i++) {
+		hash = (hash ^ bytes[i]) * UINT64_C(1099511628211);
+	}
+}
+
+static void hash_vec(v2d_vec_t v) {
+	hash_real(v2dvx(v));
+	hash_real(v2dvy(v));
+}
+
+// An entity that wanders around, napping now and then and updating less often the further it is from the middle
+struct walker {
+	v2d_ent_cb_t cb;
+	v2d_world_t *world;
+	int id;
+	v2d_vec_t pos, vel;
+	double age;
+};
+
+static void walker_update(v2d_ent_t *ent, double dt) {
+	struct walker *w = ent;
+
+	// Which entities update, and in which order, depends on the world's timers and LOD staggering
+	hash_real(w->id);
+	hash_real(dt);
+
+	w->age += dt;
+	w->pos += w->vel * dt;
+	if (v2d_vec_mag(w->pos) > 50) w->vel = -w->vel;
+
+	v2d_world_set_lod(w->world, w, v2d_vec_mag(w->pos) / 15);
+	if ((int)(w->age * 10) % (7 + w->id % 5) == 0) v2d_world_sleep(w->world, w, 0.05 * (1 + w->id % 4));
+}
+
+int main(int argc, char *argv[]) {
+	v2d_physics_t *phys = v2d_physics_new();
+	if (!phys) {
+		fprintf(stderr, "v2d_physics_new: %s\n", v2d_errtext);
+		return 1;
+	}
+
+	// A floor, with a pile of boxes and balls dropped onto it
+	v2d_physics_add(phys, &(struct v2d_body_def){
+		.shape = V2D_SHAPE_RECT_LIT(v2d_vec(-50, 0), v2d_vec(100, 2)),
+		.pos = v2d_vec(0, -2),
+	});
+	for (int i = 0; i < 100; i++) {
+		v2d_vec_t pos = v2d_vec((i % 10) * 3.1 - 15, 2 + (i / 10) * 2.7);
+		v2d_shape_t shape = i % 2
+			? V2D_SHAPE_CIRCLE_LIT(v2d_vec(0, 0), 1)
+			: V2D_SHAPE_RECT_LIT(v2d_vec(-1, -1), v2d_vec(2, 2));
+		v2d_physics_add(phys, &(struct v2d_body_def){
+			.shape = shape,
+			.pos = pos,
+			.vel = v2d_vec((i % 7) - 3, 0),
+			.mass = 1 + (i % 3),
+			.restitution = 0.3,
+			.friction = 0.5,
+		});
+	}
+	phys->gravity = v2d_vec(0, -9.81);
+
+	// A spinning transformation, which exercises v2d's own sin and cos
+	v2d_transform_t tr = v2d_transform_new();
+
+	v2d_world_t *world = v2d_world_new();
+	if (!world) {
+		fprintf(stderr, "v2d_world_new: %s\n", v2d_errtext);
+		return 1;
+	}
+	static struct walker walkers[200];
+	for (int i = 0; i < 200; i++) {
+		walkers[i] = (struct walker){
+			.cb = {.update = walker_update},
+			.world = world,
+			.id = i,
+			.pos = v2d_vec((i % 20) * 4.3 - 40, (i / 20) * 7.1 - 30),
+			.vel = v2d_vec((i % 9) - 4, (i % 5) - 2),
+		};
+		v2d_world_add_entity(world, &walkers[i]);
+	}
+
+	for (int tick = 0; tick < TICKS; tick++) {
+		v2d_physics_step(phys, DT);
+		v2d_loop_update_world(world, DT);
+		v2d_tr_rotate(&tr, 0.1 * tick);
+		v2d_tr_translate(&tr, v2d_vec(0.5, 0));
+	}
+
+	for (size_t i = 0; i < phys->n_bodies; i++) {
+		hash_vec(phys->pos[i]);
+		hash_vec(phys->vel[i]);
+	}
+	hash_vec(tr.mul);
+	hash_vec(tr.add);
+	for (int i = 0; i < 200; i++) {
+		hash_vec(walkers[i].pos);
+		hash_real(walkers[i].age);
+		hash_real(v2d_world_awake(world, &walkers[i]));
+	}
+	hash_real(world->time);
+
+#ifdef V2D_DETERMINISTIC
+	printf("%016" PRIx64 "\n", hash);
+#else
+	printf("%016" PRIx64 " (built without V2D_DETERMINISTIC, so other builds may differ)\n", hash);
+#endif
+
+	v2d_physics_free(phys);
+	v2d_world_free(world);
+
+	if (argc > 1 && strtoull(argv[1], NULL, 16) != hash) {
+		fprintf(stderr, "Hash does not match %s\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
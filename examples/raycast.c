@@ -1,6 +1,9 @@
 /*
  * This example demonstrates v2d's ray-to-shape collision detection
  * 
+ * Every shape the ray touches is highlighted, and the first one it hits,
+ * found with v2d_world_raycast, is highlighted in a different color
+ * 
  * A lot of this code is copied from collide.c
  */
 #include <stdbool.h>
@@ -22,7 +25,7 @@ v2d_action_trigger_t triggers[] = {
 
 struct shape {
 	v2d_ent_cb_t cb;
-	bool colliding;
+	bool colliding, first;
 	enum {
 		SHAPE_RECT,
 		SHAPE_CIRCLE,
@@ -36,7 +39,8 @@ struct shape {
 static void shape_render(v2d_ent_t *ent, v2d_render_t *ren) {
 	struct shape *s = ent;
 
-	if (s->colliding) v2d_render_rgb(ren, 1, 0.3, 0.7);
+	if (s->first) v2d_render_rgb(ren, 1, 0.8, 0.2);
+	else if (s->colliding) v2d_render_rgb(ren, 1, 0.3, 0.7);
 	else v2d_render_rgb(ren, 1, 1, 1);
 
 	switch (s->type) {
@@ -89,7 +93,22 @@ static void ray_update(v2d_ent_t *ent, double dt) {
 	for (struct shape *v2d_world_iterate(ent, r->world)) {
 		if ((void *)ent == r) continue;
 		ent->colliding = shape_raycast(r, ent);
+		ent->first = false;
 	}
+
+	// The ray has no shape, so it never finds itself
+	struct shape *first = v2d_world_raycast(r->world, r->ray, NULL, NULL);
+	if (first) first->first = true;
+}
+
+static v2d_shape_t shape_get(struct shape *s) {
+	switch (s->type) {
+	case SHAPE_RECT:
+		return V2D_SHAPE_RECT_LIT(s->shape.rect.pos, s->shape.rect.dim);
+	case SHAPE_CIRCLE:
+		return V2D_SHAPE_CIRCLE_LIT(s->shape.circ.pos, s->shape.circ.rad);
+	}
+	return V2D_SHAPE_CIRCLE_LIT(v2d_vec(0, 0), 0);
 }
 
 int ex_main(SDL_Window *win) {
@@ -98,7 +117,7 @@ int ex_main(SDL_Window *win) {
 
 #define SHAPE_rect SHAPE_RECT
 #define SHAPE_circ SHAPE_CIRCLE
-#define SHAPE(type, ...) {{shape_render, NULL, NULL}, false, SHAPE_##type, {.type = {__VA_ARGS__}}}
+#define SHAPE(type, ...) {{shape_render, NULL, NULL}, false, false, SHAPE_##type, {.type = {__VA_ARGS__}}}
 
 	struct shape rect1 = SHAPE(rect, v2d_vec(2, -1), v2d_vec(2, 1));
 	v2d_world_add_entity(world, &rect1);
@@ -112,6 +131,17 @@ int ex_main(SDL_Window *win) {
 	struct shape circ2 = SHAPE(circ, v2d_vec(1, -1), 0.4);
 	v2d_world_add_entity(world, &circ2);
 
+	struct shape *shapes[] = {&rect1, &rect2, &circ1, &circ2};
+	for (size_t i = 0; i < sizeof shapes / sizeof *shapes; i++) {
+		v2d_world_set_shape(world, shapes[i], shape_get(shapes[i]));
+	}
+
+	// This ray passes through circ2 and ends inside rect1, so circ2 should be the first shape it hits
+	if (v2d_world_raycast(world, (v2d_ray_t){v2d_vec(0, -0.8), v2d_vec(3, 0)}, NULL, NULL) != &circ2) {
+		fprintf(stderr, "v2d_world_raycast: found the wrong shape\n");
+		return 1;
+	}
+
 	struct ray ray = {
 		{ray_render, ray_update, NULL},
 		&actions[0], &actions[1],
@@ -17,21 +17,62 @@
 typedef struct v2d_action v2d_action_t;
 typedef struct v2d_action_trigger v2d_action_trigger_t;
 typedef struct v2d_action_dispatcher v2d_action_dispatcher_t;
+typedef struct v2d_allocator v2d_allocator_t;
+typedef struct v2d_arena v2d_arena_t;
+typedef struct v2d_asset v2d_asset_t;
+typedef struct v2d_assets v2d_assets_t;
+typedef struct v2d_broad v2d_broad_t;
 typedef void v2d_ent_t;
 typedef struct v2d_ent_cb v2d_ent_cb_t;
+typedef struct v2d_emitter v2d_emitter_t;
 typedef struct v2d_gameloop_config v2d_gameloop_config_t;
+typedef struct v2d_jobs v2d_jobs_t;
+typedef struct v2d_layers v2d_layers_t;
+typedef struct v2d_nav v2d_nav_t;
 typedef struct v2d_world v2d_world_t;
 typedef struct v2d_obj v2d_obj_t;
+typedef struct v2d_pacer v2d_pacer_t;
+typedef struct v2d_physics v2d_physics_t;
+typedef struct v2d_pipeline v2d_pipeline_t;
+typedef struct v2d_pool v2d_pool_t;
 typedef struct v2d_render v2d_render_t;
+typedef struct v2d_repl_client v2d_repl_client_t;
+typedef struct v2d_repl_server v2d_repl_server_t;
+typedef struct v2d_rollback v2d_rollback_t;
+typedef struct v2d_snap v2d_snap_t;
+typedef struct v2d_static v2d_static_t;
+typedef struct v2d_stats v2d_stats_t;
+typedef struct v2d_timer v2d_timer_t;
+typedef struct v2d_timer_wheel v2d_timer_wheel_t;
+typedef struct v2d_visibility v2d_visibility_t;
 
 #include "v2d/action.h"
+#include "v2d/alloc.h"
+#include "v2d/asset.h"
+#include "v2d/broad.h"
 #include "v2d/collide.h"
 #include "v2d/entity.h"
 #include "v2d/error.h"
 #include "v2d/gameloop.h"
+#include "v2d/jobs.h"
+#include "v2d/layer.h"
+#include "v2d/nav.h"
+#include "v2d/pacer.h"
+#include "v2d/particle.h"
+#include "v2d/physics.h"
+#include "v2d/pipeline.h"
+#include "v2d/profile.h"
 #include "v2d/render.h"
+#include "v2d/replicate.h"
+#include "v2d/rollback.h"
+#include "v2d/snapshot.h"
+#include "v2d/static.h"
+#include "v2d/stats.h"
+#include "v2d/timer.h"
 #include "v2d/transform.h"
+#include "v2d/vec2f.h"
 #include "v2d/vector.h"
+#include "v2d/visibility.h"
 #include "v2d/warn.h"
 #include "v2d/world.h"
 
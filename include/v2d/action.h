@@ -19,13 +19,13 @@
 // `value` is a vector. For triggers it will be (0, 0) or (1, 0). For controller vectors it will be between (-1, -1) and (1, 1). For mouse vectors it can be anything.
 //  `value.s` is the x component of that vector. This can be used like a boolean for trigger actions
 //  `value.pos` is the vector itself
-//  `value.xy` is an array of 2 doubles: the x component followed by the y component
+//  `value.xy` is an array of 2 v2d_real_t: the x component followed by the y component
 struct v2d_action {
 	const char *id;
 	union {
-		double s;
+		v2d_real_t s;
 		v2d_vec_t pos;
-		double xy[2];
+		v2d_real_t xy[2];
 	} value;
 };
 
@@ -0,0 +1,109 @@
+/* v2d/alloc.h
+ *
+ * All of v2d's memory allocation goes through v2d_alloc and v2d_free, which
+ * use a pluggable allocator. By default this is malloc and free, but you can
+ * replace it with your own by setting v2d_allocator before calling any other
+ * v2d functions.
+ *
+ * This file also provides two specialised allocators that avoid calling the
+ * underlying allocator for every allocation:
+ *  - Pools hand out blocks of a single fixed size. Allocating and freeing a
+ *    block is O(1) and usually just pops or pushes a free list.
+ *  - Arenas hand out blocks of any size by bumping a pointer. Individual
+ *    blocks cannot be freed; instead the whole arena is reset at once.
+ *
+ */
+#ifndef _V2D_ALLOC_H
+#define _V2D_ALLOC_H
+
+#include <stddef.h>
+#include "v2d.h"
+
+struct v2d_allocator {
+	// Allocate `size` bytes, or return NULL on failure
+	void *(*alloc)(void *ctx, size_t size);
+	// Free memory returned by `alloc`
+	void (*free)(void *ctx, void *ptr);
+	// Passed as the first argument to `alloc` and `free`
+	void *ctx;
+};
+
+// The allocator used by v2d. Defaults to malloc and free
+// Don't change this while anything allocated by v2d still exists
+extern v2d_allocator_t v2d_allocator;
+
+// Allocate memory using v2d_allocator
+// Raises V2D_ERROR_MEMORY and returns NULL on failure
+void *v2d_alloc(size_t size);
+
+// Free memory allocated with v2d_alloc. Does nothing if ptr is NULL
+void v2d_free(void *ptr);
+
+// Make sure an array has room for at least n elements of size elem, growing it by doubling if it doesn't
+// `array` is a pointer to the array pointer, which must be NULL or allocated with v2d_alloc
+// `cap` is a pointer to the number of elements the array currently has room for
+// Returns false on failure, leaving the array untouched
+_Bool v2d_array_reserve(void *array, size_t *cap, size_t elem, size_t n);
+
+// --- Pools ---
+
+struct v2d_pool_chunk;
+
+struct v2d_pool {
+	size_t block_size;
+	size_t chunk_blocks; // The number of blocks allocated at once when the pool runs out
+	void *free_list;
+	struct v2d_pool_chunk *chunks;
+};
+
+// Initialize a pool of blocks of the specified size
+// No memory is allocated until the first block is requested
+void v2d_pool_init(v2d_pool_t *pool, size_t block_size, size_t chunk_blocks);
+
+// Free all the memory used by a pool, including any blocks still in use
+void v2d_pool_destroy(v2d_pool_t *pool);
+
+// Allocate a block from a pool
+// Raises V2D_ERROR_MEMORY and returns NULL on failure
+void *v2d_pool_alloc(v2d_pool_t *pool);
+
+// Return a block to the pool it was allocated from. Does nothing if block is NULL
+void v2d_pool_free(v2d_pool_t *pool, void *block);
+
+// Typed wrappers, for pools of a single object type
+// Usage:
+//  v2d_pool_t bullets;
+//  v2d_pool_init_type(&bullets, struct bullet, 1024);
+//  struct bullet *b = v2d_pool_new(&bullets, struct bullet);
+#define v2d_pool_init_type(pool, type, chunk_blocks) (v2d_pool_init((pool), sizeof (type), (chunk_blocks)))
+#define v2d_pool_new(pool, type) ((type *)v2d_pool_alloc(pool))
+
+// --- Arenas ---
+
+struct v2d_arena_chunk;
+
+struct v2d_arena {
+	size_t chunk_size; // The minimum size of each chunk of memory requested from v2d_allocator
+	struct v2d_arena_chunk *chunks, *cur;
+};
+
+// Initialize an arena
+// No memory is allocated until the first allocation is requested
+void v2d_arena_init(v2d_arena_t *arena, size_t chunk_size);
+
+// Free all the memory used by an arena
+void v2d_arena_destroy(v2d_arena_t *arena);
+
+// Allocate memory from an arena. The memory is suitably aligned for any type
+// Raises V2D_ERROR_MEMORY and returns NULL on failure
+void *v2d_arena_alloc(v2d_arena_t *arena, size_t size);
+
+// Free every allocation made from an arena at once
+// The arena keeps its memory, so it can be reused without calling v2d_allocator again
+void v2d_arena_reset(v2d_arena_t *arena);
+
+// An arena for temporary data that only needs to live for one frame, such as collision pair lists
+// The built-in game loop resets this at the start of every frame. If you write your own game loop, you should do the same
+extern v2d_arena_t v2d_frame_arena;
+
+#endif
@@ -0,0 +1,123 @@
+/* v2d/asset.h
+ *
+ * The asset manager loads textures while the game is running, so they don't
+ * all have to be loaded before the game loop starts. Loading a texture is
+ * split into two halves:
+ *  - Decoding the image file, which is done by background loader threads
+ *  - Uploading the decoded image into an SDL texture, which has to happen on
+ *    the thread that owns the renderer. v2d_assets_update does this once per
+ *    frame, and stops when it runs out of time, so a burst of loads can't
+ *    cause a long frame
+ *
+ * Until a texture is ready, v2d_asset_texture returns a placeholder instead,
+ * so the game can start drawing it straight away.
+ *
+ * Handles are reference counted. Loading the same path twice gives the same
+ * handle, and every load must be matched by a release. Textures are kept in
+ * least recently used order, and when they take up more memory than the cap
+ * allows, the ones that have gone longest without being drawn are evicted.
+ * An evicted texture whose handle is still held is loaded again the next
+ * time it is drawn, so only the textures in view need to fit in memory.
+ * Released textures stay cached until they are evicted, in case they're
+ * loaded again.
+ *
+ * Images are decoded with SDL_LoadBMP.
+ *
+ */
+#ifndef _V2D_ASSET_H
+#define _V2D_ASSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "v2d.h"
+
+// The default time spent uploading textures per frame, in seconds
+#define V2D_ASSETS_UPLOAD_BUDGET 0.002
+
+enum v2d_asset_state {
+	V2D_ASSET_UNLOADED, // Not loaded yet, or evicted
+	V2D_ASSET_QUEUED, // Waiting for a loader thread
+	V2D_ASSET_DECODING,
+	V2D_ASSET_DECODED, // Waiting to be uploaded
+	V2D_ASSET_READY,
+	V2D_ASSET_FAILED,
+};
+
+struct v2d_asset {
+	char *path;
+
+	// These are shared with the loader threads, so they're protected by the manager's lock
+	enum v2d_asset_state state;
+	SDL_Surface *surface;
+	v2d_asset_t *queue_next;
+
+	// These are only used by the thread that owns the renderer
+	SDL_Texture *texture;
+	size_t bytes; // An estimate of the texture's size in memory
+	unsigned refs;
+	uint64_t used; // The frame the texture was last drawn
+	v2d_asset_t *lru_prev, *lru_next;
+	v2d_asset_t *hash_next;
+};
+
+struct v2d_assets {
+	v2d_render_t *render;
+
+	// Returned in place of textures that aren't ready. It may be replaced, but is freed along with the manager
+	SDL_Texture *placeholder;
+
+	SDL_Thread **threads;
+	unsigned n_threads;
+
+	SDL_mutex *lock;
+	SDL_cond *wake;
+	_Bool quit;
+
+	// Queues of assets waiting to be decoded and uploaded, oldest first. Protected by `lock`
+	v2d_asset_t *decode_head, *decode_tail;
+	v2d_asset_t *upload_head, *upload_tail;
+
+	// Every asset, chained by a hash of its path
+	v2d_asset_t **buckets;
+	size_t n_buckets, n_assets;
+
+	// Assets with textures, most recently used first
+	v2d_asset_t *lru_head, *lru_tail;
+
+	// The memory used by textures and the most that's allowed, in bytes
+	size_t memory, memory_cap;
+
+	// The time v2d_assets_update may spend uploading textures, in seconds. At least one is always uploaded
+	double upload_budget;
+
+	// Incremented by every call to v2d_assets_update
+	uint64_t frame;
+};
+
+// Create an asset manager with `n_threads` loader threads, or one if n_threads is 0
+// Returns NULL on failure
+v2d_assets_t *v2d_assets_new(v2d_render_t *render, unsigned n_threads, size_t memory_cap);
+
+// Stop the loader threads and free every texture. All handles become invalid
+void v2d_assets_free(v2d_assets_t *assets);
+
+// Get a handle to the texture at `path`, starting to load it if it isn't already
+// Returns NULL on failure
+v2d_asset_t *v2d_assets_load(v2d_assets_t *assets, const char *path);
+
+// Release a handle returned by v2d_assets_load
+void v2d_assets_release(v2d_assets_t *assets, v2d_asset_t *asset);
+
+// Return the current state of an asset
+enum v2d_asset_state v2d_asset_state(v2d_assets_t *assets, v2d_asset_t *asset);
+
+// Return an asset's texture, or the placeholder if it isn't ready, and mark it as used this frame
+// If the texture was evicted, it starts loading again
+SDL_Texture *v2d_asset_texture(v2d_assets_t *assets, v2d_asset_t *asset);
+
+// Upload decoded textures until the time budget runs out, then evict textures until memory use is under the cap
+// Textures used since the last call are never evicted. This must be called once per frame, on the thread that owns the renderer
+void v2d_assets_update(v2d_assets_t *assets);
+
+#endif
@@ -0,0 +1,172 @@
+/* v2d/broad.h
+ *
+ * Broad-phase collision detection quickly finds pairs of shapes that might be
+ * colliding, so the more expensive narrow-phase tests in v2d/collide.h only
+ * need to be run on those pairs.
+ *
+ * Each shape is represented by a proxy, which stores the shape and its
+ * bounding box. v2d uses the "sweep and prune" algorithm: proxies are kept
+ * sorted by the left edge of their bounding boxes, so that overlapping boxes
+ * can be found by sweeping along the x axis. Objects don't usually move far
+ * between frames, so the order changes very little and re-sorting it takes
+ * close to O(n) time.
+ *
+ * Proxies can be marked as inactive, for example when they belong to
+ * sleeping or static objects. Pairs of two inactive proxies are never
+ * reported, and inactive proxies are only visited when an active proxy is
+ * near them.
+ *
+ * The same sorted order answers spatial queries: which proxies overlap a
+ * box, which are within a radius of a point, and which are nearest to a
+ * point. Queries write their results into arrays supplied by the caller and
+ * never allocate. The nearest-neighbour search sweeps outwards from the
+ * point in both directions and stops as soon as nothing further along the
+ * x axis could be closer than what it has already found.
+ *
+ * Each proxy has a filter, which rules out whole categories of pairs before
+ * any shapes are tested. A proxy belongs to the categories set in its
+ * `category` bits and only pairs with proxies in the categories set in its
+ * `mask` bits; both proxies must agree for a pair to be reported. Proxies
+ * that share a non-zero group always pair if the group is positive and
+ * never pair if it is negative, whatever their masks say. Queries and
+ * raycasts can also be given a filter, in which case they only find proxies
+ * in a category set in the filter's mask, and skip proxies in the filter's
+ * group if it is negative.
+ *
+ */
+#ifndef _V2D_BROAD_H
+#define _V2D_BROAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "v2d.h"
+#include "v2d/collide.h"
+
+// Returned instead of a proxy ID on failure
+#define V2D_PROXY_NONE UINT32_MAX
+
+typedef struct {
+	uint32_t category, mask;
+	int32_t group;
+} v2d_filter_t;
+
+// The filter of new proxies, which is in category 1 and pairs with everything
+#define V2D_FILTER_DEFAULT ((v2d_filter_t){1, UINT32_MAX, 0})
+
+// Return true if two proxies with these filters should be paired
+static inline _Bool v2d_filter_pair(v2d_filter_t a, v2d_filter_t b) {
+	if (a.group && a.group == b.group) return a.group > 0;
+	return (a.category & b.mask) && (b.category & a.mask);
+}
+
+// Return true if a query with filter `query` should find a proxy with filter `proxy`
+static inline _Bool v2d_filter_query(v2d_filter_t query, v2d_filter_t proxy) {
+	if (query.group < 0 && query.group == proxy.group) return 0;
+	return (proxy.category & query.mask) != 0;
+}
+
+struct v2d_broad_proxy {
+	v2d_shape_t shape;
+	// The corners of the shape's bounding box
+	v2d_vec_t min, max;
+	// User data
+	void *data;
+
+	v2d_filter_t filter;
+
+	// The value of the broad phase's stamp when the proxy was last added or moved
+	uint32_t moved;
+
+	_Bool alive, active;
+};
+
+// A pair of proxy IDs. `a` is always less than `b`
+typedef struct {
+	uint32_t a, b;
+} v2d_pair_t;
+
+struct v2d_broad {
+	// Proxies, indexed by ID. Slots of deleted proxies are reused
+	struct v2d_broad_proxy *proxies;
+	size_t n_proxies, cap_proxies;
+
+	// IDs that can be reused, and IDs that can be reused once `order` has been cleaned up
+	uint32_t *free_ids, *dead_ids;
+	size_t n_free, cap_free, n_dead, cap_dead;
+
+	// IDs of proxies, sorted by the x coordinate of their bounding box's left edge
+	uint32_t *order;
+	size_t n_order, cap_order;
+
+	// The widest bounding box, used to limit how far back a sweep needs to look
+	v2d_real_t max_width;
+
+	// The pairs found by the last call to v2d_broad_pairs
+	v2d_pair_t *pairs;
+	size_t n_pairs, cap_pairs;
+
+	// Incremented by every call to v2d_broad_pairs, so that a proxy's `moved` stamp tells which calls it has moved since
+	uint32_t stamp;
+};
+
+// Initialize a broad phase
+void v2d_broad_init(v2d_broad_t *broad);
+
+// Free all the memory used by a broad phase
+void v2d_broad_destroy(v2d_broad_t *broad);
+
+// Add a shape to the broad phase. New proxies are active
+// Returns the new proxy's ID, or V2D_PROXY_NONE on failure
+uint32_t v2d_broad_add(v2d_broad_t *broad, v2d_shape_t shape, void *data);
+
+// Remove a proxy from the broad phase. Its ID may be reused by later calls to v2d_broad_add
+void v2d_broad_del(v2d_broad_t *broad, uint32_t id);
+
+// Update a proxy's shape, for example after it has moved
+void v2d_broad_move(v2d_broad_t *broad, uint32_t id, v2d_shape_t shape);
+
+// Mark a proxy as active or inactive
+void v2d_broad_set_active(v2d_broad_t *broad, uint32_t id, _Bool active);
+
+// Change which proxies a proxy pairs with
+void v2d_broad_set_filter(v2d_broad_t *broad, uint32_t id, v2d_filter_t filter);
+
+// Bring the sorted order up to date. This is done automatically by v2d_broad_pairs
+void v2d_broad_update(v2d_broad_t *broad);
+
+// Find every pair of proxies whose bounding boxes overlap and whose filters allow them to pair, excluding pairs where both proxies are inactive
+// The returned array is owned by the broad phase, and is valid until the next call to this function
+// Returns NULL and sets *n_pairs to 0 on failure
+v2d_pair_t *v2d_broad_pairs(v2d_broad_t *broad, size_t *n_pairs);
+
+// In the following queries, `filter` may be NULL to find proxies of every category
+
+// Find every proxy whose bounding box overlaps the box from `min` to `max`, active or not
+// Up to `max_out` IDs are written into `out`
+// Returns the total number of proxies found, which may be more than `max_out`
+size_t v2d_broad_query(v2d_broad_t *broad, v2d_vec_t min, v2d_vec_t max, const v2d_filter_t *filter, uint32_t *out, size_t max_out);
+
+// Called by v2d_broad_visit for each proxy found. Returning false stops the query
+typedef _Bool (*v2d_broad_visit_t)(v2d_broad_t *broad, uint32_t id, void *ctx);
+
+// Call `fn` for every proxy whose bounding box overlaps the box from `min` to `max`, active or not
+// The broad phase must not be modified by `fn`
+void v2d_broad_visit(v2d_broad_t *broad, v2d_vec_t min, v2d_vec_t max, const v2d_filter_t *filter, v2d_broad_visit_t fn, void *ctx);
+
+// Find every proxy whose shape is within `radius` of `center`, active or not
+// Up to `max_out` IDs are written into `out`
+// Returns the total number of proxies found, which may be more than `max_out`
+size_t v2d_broad_query_radius(v2d_broad_t *broad, v2d_vec_t center, double radius, const v2d_filter_t *filter, uint32_t *out, size_t max_out);
+
+// Find the `k` proxies whose shapes are nearest to `point`, ignoring any further away than `max_dist`, which may be infinite
+// Results are written in order of increasing distance. `dist` receives the distances and must have room for `k` elements
+// `ids` and `data` receive the proxies' IDs and user data, and may each be NULL if they aren't needed
+// Returns the number of proxies found, which is at most `k`
+size_t v2d_broad_nearest(v2d_broad_t *broad, v2d_vec_t point, double max_dist, const v2d_filter_t *filter, size_t k, uint32_t *ids, void **data, double *dist);
+
+// Find the first proxy hit by a ray, which runs from r.pos to r.pos + r.dir
+// If `t` is not NULL, it receives the fraction of the ray's length at which the proxy was hit
+// Returns the proxy's ID, or V2D_PROXY_NONE if nothing was hit
+uint32_t v2d_broad_raycast(v2d_broad_t *broad, v2d_ray_t ray, const v2d_filter_t *filter, double *t);
+
+#endif
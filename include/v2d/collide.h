@@ -4,7 +4,8 @@
  * implements some basic collision primitives that should allow you to model
  * most situations with a decent amount of accuracy.
  *
- * This file only implements narrow-phase collision detection.
+ * This file only implements narrow-phase collision detection. For broad-phase
+ * collision detection, see v2d/broad.h
  *
  */
 #ifndef _V2D_COLLIDE_H
@@ -27,6 +28,32 @@ typedef struct {
 	v2d_vec_t pos, dir;
 } v2d_ray_t;
 
+// A shape of any type
+typedef struct {
+	enum v2d_shape_type {
+		V2D_SHAPE_CIRCLE,
+		V2D_SHAPE_RECT,
+	} type;
+	union {
+		v2d_circle_t circle;
+		v2d_rect_t rect;
+	} s;
+} v2d_shape_t;
+
+// Create shapes for use as expressions
+#define V2D_SHAPE_CIRCLE_LIT(pos, rad) ((v2d_shape_t){V2D_SHAPE_CIRCLE, {.circle = {(pos), (rad)}}})
+#define V2D_SHAPE_RECT_LIT(pos, dim) ((v2d_shape_t){V2D_SHAPE_RECT, {.rect = {(pos), (dim)}}})
+
+// Information about a collision between two shapes
+typedef struct {
+	// The unit vector along which the shapes should be pushed apart, pointing from the first shape to the second
+	v2d_vec_t normal;
+	// How far the shapes overlap along the normal
+	double depth;
+	// The point at which the shapes touch
+	v2d_vec_t point;
+} v2d_contact_t;
+
 // Point-to-shape collision
 // These functions return true if the point is within the shape and false otherwise
 // They are useful for mouse-picking of shapes
@@ -41,10 +68,39 @@ _Bool v2d_collide_rect_rect(v2d_rect_t a, v2d_rect_t b);
 _Bool v2d_collide_circle_rect(v2d_circle_t a, v2d_rect_t b);
 #define v2d_collide_rect_circle(b, a) (v2d_collide_circle_rect((a), (b)));
 
+// Collide two shapes of any type
+_Bool v2d_collide_shape_shape(v2d_shape_t a, v2d_shape_t b);
+
+// Shape-to-shape contact generation
+// These functions return true and fill in `c` if there is a collision, and return false otherwise
+_Bool v2d_contact_circle_circle(v2d_circle_t a, v2d_circle_t b, v2d_contact_t *c);
+_Bool v2d_contact_rect_rect(v2d_rect_t a, v2d_rect_t b, v2d_contact_t *c);
+_Bool v2d_contact_circle_rect(v2d_circle_t a, v2d_rect_t b, v2d_contact_t *c);
+_Bool v2d_contact_rect_circle(v2d_rect_t a, v2d_circle_t b, v2d_contact_t *c);
+_Bool v2d_contact_shape_shape(v2d_shape_t a, v2d_shape_t b, v2d_contact_t *c);
+
 // Ray-to-shape collision
 // Returns the distance along the line as a fraction, or an infinite value when there is no collision
 
 double v2d_raycast_circle(v2d_ray_t r, v2d_circle_t c);
 double v2d_raycast_rect(v2d_ray_t r, v2d_rect_t b);
+double v2d_raycast_shape(v2d_ray_t r, v2d_shape_t s);
+
+// These return 0 when the ray ends inside the shape, without working out where it enters
+// The _entry versions always return where the ray enters the shape, so the results for different shapes can be compared to find the nearest
+double v2d_raycast_circle_entry(v2d_ray_t r, v2d_circle_t c);
+double v2d_raycast_rect_entry(v2d_ray_t r, v2d_rect_t b);
+double v2d_raycast_shape_entry(v2d_ray_t r, v2d_shape_t s);
+
+// Shape utilities
+
+// Return the smallest axis-aligned rect containing a shape. Its dimensions are never negative
+v2d_rect_t v2d_shape_bounds(v2d_shape_t s);
+
+// Return a shape moved by `delta`
+v2d_shape_t v2d_shape_translate(v2d_shape_t s, v2d_vec_t delta);
+
+// Return the distance from a point to the nearest part of a shape, or 0 if the point is inside it
+double v2d_shape_distance(v2d_shape_t s, v2d_vec_t p);
 
 #endif
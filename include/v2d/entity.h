@@ -13,6 +13,7 @@
 #ifndef _V2D_ENTITY_H
 #define _V2D_ENTITY_H
 
+#include <stdint.h>
 #include "v2d.h"
 
 typedef void (*v2d_entity_render_callback_t)(v2d_ent_t *entity, v2d_render_t *render);
@@ -23,6 +24,10 @@ struct v2d_ent_cb {
 	v2d_entity_render_callback_t render;
 	v2d_entity_update_callback_t update;
 	v2d_entity_destroy_callback_t destroy;
+
+	// Identifies the entity's type in snapshots (see v2d/snapshot.h)
+	// Entities with a type of 0 are not saved
+	uint32_t type;
 };
 
 #endif
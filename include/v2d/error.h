@@ -9,6 +9,9 @@
 enum v2d_error {
 	V2D_ERROR_NONE = 0,
 	V2D_ERROR_SDL,
+	V2D_ERROR_MEMORY,
+	V2D_ERROR_IO,
+	V2D_ERROR_FORMAT,
 };
 
 extern enum v2d_error v2d_errcode;
@@ -11,11 +11,17 @@
 
 #include "v2d.h"
 
+// The most fixed steps the built-in game loop runs between two frames
+// When updates can't keep up, the time beyond this is dropped rather than caught up on, so every frame doesn't fall further behind
+#ifndef V2D_LOOP_MAX_STEPS
+#define V2D_LOOP_MAX_STEPS 5
+#endif
+
 // Built-in game loop
 
 struct v2d_gameloop_config {
 	// The world to update and render
-	const v2d_world_t *world;
+	v2d_world_t *world;
 
 	// The renderer to use for rendering the world
 	v2d_render_t *render;
@@ -27,8 +33,29 @@ struct v2d_gameloop_config {
 	const v2d_action_t *quit_action;
 
 	// The time to wait between rendering frames
-	// The world may continue to be updated during this time
+	// The world may continue to be updated during this time, and the loop sleeps when there's nothing to do
+	// Ignored if `pacer` is set
 	unsigned int frame_time_ms; // 1000/FPS
+
+	// Whether to draw the v2d_stats overlay on top of every frame
+	_Bool stats_overlay;
+
+	// If non-zero, the world is updated in fixed steps of this many seconds instead of once per iteration
+	// A fixed step is required for deterministic simulation
+	// At most V2D_LOOP_MAX_STEPS steps are run per frame, and the pacer's statistics record any time dropped beyond that
+	double fixed_dt;
+
+	// If not NULL, the world is updated through this rollback buffer, which sets the step length
+	v2d_rollback_t *rollback;
+
+	// If not NULL, this asset manager uploads and evicts textures before every frame is rendered
+	v2d_assets_t *assets;
+
+	// If not NULL, the world is drawn through these layers, which must use the same renderer
+	v2d_layers_t *layers;
+
+	// If not NULL, this pacer times the frames instead of one made from frame_time_ms, so its statistics can be read
+	v2d_pacer_t *pacer;
 };
 
 v2d_gameloop_config_t v2d_gameloop_config_default(void);
@@ -39,10 +66,16 @@ void v2d_gameloop(v2d_gameloop_config_t conf);
 // Process SDL events, dispatches to dis if dis is not NULL and returns whether the game should exit
 _Bool v2d_loop_process_events(v2d_action_dispatcher_t dis, const v2d_action_t *quit_action, v2d_render_t *render);
 
-// Update every entity in a world
-void v2d_loop_update_world(const v2d_world_t *world, double dt);
+// Update every entity in a world, then apply any changes queued with v2d_world_defer_*
+void v2d_loop_update_world(v2d_world_t *world, double dt);
 
 // Render a world using the specified renderer
 void v2d_loop_render_world(const v2d_world_t *world, v2d_render_t *render);
 
+// Render a world using the specified renderer, with the v2d_stats overlay drawn on top
+void v2d_loop_render_world_stats(const v2d_world_t *world, v2d_render_t *render);
+
+// Render a world through a set of layers, using their renderer
+void v2d_loop_render_layers(const v2d_world_t *world, v2d_layers_t *layers);
+
 #endif
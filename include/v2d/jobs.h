@@ -0,0 +1,59 @@
+/* v2d/jobs.h
+ *
+ * A small thread pool for splitting work across CPU cores. Work is submitted
+ * as a parallel for loop: a range of indices is split into chunks, and each
+ * thread repeatedly takes the next chunk until none are left. The calling
+ * thread helps with the work, and v2d_jobs_parallel_for only returns once
+ * every chunk is done.
+ *
+ * Every function that accepts a thread pool also accepts NULL, in which case
+ * the work is done on the calling thread.
+ *
+ * Job functions must not modify v2d's global state, such as the counters in
+ * v2d/stats.h, or allocate memory through v2d_alloc.
+ *
+ */
+#ifndef _V2D_JOBS_H
+#define _V2D_JOBS_H
+
+#include <stddef.h>
+#include <SDL.h>
+#include "v2d.h"
+
+// A job function processes the indices from `begin` up to but not including `end`
+// `worker` identifies the thread doing the work, from 0 to v2d_jobs_workers(jobs) - 1, so it can be used to index per-thread buffers
+typedef void (*v2d_job_fn_t)(void *ctx, size_t begin, size_t end, unsigned worker);
+
+struct v2d_jobs {
+	SDL_Thread **threads;
+	unsigned n_threads;
+
+	SDL_mutex *lock;
+	SDL_cond *start, *done;
+	unsigned generation; // Incremented every time a job is started
+	unsigned running; // The number of threads still working on the current job
+	_Bool quit;
+
+	// The current job
+	v2d_job_fn_t fn;
+	void *ctx;
+	size_t n, chunk;
+	SDL_atomic_t next;
+};
+
+// Create a thread pool with `n_threads` threads in addition to the calling thread
+// If n_threads is 0, one thread is created for each CPU core other than the current one
+// Returns NULL on failure
+v2d_jobs_t *v2d_jobs_new(unsigned n_threads);
+
+// Stop and free a thread pool
+void v2d_jobs_free(v2d_jobs_t *jobs);
+
+// Return the number of threads that may run jobs, including the calling thread
+unsigned v2d_jobs_workers(const v2d_jobs_t *jobs);
+
+// Call fn over the range [0, n), in chunks of at most `chunk` indices
+// If chunk is 0, a chunk size is chosen automatically
+void v2d_jobs_parallel_for(v2d_jobs_t *jobs, size_t n, size_t chunk, v2d_job_fn_t fn, void *ctx);
+
+#endif
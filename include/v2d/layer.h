@@ -0,0 +1,73 @@
+/* v2d/layer.h
+ *
+ * Layers split a world's entities into groups that are drawn one after
+ * another, from layer 0 at the back to the last layer at the front. Each
+ * entity's layer is set with v2d_world_set_layer.
+ *
+ * Every layer has its own parallax factor, which scales how far the camera's
+ * translation moves it. A factor of 1 moves the layer with the world, smaller
+ * factors make it scroll more slowly, like a distant background, and 0 pins
+ * it in place. Screen space layers ignore the camera entirely, which suits
+ * HUD elements.
+ *
+ * Layers that rarely change, such as backgrounds, can be cached. A cached
+ * layer is drawn into a render-target texture once and then copied to the
+ * screen every frame, until it is invalidated. The texture is larger than
+ * the screen by V2D_LAYER_MARGIN pixels on every side, so when the camera
+ * pans, the cached image can simply be drawn offset. It's only redrawn once
+ * the camera has moved further than the margin, or been rotated or zoomed.
+ *
+ * The world doesn't know which layers are cached, so after adding, removing
+ * or changing an entity on a cached layer, call v2d_layers_invalidate.
+ *
+ */
+#ifndef _V2D_LAYER_H
+#define _V2D_LAYER_H
+
+#include <SDL.h>
+#include "v2d.h"
+#include "v2d/transform.h"
+#include "v2d/vector.h"
+#include "v2d/world.h"
+
+// The extra space around the screen kept in each cached layer, in pixels
+#ifndef V2D_LAYER_MARGIN
+#define V2D_LAYER_MARGIN 256
+#endif
+
+struct v2d_layer {
+	// How much the camera's translation moves this layer, separately in x and y. Defaults to 1
+	v2d_vec_t parallax;
+	// If set, the layer is drawn without the camera transformation
+	_Bool screen_space;
+	// If set, the layer is drawn into a texture that is only redrawn when needed
+	_Bool cached;
+
+	// The cache, and what it was drawn with
+	SDL_Texture *target;
+	int target_w, target_h;
+	v2d_transform_t target_camera, target_screen;
+	_Bool dirty;
+};
+
+struct v2d_layers {
+	v2d_render_t *render;
+	struct v2d_layer layers[V2D_WORLD_LAYERS];
+};
+
+// Create a set of layers for a renderer, all uncached with a parallax factor of 1
+// Returns NULL on failure
+v2d_layers_t *v2d_layers_new(v2d_render_t *render);
+
+// Free a set of layers and their caches
+void v2d_layers_free(v2d_layers_t *layers);
+
+// Make a cached layer redraw the next time it is rendered
+// This is also needed after changing a layer's settings
+void v2d_layers_invalidate(v2d_layers_t *layers, unsigned layer);
+
+// Draw every layer of a world, using the renderer's camera
+// This doesn't clear the screen first
+void v2d_layers_render(v2d_layers_t *layers, const v2d_world_t *world);
+
+#endif
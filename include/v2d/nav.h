@@ -0,0 +1,129 @@
+/* v2d/nav.h
+ *
+ * Navigation finds routes through the world for AI-controlled entities. It
+ * works on a grid of cells, where each cell is blocked if any static collider
+ * overlaps it. Agents may move between neighbouring cells, including
+ * diagonally, but never cut the corner of a blocked cell.
+ *
+ * There are two ways to find routes:
+ *
+ *  - v2d_nav_find_path finds a path between two points using Jump Point
+ *    Search, which is an A* search that skips over the long runs of open
+ *    cells that make up most grids. Many paths can be found at once on
+ *    worker threads with v2d_nav_find_paths.
+ *
+ *  - v2d_nav_field returns a flow field, which gives the best direction to
+ *    move from every cell towards a goal. Any number of agents heading to the
+ *    same goal can share a single field. The most recently used fields are
+ *    cached, and cached fields are repaired incrementally when colliders are
+ *    added or removed, rather than being recomputed from scratch.
+ *
+ */
+#ifndef _V2D_NAV_H
+#define _V2D_NAV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "v2d.h"
+#include "v2d/collide.h"
+#include "v2d/vector.h"
+
+// The number of flow fields to keep cached
+#ifndef V2D_NAV_FIELDS
+#define V2D_NAV_FIELDS 8
+#endif
+
+// Scratch space for a single search. One exists for each worker thread
+struct v2d_nav_search {
+	uint32_t stamp; // Cells whose stamp differs from this have not been visited by the current search
+	uint32_t *stamps;
+	float *g, *f;
+	uint32_t *parent;
+	uint32_t *heap_pos; // Each cell's position in the heap
+	uint32_t *heap;
+	size_t n_heap;
+};
+
+struct v2d_nav_field {
+	_Bool used;
+	uint32_t goal;
+	uint64_t last_used;
+	float *dist; // The distance from each cell to the goal, or infinity if it can't be reached
+	int8_t *next; // The direction to move from each cell, or -1 if there is none
+};
+
+struct v2d_nav {
+	// The position of the bottom-left corner of the grid, and the width and height of each cell
+	v2d_vec_t origin;
+	double cell_size;
+	// The size of the grid in cells
+	int w, h;
+
+	// The number of colliders overlapping each cell
+	uint16_t *blockers;
+
+	struct v2d_nav_field fields[V2D_NAV_FIELDS];
+	uint64_t clock;
+
+	struct v2d_nav_search *searches;
+	unsigned n_searches;
+
+	// Scratch space for repairing flow fields
+	uint32_t *changed;
+	size_t n_changed, cap_changed;
+	uint32_t *queue;
+};
+
+// A single query for v2d_nav_find_paths
+struct v2d_nav_query {
+	v2d_vec_t from, to;
+	// Where to write the path, and how many points it has room for
+	v2d_vec_t *path;
+	size_t max;
+	// Filled in with the result of v2d_nav_find_path
+	size_t n;
+};
+
+// Create a navigation grid with w by h cells, starting at `origin`
+// Returns NULL on failure
+v2d_nav_t *v2d_nav_new(v2d_vec_t origin, double cell_size, int w, int h);
+
+// Free a navigation grid and all its flow fields
+void v2d_nav_free(v2d_nav_t *nav);
+
+// Find the cell containing a point
+// Returns false if the point is outside the grid
+_Bool v2d_nav_cell(const v2d_nav_t *nav, v2d_vec_t pos, int *x, int *y);
+
+// Return the position of the center of a cell
+v2d_vec_t v2d_nav_cell_center(const v2d_nav_t *nav, int x, int y);
+
+// Return true if a cell can be walked through
+_Bool v2d_nav_walkable(const v2d_nav_t *nav, int x, int y);
+
+// Add or remove static colliders. Every cell a collider overlaps is blocked until it is removed
+// Cached flow fields are repaired to match
+_Bool v2d_nav_add_rect(v2d_nav_t *nav, v2d_rect_t rect);
+_Bool v2d_nav_remove_rect(v2d_nav_t *nav, v2d_rect_t rect);
+_Bool v2d_nav_add_rects(v2d_nav_t *nav, const v2d_rect_t *rects, size_t n);
+
+// Find a path from one point to another
+// Up to `max` points are written into `path`. These are the centers of the cells where the path changes direction, starting with the cell containing `from` and ending with the cell containing `to`
+// Returns the total number of points in the path, which may be more than `max`, or 0 if there is no path
+size_t v2d_nav_find_path(v2d_nav_t *nav, v2d_vec_t from, v2d_vec_t to, v2d_vec_t *path, size_t max);
+
+// Run many path queries, spread across a thread pool. `jobs` may be NULL
+// The grid must not be modified while this runs
+// Returns false on failure
+_Bool v2d_nav_find_paths(v2d_nav_t *nav, struct v2d_nav_query *queries, size_t n, v2d_jobs_t *jobs);
+
+// Return a flow field leading to `goal`, computing it if it isn't cached
+// The field remains valid until the next call to v2d_nav_field or v2d_nav_free, and is kept up to date as colliders change
+// Returns NULL if the goal is outside the grid, or on failure
+const struct v2d_nav_field *v2d_nav_field(v2d_nav_t *nav, v2d_vec_t goal);
+
+// Return the unit vector an agent at `pos` should move along to follow a flow field
+// Returns zero if the agent is in the goal cell or can't reach it
+v2d_vec_t v2d_nav_flow(const v2d_nav_t *nav, const struct v2d_nav_field *field, v2d_vec_t pos);
+
+#endif
@@ -0,0 +1,89 @@
+/* v2d/pacer.h
+ *
+ * A frame pacer decides when each frame should be rendered, so that frames
+ * come out at a steady rate without the game loop spinning in between.
+ *
+ * It measures how long rendering takes, and wakes the loop that long before
+ * each frame is due, so the frame is presented on time. The rest of the frame
+ * can be spent sleeping, or running fixed update steps as they come due.
+ *
+ * When rendering falls behind, the frames that were missed are dropped
+ * instead of being rendered back to back to catch up. The next frame is
+ * scheduled for the next slot that is still in the future, so a slow frame
+ * can't push every frame after it later and later.
+ *
+ * With vsync (see v2d_render_new_flags), presenting a frame already waits
+ * for the display, so the pacer lines its schedule up with the moment each
+ * present returns instead of keeping its own.
+ *
+ * The built-in game loop uses a pacer of its own unless it's given one, which
+ * gives access to the frame-time statistics.
+ *
+ */
+#ifndef _V2D_PACER_H
+#define _V2D_PACER_H
+
+#include <stdint.h>
+#include "v2d.h"
+
+// The number of frames the statistics are taken over
+#ifndef V2D_PACER_HISTORY
+#define V2D_PACER_HISTORY 120
+#endif
+
+// How early to start rendering, on top of the measured render time, in seconds
+// This covers sleeps that run long and frames that take a little longer than usual
+#define V2D_PACER_SLACK 0.002
+
+struct v2d_frame_stats {
+	uint64_t frames; // Frames rendered
+	uint64_t dropped; // Frames skipped because rendering fell behind
+	double last; // The time between the last two frames, in seconds
+	double mean, worst; // The average and longest time between frames, over the last V2D_PACER_HISTORY frames
+	double render; // The time rendering is expected to take, in seconds
+	double dropped_time; // Simulation time skipped because updates fell behind, in seconds
+};
+
+struct v2d_pacer {
+	// The time between frames, in seconds. Zero renders frames as fast as possible
+	double frame_time;
+	// Whether presenting a frame waits for the display
+	_Bool vsync;
+
+	// The expected render time. It rises straight away when a frame is slow, and falls slowly
+	double render_cost;
+
+	// Performance counter values: when the next frame is due, when the current one started rendering and when the last one was presented
+	uint64_t next, render_start, last_frame;
+
+	uint64_t frames, dropped;
+	double dropped_time;
+	// The times between recent frames, indexed by frame number
+	double history[V2D_PACER_HISTORY];
+};
+
+// Initialize a pacer for frames `frame_time` seconds apart
+void v2d_pacer_init(v2d_pacer_t *pacer, double frame_time, _Bool vsync);
+
+// Return how long until the next frame should start rendering, in seconds. Zero or less means it should start now
+double v2d_pacer_remaining(const v2d_pacer_t *pacer);
+
+// Call before rendering a frame
+void v2d_pacer_begin_frame(v2d_pacer_t *pacer);
+
+// Call once the frame is drawn, just before presenting it, so waiting for vsync isn't counted as rendering
+void v2d_pacer_present(v2d_pacer_t *pacer);
+
+// Call after presenting a frame. This schedules the next frame, dropping any that were missed
+void v2d_pacer_end_frame(v2d_pacer_t *pacer);
+
+// Record simulation time that was skipped instead of being updated, so it shows up in the statistics
+void v2d_pacer_drop_time(v2d_pacer_t *pacer, double seconds);
+
+// Get the frame-time statistics
+struct v2d_frame_stats v2d_pacer_stats(const v2d_pacer_t *pacer);
+
+// Sleep for about `seconds`, rounded down to whole milliseconds so it never sleeps too long
+void v2d_pacer_sleep(double seconds);
+
+#endif
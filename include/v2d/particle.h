@@ -0,0 +1,76 @@
+/* v2d/particle.h
+ *
+ * Particle emitters simulate large numbers of short-lived points, such as
+ * sparks, smoke or debris, far more cheaply than making each one an entity.
+ *
+ * An emitter stores its particles in a fixed-capacity pool of separate float
+ * arrays for each component, which lets updates process several particles at
+ * a time using SIMD instructions. Dead particles are removed by moving the
+ * last particle into their place, so the live particles are always packed at
+ * the start of the arrays. Rendering transforms every particle at once and
+ * submits them to SDL in a single draw call.
+ *
+ * An emitter is also an entity, so it can be added to a world to be updated
+ * and rendered automatically.
+ *
+ */
+#ifndef _V2D_PARTICLE_H
+#define _V2D_PARTICLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "v2d.h"
+#include "v2d/entity.h"
+#include "v2d/vector.h"
+
+struct v2d_emitter {
+	// This allows an emitter to be added to a world
+	v2d_ent_cb_t cb;
+
+	// The number of live particles, and the most there can be
+	size_t n, cap;
+
+	// Particle data. Each array has room for `cap` particles
+	float *x, *y, *vx, *vy, *life;
+
+	// Settings for new particles
+	v2d_vec_t pos; // Where particles are emitted from
+	v2d_vec_t vel; // The average velocity of new particles
+	double spread; // New particles get a random extra velocity of up to this magnitude
+	double life_min, life_max; // How long new particles live for, in seconds
+
+	// Settings for every particle
+	v2d_vec_t gravity; // Acceleration applied to every particle
+	double drag; // The fraction of velocity lost per second, from 0 to 1
+	double r, g, b, a; // Colour, from 0 to 1
+
+	// How many particles to emit per second when updated as an entity
+	double rate;
+	double rate_accumulator;
+
+	// State of the random number generator used for new particles
+	uint32_t rng;
+
+	// Screen positions, filled in when rendering
+	SDL_FPoint *points;
+};
+
+// Create an emitter with room for `cap` particles
+// Returns NULL on failure
+v2d_emitter_t *v2d_emitter_new(size_t cap);
+
+// Free an emitter and all its particles
+void v2d_emitter_free(v2d_emitter_t *em);
+
+// Emit up to `count` particles using the emitter's current settings
+// Returns the number of particles emitted, which is less than `count` if the emitter is full
+size_t v2d_emitter_emit(v2d_emitter_t *em, size_t count);
+
+// Move every particle forward by dt seconds, and remove those that have died
+void v2d_emitter_update(v2d_emitter_t *em, double dt);
+
+// Draw every particle as a single pixel
+void v2d_emitter_render(v2d_emitter_t *em, v2d_render_t *render);
+
+#endif
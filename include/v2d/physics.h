@@ -0,0 +1,153 @@
+/* v2d/physics.h
+ *
+ * v2d's physics module simulates rigid bodies with mass and velocity, so that
+ * games don't need to write their own integration and collision response.
+ * Bodies use the shapes from v2d/collide.h and, like those shapes, they never
+ * rotate.
+ *
+ * Every step, the physics world:
+ *  - integrates velocities using semi-implicit Euler
+ *  - finds contacts using the broad phase in v2d/broad.h and the contact
+ *    generation functions in v2d/collide.h
+ *  - resolves them using a sequential impulse solver
+ *  - integrates positions
+ *  - puts islands of bodies that have come to rest to sleep
+ *
+ * Sleeping bodies are not integrated, and pairs of sleeping or static bodies
+ * are never tested, so settled piles of objects cost almost nothing. A
+ * sleeping body is woken when an awake body touches it, or when it is moved
+ * or pushed using the functions in this file.
+ *
+ * Body data is stored as separate arrays (one per field) indexed by body ID,
+ * so that each stage only touches the data it needs. You can read these
+ * arrays directly, but should use the functions below to modify them.
+ *
+ * A physics world is also an entity. If you add it to a v2d world, it will
+ * step itself using a fixed time step whenever the world is updated.
+ *
+ */
+#ifndef _V2D_PHYSICS_H
+#define _V2D_PHYSICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "v2d.h"
+#include "v2d/broad.h"
+#include "v2d/collide.h"
+#include "v2d/entity.h"
+
+// Returned instead of a body ID on failure
+#define V2D_BODY_NONE UINT32_MAX
+
+// Describes a body to be created
+struct v2d_body_def {
+	// The shape's position is relative to `pos`
+	v2d_shape_t shape;
+	v2d_vec_t pos, vel;
+	// A mass of zero creates a static body, which never moves
+	double mass;
+	// How bouncy the body is, from 0 to 1
+	double restitution;
+	// The coefficient of friction
+	double friction;
+	// User data
+	void *data;
+};
+
+enum v2d_body_flags {
+	V2D_BODY_ALIVE = 1 << 0,
+	V2D_BODY_STATIC = 1 << 1,
+	V2D_BODY_AWAKE = 1 << 2,
+};
+
+// A contact between two bodies found during the last step
+struct v2d_body_contact {
+	uint32_t a, b;
+	v2d_contact_t contact;
+
+	// Used by the solver
+	double mass_n, mass_t, bias, restitution, friction;
+	double impulse_n, impulse_t;
+};
+
+struct v2d_physics {
+	// This allows a physics world to be added to a v2d world
+	v2d_ent_cb_t cb;
+
+	// Per-body arrays, indexed by body ID
+	size_t n_bodies, cap_bodies;
+	v2d_vec_t *pos, *vel, *force;
+	double *inv_mass, *restitution, *friction;
+	// How long each body has been moving slowly enough to sleep
+	double *rest_time;
+	// Sleeping islands are linked into rings through this, so that waking one body wakes the whole island
+	uint32_t *sleep_next;
+	v2d_shape_t *shape;
+	uint32_t *proxy;
+	uint8_t *flags;
+	void **data;
+
+	// Scratch space for finding islands
+	uint32_t *island;
+	double *island_rest;
+
+	// IDs of deleted bodies that can be reused
+	uint32_t *free_ids;
+	size_t n_free, cap_free;
+
+	// Settings
+	v2d_vec_t gravity;
+	// The number of times the solver iterates over all contacts
+	int iterations;
+	// Bodies moving slower than this are considered to be at rest
+	double sleep_speed;
+	// Islands that have been at rest for this many seconds are put to sleep
+	double sleep_time;
+	// The time step used when the physics world is updated as an entity
+	double fixed_dt;
+	// The time not yet simulated when updating as an entity
+	double accumulator;
+
+	v2d_broad_t broad;
+
+	// Contacts found during the last step
+	struct v2d_body_contact *contacts;
+	size_t n_contacts, cap_contacts;
+};
+
+// Create a new physics world with default settings
+// Returns NULL on failure
+v2d_physics_t *v2d_physics_new(void);
+
+// Free a physics world
+void v2d_physics_free(v2d_physics_t *phys);
+
+// Add a body. New bodies are awake
+// Returns the new body's ID, or V2D_BODY_NONE on failure
+uint32_t v2d_physics_add(v2d_physics_t *phys, const struct v2d_body_def *def);
+
+// Remove a body. Its ID may be reused by later calls to v2d_physics_add
+void v2d_physics_del(v2d_physics_t *phys, uint32_t id);
+
+// Move a body to a new position, and wake it
+void v2d_physics_set_pos(v2d_physics_t *phys, uint32_t id, v2d_vec_t pos);
+
+// Set a body's velocity, and wake it
+void v2d_physics_set_vel(v2d_physics_t *phys, uint32_t id, v2d_vec_t vel);
+
+// Apply a force to a body during the next step, and wake it
+void v2d_physics_apply_force(v2d_physics_t *phys, uint32_t id, v2d_vec_t force);
+
+// Apply an impulse to a body, immediately changing its velocity, and wake it
+void v2d_physics_apply_impulse(v2d_physics_t *phys, uint32_t id, v2d_vec_t impulse);
+
+// Wake a body
+void v2d_physics_wake(v2d_physics_t *phys, uint32_t id);
+
+// Return true if a body is awake. Static bodies are never awake
+_Bool v2d_physics_awake(const v2d_physics_t *phys, uint32_t id);
+
+// Advance the simulation by dt seconds
+void v2d_physics_step(v2d_physics_t *phys, double dt);
+
+#endif
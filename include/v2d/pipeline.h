@@ -0,0 +1,122 @@
+/* v2d/pipeline.h
+ *
+ * The collision pipeline runs the broad phase and the narrow phase together,
+ * and tracks which pairs of proxies are touching from one step to the next.
+ * Instead of a plain list of collisions, each step produces events:
+ *  - BEGIN when two proxies start touching
+ *  - STAY for every step they carry on touching
+ *  - END when they stop touching, or one of them is deleted
+ *
+ * Every pair whose bounding boxes overlap is kept in a hash set along with
+ * the result of its last narrow-phase test. If neither proxy has moved since
+ * that test, the result can't have changed, so the test is skipped. In most
+ * games, the majority of pairs are resting or static, so most narrow-phase
+ * work disappears.
+ *
+ * The broad phase doesn't report pairs of two inactive proxies, or of an
+ * inactive proxy and a static collider. Pairs like that which were already
+ * known, such as two objects that went to sleep while touching, are kept for
+ * as long as neither proxy moves or is deleted, and carry on producing STAY
+ * events.
+ *
+ * The pipeline doesn't own the broad phase, so proxies are added, moved and
+ * deleted using the functions in v2d/broad.h as usual.
+ *
+ * Colliders that never move can be kept in a static index (see v2d/static.h)
+ * instead. Each step, every active proxy is tested against the index, but
+ * static colliders are never tested against each other. In pairs and events,
+ * a static collider's ID has V2D_PIPELINE_STATIC set, so it always comes
+ * second.
+ *
+ * The narrow-phase tests can be spread across a thread pool (see v2d/jobs.h)
+ * with v2d_pipeline_step_parallel. Every test writes only to its own pair,
+ * and events are still produced in the same order, so the results are
+ * identical to v2d_pipeline_step no matter how many threads there are.
+ *
+ */
+#ifndef _V2D_PIPELINE_H
+#define _V2D_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "v2d.h"
+#include "v2d/broad.h"
+#include "v2d/collide.h"
+#include "v2d/static.h"
+
+// Set in the IDs of static colliders in pairs and events. Proxies in the broad phase must have IDs below this
+#define V2D_PIPELINE_STATIC UINT32_C(0x80000000)
+
+struct v2d_collision_event {
+	enum {
+		V2D_COLLISION_BEGIN,
+		V2D_COLLISION_STAY,
+		V2D_COLLISION_END,
+	} type;
+	// The proxy IDs. For END events, the proxies may have been deleted since the last step
+	v2d_pair_t pair;
+	// Contact information, from the first proxy to the second. Not set for END events
+	v2d_contact_t contact;
+};
+
+// A pair whose bounding boxes overlapped during the last step
+struct v2d_pipeline_pair {
+	v2d_pair_t pair;
+	// The broad phase's stamp when the narrow phase last tested this pair
+	uint32_t tested;
+	_Bool touching, was_touching;
+	v2d_contact_t contact;
+};
+
+struct v2d_pipeline {
+	v2d_broad_t *broad;
+	const v2d_static_t *statics;
+
+	// Every candidate pair for the current step
+	v2d_pair_t *candidates;
+	size_t n_candidates, cap_candidates;
+
+	// Overlapping pairs, in no particular order
+	struct v2d_pipeline_pair *pairs;
+	size_t n_pairs, cap_pairs;
+
+	// Open addressing hash table of indices into `pairs`, rebuilt every step
+	uint32_t *index;
+	size_t cap_index;
+
+	// The entry of `pairs` for each candidate, and the entries that need a narrow-phase test
+	uint32_t *work, *tests;
+	size_t cap_work, cap_tests;
+
+	// Marks which entries of `pairs` were seen during the current step
+	uint8_t *seen;
+	size_t cap_seen;
+
+	// The events produced by the last step
+	struct v2d_collision_event *events;
+	size_t n_events, cap_events;
+
+	// The number of narrow-phase tests run and skipped during the last step
+	size_t n_tested, n_skipped;
+};
+
+// Initialize a pipeline that runs on a broad phase
+void v2d_pipeline_init(v2d_pipeline_t *pl, v2d_broad_t *broad);
+
+// Free all the memory used by a pipeline
+void v2d_pipeline_destroy(v2d_pipeline_t *pl);
+
+// Test active proxies against a static index as well as each other, or stop doing so if `statics` is NULL
+// The index is not copied, so it must not be freed while the pipeline is using it
+void v2d_pipeline_set_static(v2d_pipeline_t *pl, const v2d_static_t *statics);
+
+// Find pairs and test them, returning the resulting events
+// The returned array is owned by the pipeline, and is valid until the next call to this function
+// Returns NULL and sets *n_events to 0 on failure
+const struct v2d_collision_event *v2d_pipeline_step(v2d_pipeline_t *pl, size_t *n_events);
+
+// The same as v2d_pipeline_step, but with the narrow phase spread across a thread pool. `jobs` may be NULL
+// The broad phase and static index must not be modified while this runs
+const struct v2d_collision_event *v2d_pipeline_step_parallel(v2d_pipeline_t *pl, v2d_jobs_t *jobs, size_t *n_events);
+
+#endif
@@ -0,0 +1,62 @@
+/* v2d/profile.h
+ *
+ * v2d has a small built-in frame profiler. It records named zones of code
+ * using SDL's high-resolution performance counter, and can export them in
+ * Chrome's trace event format so they can be viewed in chrome://tracing or
+ * https://ui.perfetto.dev
+ *
+ * Each thread records into its own ring buffer, so recording a zone never
+ * takes a lock. When a ring buffer fills up, the oldest zones are overwritten.
+ *
+ * The profiler only exists if V2D_PROFILE is defined when compiling both v2d
+ * and your program (eg. `make CPPFLAGS=-DV2D_PROFILE`). Otherwise, every macro
+ * in this file expands to nothing and profiling has no cost at all.
+ *
+ */
+#ifndef _V2D_PROFILE_H
+#define _V2D_PROFILE_H
+
+#include <stdint.h>
+
+// The number of zones each thread can store. Must be a power of two
+#ifndef V2D_PROFILE_RING_SIZE
+#define V2D_PROFILE_RING_SIZE 16384
+#endif
+
+#ifdef V2D_PROFILE
+
+// Return the current value of the profiler clock
+uint64_t v2d_prof_now(void);
+
+// Record a zone that started at `start` and ended at `end` in the calling thread's ring buffer
+// `name` is not copied, so it should usually be a string literal
+void v2d_prof_record(const char *name, uint64_t start, uint64_t end);
+
+// Discard all the zones recorded so far
+// This must not be called while other threads are recording zones
+void v2d_prof_clear(void);
+
+// Write every recorded zone to a file in Chrome's trace event JSON format
+// This must not be called while other threads are recording zones
+// Returns true on success, false on failure
+_Bool v2d_prof_export(const char *path);
+
+// Time a statement or block and record it as a zone
+// Usage:
+//  v2d_prof_zone("physics") {
+//      do_physics();
+//  }
+// WARNING: this is implemented using a for loop. Using `break` or `continue` directly inside a zone will not do what you expect, and leaving it with `return` or `goto` will not record it.
+#define v2d_prof_zone(name) for (uint64_t _v2d_prof_start = v2d_prof_now(), _v2d_prof_once = 1; _v2d_prof_once; _v2d_prof_once = 0, v2d_prof_record((name), _v2d_prof_start, v2d_prof_now()))
+
+#else
+
+#define v2d_prof_now() ((uint64_t)0)
+#define v2d_prof_record(name, start, end)
+#define v2d_prof_clear()
+#define v2d_prof_export(path) (0)
+#define v2d_prof_zone(name)
+
+#endif
+
+#endif
@@ -5,6 +5,18 @@
  * The render component takes care of initializing SDL, as well as
  * dispatching render events to multiple game entities.
  *
+ * For mostly static scenes, such as tools and menus, a renderer can track
+ * damage instead of redrawing everything every frame. In this mode the draw
+ * functions record what they would draw instead of drawing it, and
+ * v2d_render_flip compares the recording with the previous frame's. Only the
+ * bounds of the draw calls that changed are redrawn, clipped to their union,
+ * into a texture that holds the frame between flips. If nothing changed,
+ * nothing is drawn and the screen isn't flipped at all.
+ *
+ * Draw calls are compared by their arguments, so a texture whose contents
+ * change must be marked with v2d_render_damage. Anything drawn by calling
+ * SDL directly isn't tracked either.
+ *
  */
 
 #ifndef _V2D_RENDER_H
@@ -16,8 +28,56 @@
 #include "v2d/transform.h"
 #include "v2d/vector.h"
 
+// A draw call recorded while tracking damage
+struct v2d_render_cmd {
+	enum {
+		V2D_RENDER_CMD_CLEAR,
+		V2D_RENDER_CMD_RECT,
+		V2D_RENDER_CMD_FILL_RECT,
+		V2D_RENDER_CMD_LINE,
+		V2D_RENDER_CMD_CIRCLE,
+		V2D_RENDER_CMD_POINTS,
+		V2D_RENDER_CMD_TEXTURE,
+	} type;
+	SDL_Color color;
+	// The area the command draws over, in SDL screen coordinates
+	SDL_Rect bounds;
+	union {
+		SDL_Rect rect;
+		struct { int x1, y1, x2, y2; } line;
+		struct { int x, y; double rad; } circle;
+		struct { size_t first, count; } points; // A range of the tracker's points. These are always treated as changed
+		struct { SDL_Texture *tex; SDL_Rect src, dst; _Bool has_src; } texture;
+	} c;
+};
+
+struct v2d_render_damage {
+	// This frame's commands, and the last frame's
+	struct v2d_render_cmd *cmds, *prev;
+	size_t n_cmds, cap_cmds, n_prev, cap_prev;
+
+	// The points used by this frame's commands
+	SDL_FPoint *points;
+	size_t n_points, cap_points;
+
+	// The current draw colour
+	SDL_Color color;
+
+	// Areas marked with v2d_render_damage
+	SDL_Rect marked;
+	_Bool has_marked;
+
+	// Holds the last frame, so only the damaged parts need redrawing
+	SDL_Texture *target;
+	int w, h;
+};
+
 struct v2d_render {
 	SDL_Renderer *sdl_ren;
+	// If not NULL, the renderer is tracking damage
+	struct v2d_render_damage *damage;
+	// Whether presenting the frame waits for the display's vertical refresh
+	_Bool vsync;
 	// camera_tr converts v2d world coordinates to v2d screen coordinates
 	// screen_tr converts v2d screen coordinates with inverted y to SDL screen coordinates
 	// To convert from world coordinates to SDL coordinates, do v2d_transform(conj(world_pos), v2d_render_transform(render))
@@ -29,6 +89,10 @@ struct v2d_render {
 // In order to maintain this transformation if the window is resized, you must handle the correct events. The default game loop does this automatically.
 v2d_render_t *v2d_render_new(SDL_Window *sdl_win);
 
+// Create a new renderer, passing `flags` on to SDL_CreateRenderer, such as SDL_RENDERER_PRESENTVSYNC
+// The driver may not honour every flag, so check `vsync` to see whether it was enabled
+v2d_render_t *v2d_render_new_flags(SDL_Window *sdl_win, Uint32 flags);
+
 // Free a renderer and all resources associated with it
 void v2d_render_free(v2d_render_t *render);
 
@@ -55,14 +119,27 @@ void v2d_render_rgba(v2d_render_t *render, double r, double g, double b, double
 void v2d_render_clear(v2d_render_t *render);
 
 // Swap the front and back buffers
+// When tracking damage, this draws the damaged part of the frame first, and does nothing if the frame didn't change
 void v2d_render_flip(v2d_render_t *render);
 
+// Start or stop tracking damage. Call this between frames
+// Returns false on failure
+_Bool v2d_render_track_damage(v2d_render_t *render, _Bool enabled);
+
+// Mark part of the screen, in SDL screen coordinates, to be redrawn by the next flip even if its draw calls don't change
+// If `rect` is NULL, the whole screen is marked. Does nothing if damage isn't being tracked
+void v2d_render_damage(v2d_render_t *render, const SDL_Rect *rect);
+
 // Draw an axis-aligned rectangle
 // WARNING: any rotational transformations applied to the camera will only apply to the corners of this rectangle, and will not rotate the rectangle itself
 // `pos` is the vector from origin to the bottom left corner
 // `size` is the vector from the bottom left to the top right corner
 void v2d_render_draw_rect(v2d_render_t *render, v2d_vec_t pos, v2d_vec_t size);
 
+// Draw a filled axis-aligned rectangle
+// The same warning and arguments apply as for v2d_render_draw_rect
+void v2d_render_fill_rect(v2d_render_t *render, v2d_vec_t pos, v2d_vec_t size);
+
 // Draw a single pixel
 void v2d_render_draw_pixel(v2d_render_t *render, v2d_vec_t pos);
 
@@ -75,6 +152,13 @@ void v2d_render_draw_circle(v2d_render_t *render, v2d_vec_t center, double radiu
 // Draw a portion of an SDL texture
 void v2d_render_draw_texture(v2d_render_t *render, SDL_Texture *tex, SDL_Rect *srcrect, v2d_vec_t dstpos, v2d_vec_t dstsize);
 
+// Draw a portion of an SDL texture at SDL screen coordinates, without any transformation
+// If `dstrect` is NULL, the texture covers the whole screen
+void v2d_render_copy(v2d_render_t *render, SDL_Texture *tex, const SDL_Rect *srcrect, const SDL_Rect *dstrect);
+
+// Draw points at SDL screen coordinates, without any transformation
+void v2d_render_draw_points(v2d_render_t *render, const SDL_FPoint *points, size_t n);
+
 // Adjust an SDL rect so its width and height are positive
 void v2d_render_util_fix_rect(SDL_Rect *rect);
 
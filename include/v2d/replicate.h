@@ -0,0 +1,274 @@
+/* v2d/replicate.h
+ *
+ * Replication sends the state of a server's world to its clients over the
+ * network, for multiplayer games with an authoritative server.
+ *
+ * The server tracks the entities that should be replicated. Every tick, it
+ * captures each one's position and a small block of state, then works out
+ * what each client is missing by comparing against the last state that
+ * client acknowledged receiving. Only the differences are sent: positions
+ * are quantized to integers and sent as deltas, and only the state words
+ * that changed are included, all packed into a bit stream.
+ *
+ * Each client has a view: a position and radius that decide which entities
+ * are relevant to it, found using a broad phase. When there are more
+ * changes than fit in a packet, they are sent in order of priority, which
+ * grows the longer an entity goes without being updated and the closer it
+ * is to the view. Anything left out is sent in a later packet, since it
+ * still differs from what the client acknowledged.
+ *
+ * Packets are sent through a pluggable transport. An in-memory loopback
+ * transport is included, which is useful for testing and for local
+ * multiplayer.
+ *
+ */
+#ifndef _V2D_REPLICATE_H
+#define _V2D_REPLICATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "v2d.h"
+#include "v2d/broad.h"
+#include "v2d/vector.h"
+
+// The most state an entity can have, in 32-bit words
+#ifndef V2D_REPL_STATE_WORDS
+#define V2D_REPL_STATE_WORDS 16
+#endif
+
+// The number of past packets remembered, which limits how old an acknowledgement can be and still be used
+#ifndef V2D_REPL_HISTORY
+#define V2D_REPL_HISTORY 32
+#endif
+
+// The default maximum packet size, in bytes
+#define V2D_REPL_MTU 1200
+
+// Returned instead of a network ID on failure
+#define V2D_REPL_ID_NONE UINT32_MAX
+
+// A replicated entity's state, as seen by a client
+struct v2d_repl_object {
+	uint32_t id, tag;
+	// The quantized position. Use v2d_repl_client_pos to convert it back into a vector
+	int32_t x, y;
+	// On the server, the tick this state was sent to the client
+	uint32_t tick;
+	uint32_t n_words;
+	uint32_t state[V2D_REPL_STATE_WORDS];
+};
+
+// The set of objects a client has, after receiving a particular packet. Objects are sorted by ID
+struct v2d_repl_view {
+	uint32_t seq;
+	struct v2d_repl_object *objs;
+	size_t n, cap;
+};
+
+// A change to a single object
+struct v2d_repl_entry {
+	enum v2d_repl_change {
+		V2D_REPL_SPAWN,
+		V2D_REPL_UPDATE,
+		V2D_REPL_DESPAWN,
+	} op;
+	double priority;
+	struct v2d_repl_object obj;
+};
+
+// A way of sending packets. Each end of a connection has an address
+struct v2d_repl_transport {
+	// Send a packet. Returns false on failure, which should raise an error saying why
+	// Packets that are sent but never arrive are recovered from, so this only needs to report failures the sender can see
+	_Bool (*send)(struct v2d_repl_transport *t, uint32_t to, const void *data, size_t len);
+	// Receive a packet sent to this address, returning its size and setting *from to the sender's address
+	// Returns 0 if there are no packets waiting. Packets larger than `cap` are discarded
+	size_t (*recv)(struct v2d_repl_transport *t, uint32_t *from, void *buf, size_t cap);
+
+	void *ctx;
+	uint32_t addr;
+};
+
+// Describes how to replicate one type of entity
+struct v2d_repl_type {
+	// Chosen by the game, and sent to clients so they know what to spawn
+	uint32_t tag;
+	// The number of state words, at most V2D_REPL_STATE_WORDS
+	uint32_t n_words;
+
+	// Return an entity's position
+	v2d_vec_t (*pos)(const v2d_ent_t *ent, void *ctx);
+	// Write an entity's state into n_words zeroed words
+	void (*save)(const v2d_ent_t *ent, uint32_t *state, void *ctx);
+
+	void *ctx;
+};
+
+// A client, as seen by the server
+struct v2d_repl_peer {
+	uint32_t addr;
+
+	// Entities further than `radius` from `view` aren't replicated to this client. The radius may be infinite
+	v2d_vec_t view;
+	double radius;
+
+	// The newest packet the client has acknowledged, or 0 if there are none
+	uint32_t baseline;
+	// What the client will have after receiving each recent packet, indexed by sequence number modulo V2D_REPL_HISTORY
+	struct v2d_repl_view views[V2D_REPL_HISTORY];
+
+	uint64_t bytes_sent;
+};
+
+struct v2d_repl_slot {
+	v2d_ent_t *ent; // NULL if the slot is free
+	uint32_t id;
+	uint32_t type; // Index into the server's types
+	uint32_t proxy;
+	uint32_t stamp; // Used to mark relevant entities
+};
+
+struct v2d_repl_server {
+	struct v2d_repl_transport *transport;
+	// The size of one step of a quantized position
+	double precision;
+	// The maximum size of a packet, in bytes. It may be changed between ticks
+	size_t budget;
+	// The sequence number of the last packet sent, which is also the current tick
+	uint32_t seq;
+
+	struct v2d_repl_type *types;
+	size_t n_types, cap_types;
+
+	// Tracked entities and their current state, indexed by the low 24 bits of their network IDs
+	struct v2d_repl_slot *slots;
+	struct v2d_repl_object *state;
+	size_t n_slots, cap_slots, cap_state;
+	uint32_t *free_slots;
+	size_t n_free, cap_free;
+
+	// Used to find relevant entities
+	v2d_broad_t broad;
+	uint32_t stamp;
+
+	struct v2d_repl_peer *peers;
+	size_t n_peers, cap_peers;
+
+	// Scratch space
+	uint32_t *relevant;
+	size_t cap_relevant;
+	struct v2d_repl_entry *entries;
+	size_t n_entries, cap_entries;
+	unsigned char *packet;
+	size_t cap_packet;
+};
+
+struct v2d_repl_client {
+	struct v2d_repl_transport *transport;
+	uint32_t server; // The server's address
+	double precision;
+	// The largest packet that can be received, in bytes. Larger packets are dropped, so this should be at least the server's budget
+	size_t max_packet;
+
+	// The newest packet received
+	uint32_t seq;
+	// The objects after receiving each recent packet, indexed by sequence number modulo V2D_REPL_HISTORY
+	struct v2d_repl_view views[V2D_REPL_HISTORY];
+
+	// Called for every object that changes when a packet is received
+	void (*on_change)(void *ctx, const struct v2d_repl_object *obj, enum v2d_repl_change change);
+	void *ctx;
+
+	uint64_t bytes_received;
+
+	// Scratch space
+	struct v2d_repl_view scratch;
+	struct v2d_repl_entry *entries;
+	size_t n_entries, cap_entries;
+	unsigned char *packet;
+	size_t cap_packet;
+};
+
+// Server
+
+// Create a replication server which sends packets through `transport`
+// Returns NULL on failure
+v2d_repl_server_t *v2d_repl_server_new(struct v2d_repl_transport *transport, double precision);
+
+// Free a replication server
+void v2d_repl_server_free(v2d_repl_server_t *server);
+
+// Register how to replicate a type of entity. Registering a tag again replaces it
+// Returns false on failure
+_Bool v2d_repl_register(v2d_repl_server_t *server, const struct v2d_repl_type *type);
+
+// Start replicating an entity of a registered type
+// Returns its network ID, or V2D_REPL_ID_NONE on failure
+uint32_t v2d_repl_track(v2d_repl_server_t *server, v2d_ent_t *ent, uint32_t tag);
+
+// Stop replicating an entity. Clients will see it despawn
+void v2d_repl_untrack(v2d_repl_server_t *server, uint32_t id);
+
+// Start replicating to a client at `addr`. By default it can see everything
+// Returns false on failure
+_Bool v2d_repl_add_peer(v2d_repl_server_t *server, uint32_t addr);
+
+// Stop replicating to a client
+void v2d_repl_del_peer(v2d_repl_server_t *server, uint32_t addr);
+
+// Set which part of the world a client can see
+void v2d_repl_set_view(v2d_repl_server_t *server, uint32_t addr, v2d_vec_t view, double radius);
+
+// Receive acknowledgements, capture the state of every tracked entity and send a packet to each client
+// Returns false on failure, including when the transport fails to send a packet. The other clients are still sent theirs
+_Bool v2d_repl_server_tick(v2d_repl_server_t *server);
+
+// Client
+
+// Create a replication client which receives packets from the server at `server_addr`
+// `precision` must match the server's
+// Returns NULL on failure
+v2d_repl_client_t *v2d_repl_client_new(struct v2d_repl_transport *transport, uint32_t server_addr, double precision);
+
+// Free a replication client
+void v2d_repl_client_free(v2d_repl_client_t *client);
+
+// Receive and apply every waiting packet, calling on_change for each object that changes
+// Returns false on failure, including when the transport fails to send an acknowledgement
+_Bool v2d_repl_client_poll(v2d_repl_client_t *client);
+
+// Find an object by its network ID
+// Returns NULL if the client doesn't have it
+const struct v2d_repl_object *v2d_repl_client_find(const v2d_repl_client_t *client, uint32_t id);
+
+// Return an object's position
+v2d_vec_t v2d_repl_client_pos(const v2d_repl_client_t *client, const struct v2d_repl_object *obj);
+
+// Loopback transport
+
+struct v2d_repl_packet {
+	uint32_t from, to;
+	unsigned char *data;
+	size_t len;
+};
+
+// Delivers packets between transports in the same process
+struct v2d_repl_loopback {
+	struct v2d_repl_packet *packets;
+	size_t n_packets, cap_packets;
+
+	// If non-zero, every drop_every-th packet is lost, to test recovery
+	unsigned drop_every;
+	unsigned n_sent;
+};
+
+// Initialize a loopback network
+void v2d_repl_loopback_init(struct v2d_repl_loopback *lb);
+
+// Free a loopback network and any undelivered packets
+void v2d_repl_loopback_destroy(struct v2d_repl_loopback *lb);
+
+// Return a transport that sends and receives packets on the loopback network using address `addr`
+struct v2d_repl_transport v2d_repl_loopback_transport(struct v2d_repl_loopback *lb, uint32_t addr);
+
+#endif
@@ -0,0 +1,109 @@
+/* v2d/rollback.h
+ *
+ * Rollback lets a game rewind to an earlier tick and simulate forward again.
+ * Networked games use it to hide latency: they predict the inputs of remote
+ * players, and when the real inputs arrive late, they roll back to the tick
+ * the inputs belong to and resimulate every tick since, all within a single
+ * frame.
+ *
+ * Every tick, the world is saved as a snapshot (see v2d/snapshot.h) along
+ * with the value of every action. Snapshots are stored in a ring buffer. To
+ * save memory, only every V2D_ROLLBACK_KEYFRAME-th snapshot is stored in full,
+ * and the rest are stored as a run-length encoded difference from the
+ * previous full snapshot. Since identical worlds give identical snapshots,
+ * these differences are usually small.
+ *
+ * A difference can only be restored while its full snapshot is still in the
+ * buffer, so the oldest ticks that can be restored are the ones from the
+ * oldest remembered keyframe onwards. That is always at least the last
+ * V2D_ROLLBACK_FRAMES - V2D_ROLLBACK_KEYFRAME + 1 ticks.
+ *
+ * Restoring a tick removes every saved entity from the world and loads them
+ * again from the snapshot, so pointers to them don't survive a rollback.
+ * Entities with a snapshot type of 0 are left alone. The world's time, and
+ * which entities are asleep, when they wake, their LOD buckets and the order
+ * they update in, are restored along with them, so the resimulated ticks
+ * update the same entities in the same order as the original ones did.
+ *
+ * Resimulation is only correct if updates are deterministic, so ticks are
+ * always a fixed length. The built-in game loop can run a rollback instead
+ * of updating the world directly; see v2d/gameloop.h.
+ *
+ */
+#ifndef _V2D_ROLLBACK_H
+#define _V2D_ROLLBACK_H
+
+#include <stdint.h>
+#include "v2d.h"
+#include "v2d/snapshot.h"
+#include "v2d/vector.h"
+
+// The number of ticks remembered
+#ifndef V2D_ROLLBACK_FRAMES
+#define V2D_ROLLBACK_FRAMES 64
+#endif
+
+// How often a full snapshot is stored. Must divide V2D_ROLLBACK_FRAMES
+#ifndef V2D_ROLLBACK_KEYFRAME
+#define V2D_ROLLBACK_KEYFRAME 8
+#endif
+
+struct v2d_rollback_frame {
+	uint32_t tick;
+	_Bool valid;
+	// Whether the state is stored as a difference from the keyframe
+	_Bool delta;
+	// The state of the world at the start of the tick. Either a snapshot, or a difference from the last keyframe
+	struct v2d_snap_buf state;
+	// The value of every action during the tick
+	v2d_vec_t *inputs;
+};
+
+struct v2d_rollback {
+	v2d_world_t *world;
+	v2d_action_dispatcher_t dis;
+	// The length of a tick, in seconds
+	double dt;
+
+	// The number of ticks simulated so far
+	uint32_t tick;
+
+	// The earliest tick whose inputs have been changed, if resim is true
+	_Bool resim;
+	uint32_t resim_from;
+
+	// The number of ticks simulated by resimulation, for profiling
+	uint64_t resim_ticks;
+
+	struct v2d_rollback_frame frames[V2D_ROLLBACK_FRAMES];
+
+	// Scratch space
+	struct v2d_snap_buf scratch;
+	v2d_vec_t *live_inputs;
+};
+
+// Create a rollback buffer for a world and its action dispatcher, with ticks `dt` seconds long
+// Returns NULL on failure
+v2d_rollback_t *v2d_rollback_new(v2d_world_t *world, v2d_action_dispatcher_t dis, double dt);
+
+// Free a rollback buffer. The world is not affected
+void v2d_rollback_free(v2d_rollback_t *rb);
+
+// Simulate one tick: resimulate if any past inputs were changed, then save the world and the current action values, then update the world
+// Returns false on failure
+_Bool v2d_rollback_tick(v2d_rollback_t *rb);
+
+// Change the value an action had during a past tick, such as when a remote player's input arrives late
+// Ticks after it are resimulated by the next call to v2d_rollback_tick or v2d_rollback_resimulate
+// Returns false if the tick is too old or hasn't happened yet, or there is no such action
+_Bool v2d_rollback_set_input(v2d_rollback_t *rb, uint32_t tick, const char *action, v2d_vec_t value);
+
+// Roll back to the earliest tick whose inputs changed, and simulate every tick since then again
+// Returns false on failure
+_Bool v2d_rollback_resimulate(v2d_rollback_t *rb);
+
+// Restore the world to its state at the start of a tick, and forget every tick after it
+// Returns false if the tick is too old, or on failure
+_Bool v2d_rollback_restore(v2d_rollback_t *rb, uint32_t tick);
+
+#endif
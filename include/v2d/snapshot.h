@@ -0,0 +1,202 @@
+/* v2d/snapshot.h
+ *
+ * Snapshots save the contents of a world, along with the state of an action
+ * dispatcher, in a compact binary format. They can be written to a file or
+ * kept in memory, which makes them useful for save games, checkpoints,
+ * rollback and level loading.
+ *
+ * v2d doesn't know what is inside an entity, so each type of entity that
+ * should be saved needs a serializer, registered with v2d_snap_register.
+ * Entities select their serializer using the `type` field of their
+ * v2d_ent_cb_t. Every entity of a type is saved as a fixed-size record, and
+ * records of the same type are stored together in a section.
+ *
+ * Loading is zero-copy: v2d_snap_open maps the file into memory, and the
+ * records passed to load callbacks point directly into the mapping. Entities
+ * may keep pointers to their records, such as large arrays of level data,
+ * for as long as the snapshot stays open.
+ *
+ * Snapshots also save the world's clock and how each entity is scheduled:
+ * whether it is asleep and when it wakes, its LOD bucket, its layer, and the
+ * order awake entities are updated in. For these to be restored, load
+ * callbacks must add their entity to the world themselves, with
+ * v2d_world_add_entity or v2d_world_add_pooled, rather than deferring it.
+ * Timers other than entity wake-ups are not saved.
+ *
+ * Records are written with the byte order and alignment of the machine that
+ * saved them. Vectors, transforms and shapes should be stored using the
+ * v2d_snap_* record types below, which are always double precision, so
+ * snapshots work with and without V2D_VEC_FLOAT.
+ *
+ */
+#ifndef _V2D_SNAPSHOT_H
+#define _V2D_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "v2d.h"
+#include "v2d/collide.h"
+#include "v2d/transform.h"
+#include "v2d/vector.h"
+
+// The version of the snapshot format written by this version of v2d
+#define V2D_SNAP_VERSION 1
+
+// Section tags from here up are reserved for v2d's own use
+#define V2D_SNAP_TAG_RESERVED 0xffffff00u
+#define V2D_SNAP_TAG_ORDER 0xffffff00u // The type of every entity, in world order
+#define V2D_SNAP_TAG_ACTIONS 0xffffff01u // Action values
+#define V2D_SNAP_TAG_CLOCK 0xffffff02u // The world's clock, see v2d_world_get_clock
+#define V2D_SNAP_TAG_SCHEDULE 0xffffff03u // The sleep, LOD and layer state of every entity, in world order
+#define V2D_SNAP_TAG_AWAKE 0xffffff04u // The sequence numbers of the awake entities, in update order
+
+struct v2d_snap_header {
+	char magic[4]; // "V2DS"
+	uint32_t version;
+	uint32_t byte_order; // 0x01020304, as written by the saving machine
+	uint32_t n_sections;
+};
+
+struct v2d_snap_section {
+	uint32_t tag;
+	uint32_t version; // The version of the entity type's serializer
+	uint32_t record_size;
+	uint32_t reserved;
+	uint64_t count;
+	uint64_t offset; // From the start of the snapshot, always a multiple of 16
+};
+
+struct v2d_snap_action {
+	uint64_t id_hash;
+	double x, y;
+};
+
+// A serializer for one type of entity
+struct v2d_snap_type {
+	// The value of `type` in the entity's v2d_ent_cb_t. Must be non-zero and below V2D_SNAP_TAG_RESERVED
+	uint32_t tag;
+	// Incremented when the record layout changes, so load can handle old snapshots
+	uint32_t version;
+	// The size of each record. Snapshots with smaller records for this type are rejected, so new versions may only make it larger
+	uint32_t record_size;
+
+	// Write an entity into a zeroed record of record_size bytes
+	void (*save)(const v2d_ent_t *ent, void *rec, void *ctx);
+	// Create an entity from a record, and add it to the world
+	// Returns false on failure
+	_Bool (*load)(v2d_world_t *world, const void *rec, uint32_t version, void *ctx);
+
+	// Passed to save and load
+	void *ctx;
+};
+
+// A growable buffer that snapshots are written into
+struct v2d_snap_buf {
+	unsigned char *data;
+	size_t len, cap;
+};
+
+// An open snapshot
+struct v2d_snap {
+	const unsigned char *data;
+	size_t len;
+	const struct v2d_snap_header *header;
+	const struct v2d_snap_section *sections;
+
+	// How the data was obtained, so it can be released by v2d_snap_close
+	enum {
+		V2D_SNAP_BORROWED,
+		V2D_SNAP_MAPPED,
+		V2D_SNAP_ALLOCATED,
+	} storage;
+};
+
+// Register a serializer. Registering a tag again replaces its serializer
+// Returns false on failure
+_Bool v2d_snap_register(const struct v2d_snap_type *type);
+
+// Write a snapshot of a world, and the actions of `dis` if it isn't NULL, into a buffer
+// The buffer's previous contents are replaced. Entities with unregistered types are skipped
+// Returns false on failure
+_Bool v2d_snap_write(struct v2d_snap_buf *buf, v2d_world_t *world, const v2d_action_dispatcher_t *dis);
+
+// Free a buffer's memory
+void v2d_snap_buf_free(struct v2d_snap_buf *buf);
+
+// Write a snapshot to a file
+// Returns false on failure
+_Bool v2d_snap_save(const char *path, v2d_world_t *world, const v2d_action_dispatcher_t *dis);
+
+// Open a snapshot file, mapping it into memory where possible
+// Returns false on failure
+_Bool v2d_snap_open(v2d_snap_t *snap, const char *path);
+
+// Open a snapshot held in memory. The memory is not copied, so it must stay valid until the snapshot is closed
+// Returns false if the data is not a valid snapshot
+_Bool v2d_snap_open_mem(v2d_snap_t *snap, const void *data, size_t len);
+
+// Close a snapshot. Pointers to its records are no longer valid afterwards
+void v2d_snap_close(v2d_snap_t *snap);
+
+// Return a pointer to the records in a section, and set *count to the number of records
+// Returns NULL if there is no such section
+const void *v2d_snap_records(const v2d_snap_t *snap, uint32_t tag, size_t *count);
+
+// Create the entities in a snapshot, adding them to a world in the order they were saved, and restore the actions of `dis` if it isn't NULL
+// Returns false on failure
+_Bool v2d_snap_load(const v2d_snap_t *snap, v2d_world_t *world, const v2d_action_dispatcher_t *dis);
+
+// Portable record types
+
+struct v2d_snap_vec {
+	double x, y;
+};
+
+struct v2d_snap_transform {
+	struct v2d_snap_vec mul, add;
+};
+
+// For circles, `a` is the position and `b.x` is the radius. For rects, `a` is the position and `b` is the dimensions
+struct v2d_snap_shape {
+	uint32_t type;
+	uint32_t reserved;
+	struct v2d_snap_vec a, b;
+};
+
+static inline struct v2d_snap_vec v2d_snap_put_vec(v2d_vec_t v) {
+	return (struct v2d_snap_vec){v2dvx(v), v2dvy(v)};
+}
+
+static inline v2d_vec_t v2d_snap_get_vec(struct v2d_snap_vec v) {
+	return v2d_vec(v.x, v.y);
+}
+
+static inline struct v2d_snap_transform v2d_snap_put_transform(v2d_transform_t tr) {
+	return (struct v2d_snap_transform){v2d_snap_put_vec(tr.mul), v2d_snap_put_vec(tr.add)};
+}
+
+static inline v2d_transform_t v2d_snap_get_transform(struct v2d_snap_transform tr) {
+	return (v2d_transform_t){v2d_snap_get_vec(tr.mul), v2d_snap_get_vec(tr.add)};
+}
+
+static inline struct v2d_snap_shape v2d_snap_put_shape(v2d_shape_t s) {
+	struct v2d_snap_shape out = {.type = s.type};
+	switch (s.type) {
+	case V2D_SHAPE_CIRCLE:
+		out.a = v2d_snap_put_vec(s.s.circle.pos);
+		out.b.x = s.s.circle.rad;
+		break;
+	case V2D_SHAPE_RECT:
+		out.a = v2d_snap_put_vec(s.s.rect.pos);
+		out.b = v2d_snap_put_vec(s.s.rect.dim);
+		break;
+	}
+	return out;
+}
+
+static inline v2d_shape_t v2d_snap_get_shape(struct v2d_snap_shape s) {
+	if (s.type == V2D_SHAPE_CIRCLE) return V2D_SHAPE_CIRCLE_LIT(v2d_snap_get_vec(s.a), s.b.x);
+	return V2D_SHAPE_RECT_LIT(v2d_snap_get_vec(s.a), v2d_snap_get_vec(s.b));
+}
+
+#endif
@@ -0,0 +1,85 @@
+/* v2d/static.h
+ *
+ * A static index holds colliders that never move, such as level geometry.
+ * It is built once from an array of shapes and can't be changed afterwards,
+ * which lets it be much more compact and faster to search than the broad
+ * phase in v2d/broad.h.
+ *
+ * The index is a bounding volume hierarchy packed using the Sort-Tile-Recursive
+ * algorithm: shapes are sorted into vertical slices by x, each slice is
+ * sorted by y and cut into leaves of V2D_STATIC_NODE_SIZE shapes, and the
+ * leaves are grouped into parent nodes the same way until a single root
+ * remains. Every node is stored in one flat array, with each node's children
+ * next to each other, so searching it touches very little memory.
+ *
+ * A collision pipeline (see v2d/pipeline.h) can be given a static index, in
+ * which case it tests every active proxy in its broad phase against the index
+ * as well as against each other. Static colliders are never tested against
+ * each other.
+ *
+ */
+#ifndef _V2D_STATIC_H
+#define _V2D_STATIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "v2d.h"
+#include "v2d/broad.h"
+#include "v2d/collide.h"
+
+// The maximum number of children of each node
+#define V2D_STATIC_NODE_SIZE 8
+
+struct v2d_static_node {
+	v2d_vec_t min, max;
+	// The range of this node's children in `nodes`, or of its shapes in `items` if it is a leaf
+	uint32_t first, count;
+	_Bool leaf;
+};
+
+// A shape's bounding box, stored in leaf order
+struct v2d_static_item {
+	v2d_vec_t min, max;
+	uint32_t id;
+};
+
+struct v2d_static {
+	// The shapes, user data and filters, indexed by ID, which is each shape's position in the arrays the index was built from
+	v2d_shape_t *shapes;
+	void **data;
+	v2d_filter_t *filters;
+	size_t n_shapes;
+
+	struct v2d_static_item *items;
+
+	// The root is the last node
+	struct v2d_static_node *nodes;
+	size_t n_nodes;
+};
+
+// Build a static index from `n` shapes
+// `data` and `filters` may be NULL, in which case every shape's data is NULL and its filter is V2D_FILTER_DEFAULT
+// Returns NULL on failure
+v2d_static_t *v2d_static_new(const v2d_shape_t *shapes, void *const *data, const v2d_filter_t *filters, size_t n);
+
+// Free a static index
+void v2d_static_free(v2d_static_t *index);
+
+// Called by v2d_static_visit for each shape found. Returning false stops the query
+typedef _Bool (*v2d_static_visit_t)(const v2d_static_t *index, uint32_t id, void *ctx);
+
+// Call `fn` for every shape whose bounding box overlaps the box from `min` to `max`
+// If `filter` is not NULL, only shapes it finds are visited, as in v2d/broad.h
+void v2d_static_visit(const v2d_static_t *index, v2d_vec_t min, v2d_vec_t max, const v2d_filter_t *filter, v2d_static_visit_t fn, void *ctx);
+
+// Find every shape whose bounding box overlaps the box from `min` to `max`
+// Up to `max_out` IDs are written into `out`
+// Returns the total number of shapes found, which may be more than `max_out`
+size_t v2d_static_query(const v2d_static_t *index, v2d_vec_t min, v2d_vec_t max, const v2d_filter_t *filter, uint32_t *out, size_t max_out);
+
+// Find the first shape hit by a ray, which runs from r.pos to r.pos + r.dir
+// If `t` is not NULL, it receives the fraction of the ray's length at which the shape was hit
+// Returns the shape's ID, or V2D_PROXY_NONE if nothing was hit
+uint32_t v2d_static_raycast(const v2d_static_t *index, v2d_ray_t ray, const v2d_filter_t *filter, double *t);
+
+#endif
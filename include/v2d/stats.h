@@ -0,0 +1,57 @@
+/* v2d/stats.h
+ *
+ * v2d keeps a few counters of the work it does, such as how many entities
+ * were updated and how many draw calls were issued. They are always enabled
+ * and cost no more than an addition each, so they can be used to spot
+ * performance regressions in release builds without attaching a profiler.
+ *
+ * The counters are grouped into frames. If you use the built-in game loop this
+ * is done for you, otherwise call v2d_stats_end_frame once per frame.
+ *
+ */
+#ifndef _V2D_STATS_H
+#define _V2D_STATS_H
+
+#include <stdint.h>
+#include "v2d.h"
+
+struct v2d_stats_counters {
+	uint64_t entities_updated; // Entity update callbacks called
+	uint64_t draw_calls; // Calls to v2d_render_clear and v2d_render_draw_*
+	uint64_t sdl_calls; // Calls into SDL's renderer and event queue
+	uint64_t pairs_tested; // Shape-to-shape collision tests
+	uint64_t pairs_hit; // Shape-to-shape collision tests that found a collision
+	uint64_t allocs; // Memory allocations made by v2d
+};
+
+struct v2d_stats {
+	// The number of frames completed
+	uint64_t frames;
+	// The work done during the last completed frame
+	struct v2d_stats_counters frame;
+	// The work done during every completed frame
+	struct v2d_stats_counters total;
+};
+
+// The counters for the frame currently in progress
+// These are plain globals so they're as cheap as possible to increment, which means they should only be modified from one thread
+extern struct v2d_stats_counters v2d_stats_current;
+
+// Add n to one of the current frame's counters
+#define v2d_stat_add(counter, n) (v2d_stats_current.counter += (n))
+
+// Get a copy of the counters
+v2d_stats_t v2d_stats_snapshot(void);
+
+// Finish the current frame and start a new one
+void v2d_stats_end_frame(void);
+
+// Reset every counter to zero
+void v2d_stats_reset(void);
+
+// Draw the last frame's counters in the top left corner of the screen
+// Each counter is a bar, in the same order as struct v2d_stats_counters from top to bottom
+// The bars use a log scale: each tick mark is a factor of 10, so a bar reaching the third tick after the start means a value of 1000
+void v2d_stats_draw_overlay(v2d_render_t *render);
+
+#endif
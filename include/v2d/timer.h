@@ -0,0 +1,89 @@
+/* v2d/timer.h
+ *
+ * Timers call a function once a given amount of time has passed. They are
+ * kept in a hierarchical timing wheel, so starting, stopping and firing a
+ * timer all take constant time no matter how many timers are pending, and
+ * time can be advanced without looking at timers that aren't due yet.
+ *
+ * A wheel counts time in ticks of a fixed length. It has V2D_TIMER_LEVELS
+ * levels of V2D_TIMER_SLOTS slots each. Level 0 holds the timers due in the
+ * next V2D_TIMER_SLOTS ticks, one slot per tick. Each level above covers
+ * V2D_TIMER_SLOTS times as long as the one below, and whenever the level
+ * below wraps around, the timers in the next slot up are moved down. Timers
+ * too far in the future for the top level wait in its furthest slot and are
+ * moved again when it comes round.
+ *
+ * Timers are intrusive: embed a v2d_timer_t in your own struct and find the
+ * struct again in the callback using the `data` field or the timer's address.
+ * The wheel never allocates, and timers must not be freed while pending.
+ *
+ * Every world has a wheel, which v2d_loop_update_world advances. Entities
+ * use it to sleep between updates (see v2d_world_sleep in v2d/world.h), and
+ * anything else can use it for delayed callbacks.
+ *
+ */
+#ifndef _V2D_TIMER_H
+#define _V2D_TIMER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "v2d.h"
+
+#define V2D_TIMER_LEVELS 4
+#define V2D_TIMER_SLOT_BITS 6
+#define V2D_TIMER_SLOTS (1 << V2D_TIMER_SLOT_BITS)
+
+typedef void (*v2d_timer_callback_t)(v2d_timer_t *timer, void *data);
+
+struct v2d_timer {
+	// Called when the timer fires. The timer is no longer pending by then, so the callback may start it again
+	v2d_timer_callback_t fn;
+	void *data;
+
+	// Used internally
+	uint64_t when;
+	struct v2d_timer *next, **pprev;
+};
+
+struct v2d_timer_wheel {
+	// The length of a tick, in seconds
+	double resolution;
+	// Time passed to v2d_timer_advance that doesn't yet make up a whole tick
+	double accumulator;
+
+	// The number of ticks that have passed
+	uint64_t now;
+	size_t n_pending;
+
+	struct v2d_timer *slots[V2D_TIMER_LEVELS][V2D_TIMER_SLOTS];
+};
+
+// Initialize an empty wheel with ticks `resolution` seconds long
+void v2d_timer_wheel_init(v2d_timer_wheel_t *wheel, double resolution);
+
+// Initialize a timer that calls `fn` with `data` when it fires
+void v2d_timer_init(v2d_timer_t *timer, v2d_timer_callback_t fn, void *data);
+
+// Start a timer that fires after at least `seconds` seconds. If the timer is already pending, it is restarted
+void v2d_timer_start(v2d_timer_wheel_t *wheel, v2d_timer_t *timer, double seconds);
+
+// Start a timer that fires after `ticks` ticks, or at the next tick if `ticks` is 0. If the timer is already pending, it is restarted
+void v2d_timer_start_ticks(v2d_timer_wheel_t *wheel, v2d_timer_t *timer, uint64_t ticks);
+
+// Stop a timer. Does nothing if it isn't pending
+void v2d_timer_stop(v2d_timer_wheel_t *wheel, v2d_timer_t *timer);
+
+// Set the number of ticks that have passed. Pending timers keep the number of ticks they have left
+void v2d_timer_set_now(v2d_timer_wheel_t *wheel, uint64_t now);
+
+// Return true if a timer has been started and has not yet fired or been stopped
+static inline _Bool v2d_timer_pending(const v2d_timer_t *timer) {
+	return timer->pprev != NULL;
+}
+
+// Advance a wheel by `seconds` seconds, firing every timer that becomes due
+// Timers fire in order of their due tick, and in an unspecified order within a tick
+// Returns the number of timers fired
+size_t v2d_timer_advance(v2d_timer_wheel_t *wheel, double seconds);
+
+#endif
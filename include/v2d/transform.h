@@ -4,22 +4,27 @@
  * complex numbers. Any translation, rotation or scale of a complex
  * number b can be represented using the form `ab + c` where a and c
  * are complex numbers.
+ *
+ * As well as transforming single vectors, this file provides functions that
+ * transform whole arrays of vectors at once, and a helper for hierarchies of
+ * transformations such as scene graphs.
  * 
  */
 // Note: this file's implementation is in vector.c not transform.c
 #ifndef _V2D_TRANSFORM_H
 #define _V2D_TRANSFORM_H
 
+#include <stddef.h>
 #include "v2d/vector.h"
 
 typedef struct {
-	double _Complex mul, add;
+	v2d_vec_t mul, add;
 } v2d_transform_t;
 
 v2d_transform_t v2d_transform_new(void);
 
 // Transform a vector
-#define v2d_transform(v, tr) ((v)*(tr).mul + (tr).add)
+#define v2d_transform(v, tr) (v2d_vec_mul((v), (tr).mul) + (tr).add)
 
 // Take the inverse of a transformation
 // v2d_transform(v2d_transform(v, tr), v2d_tr_invert(tr)) == v
@@ -33,4 +38,46 @@ void v2d_tr_rotate(v2d_transform_t *tr, double theta);
 void v2d_tr_scale(v2d_transform_t *tr, double sf);
 void v2d_tr_translate(v2d_transform_t *tr, v2d_vec_t delta);
 
+// Return the unit vector at angle theta, for use with v2d_tr_rotate_by
+v2d_vec_t v2d_vec_cis(double theta);
+
+// Rotate by a unit vector returned by v2d_vec_cis
+// This avoids recomputing sin and cos when rotating many transformations by the same angle
+void v2d_tr_rotate_by(v2d_transform_t *tr, v2d_vec_t rot);
+
+// --- Bulk transformations ---
+// In all of these, the output arrays may be the same as the input arrays, but must not otherwise overlap with them
+
+// Transform an array of n vectors by the same transformation
+void v2d_tr_apply_n(v2d_transform_t tr, v2d_vec_t *out, const v2d_vec_t *in, size_t n);
+
+// Transform n vectors stored as separate arrays of x and y components
+void v2d_tr_apply_soa(v2d_transform_t tr, v2d_real_t *out_x, v2d_real_t *out_y, const v2d_real_t *in_x, const v2d_real_t *in_y, size_t n);
+
+// Transform in[i] by trs[i] for every i below n
+void v2d_tr_apply_each(const v2d_transform_t *trs, v2d_vec_t *out, const v2d_vec_t *in, size_t n);
+
+// --- Transformation hierarchies ---
+
+// A node in a hierarchy of transformations, such as a scene graph
+struct v2d_tr_node {
+	// The transformation relative to the parent node
+	v2d_transform_t local;
+	// The transformation relative to the root, computed by v2d_tr_tree_update
+	// This transforms by `local`, then by the parent's `world`
+	v2d_transform_t world;
+	// The index of the parent node, or -1 for a root node
+	// A node's parent must come before it in the array
+	int parent;
+	// Set this to true after changing `local`
+	_Bool dirty;
+	// Used internally by v2d_tr_tree_update
+	_Bool changed;
+};
+
+// Recompute the world transformations of every dirty node and its descendants
+// Nodes that are not dirty and have no dirty ancestors are left alone
+// Returns the number of nodes that were recomputed
+size_t v2d_tr_tree_update(struct v2d_tr_node *nodes, size_t n);
+
 #endif
@@ -0,0 +1,48 @@
+/* v2d/vec2f.h
+ *
+ * v2d_vec2f_t is a single precision 2D vector stored as a plain struct. It
+ * takes half the memory of v2d_vec_t, and arrays of them can be processed
+ * several vectors at a time using SIMD instructions.
+ *
+ * This file provides conversions to and from v2d_vec_t, as well as batch
+ * operations that work on whole arrays of vectors at once. These use SSE on
+ * x86 and NEON on ARM, and fall back to plain C elsewhere.
+ *
+ * Unless stated otherwise, the output array of a batch operation may be the
+ * same as an input array, but must not otherwise overlap with it.
+ *
+ */
+#ifndef _V2D_VEC2F_H
+#define _V2D_VEC2F_H
+
+#include <stddef.h>
+#include "v2d/transform.h"
+#include "v2d/vector.h"
+
+typedef struct {
+	float x, y;
+} v2d_vec2f_t;
+
+// Convert a v2d_vec_t to a v2d_vec2f_t
+#define v2d_vec2f(v) ((v2d_vec2f_t){(float)v2dvx(v), (float)v2dvy(v)})
+
+// Convert a v2d_vec2f_t to a v2d_vec_t
+#define v2d_vec2f_vec(v) (v2d_vec((v).x, (v).y))
+
+// out[i] = the dot product of a[i] and b[i]
+void v2d_vec2f_dot_n(float *out, const v2d_vec2f_t *a, const v2d_vec2f_t *b, size_t n);
+
+// out[i] = the square of the magnitude of v[i]
+void v2d_vec2f_mag2_n(float *out, const v2d_vec2f_t *v, size_t n);
+
+// out[i] = v[i] normalized. Zero vectors stay zero
+void v2d_vec2f_norm_n(v2d_vec2f_t *out, const v2d_vec2f_t *v, size_t n);
+
+// out[i] = v[i] rotated by theta radians
+// sin and cos are only calculated once for the whole array
+void v2d_vec2f_rotate_n(v2d_vec2f_t *out, const v2d_vec2f_t *v, size_t n, float theta);
+
+// out[i] = v[i] transformed by tr, in single precision
+void v2d_vec2f_transform_n(v2d_vec2f_t *out, const v2d_vec2f_t *v, size_t n, v2d_transform_t tr);
+
+#endif
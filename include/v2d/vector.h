@@ -18,16 +18,54 @@
  * functions and macros defined in `complex.h`. If you wish, you may use
  * the standard library functions instead.
  *
+ * If V2D_VEC_FLOAT is defined when compiling both v2d and your program,
+ * vectors use single precision instead, which halves the memory and
+ * bandwidth used by large arrays of them. v2d_real_t is the type of a
+ * single vector component in either case. For explicitly single precision
+ * vectors with batch operations, see v2d/vec2f.h
+ *
+ * If V2D_DETERMINISTIC is defined, vectors, transformations and collision
+ * detection give bit-identical results on every compiler and CPU, which is
+ * needed for lockstep networking and replays. Basic IEEE 754 arithmetic and
+ * sqrt are already exactly rounded, so this mode refuses to compile when the
+ * compiler may reorder or widen floating point operations, and replaces the
+ * C library's sin and cos, whose results vary between implementations, with
+ * its own. v2d's Makefile disables contraction into fused multiply-adds in
+ * this mode; programs built with Clang, or with GCC in a GNU mode, should
+ * pass -ffp-contract=off too.
+ *
  */
 #ifndef _V2D_VECTOR_H
 #define _V2D_VECTOR_H
 
 #include <complex.h>
+#include <math.h>
+
+#ifdef V2D_DETERMINISTIC
+#include <float.h>
+#ifdef __FAST_MATH__
+#error "V2D_DETERMINISTIC cannot be used with -ffast-math"
+#endif
+#if FLT_EVAL_METHOD != 0
+#error "V2D_DETERMINISTIC requires FLT_EVAL_METHOD == 0 (on 32-bit x86, compile with -msse2 -mfpmath=sse)"
+#endif
+#ifdef __clang__
+#pragma STDC FP_CONTRACT OFF
+#endif
+#endif
 
+#ifdef V2D_VEC_FLOAT
+typedef float v2d_real_t;
+typedef float _Complex v2d_vec_t;
+#else
+typedef double v2d_real_t;
 typedef double _Complex v2d_vec_t;
+#endif
 
 // Create a vector from X and Y components
-#if defined(CMPLX)
+#if defined(V2D_VEC_FLOAT) && defined(CMPLXF)
+#define v2d_vec(x, y) (CMPLXF((x), (y)))
+#elif !defined(V2D_VEC_FLOAT) && defined(CMPLX)
 #define v2d_vec(x, y) (CMPLX((x), (y)))
 #else
 #define v2d_vec(x, y) ((x) + (y)*I)
@@ -42,8 +80,8 @@ typedef double _Complex v2d_vec_t;
 // Return the x and y components of a vector, separated by a comma
 #define v2d_vec_xy(v) v2dvx(v), v2dvy(v)
 
-// Convert a vector to a pointer to two doubles
-#define v2d_vec_a(v) ((double *)(&(v))) // This is well-defined by C99 - see section 6.2.5, point 13
+// Convert a vector to a pointer to two v2d_real_t
+#define v2d_vec_a(v) ((v2d_real_t *)(&(v))) // This is well-defined by C99 - see section 6.2.5, point 13
 
 // Return an lvalue referencing the X component of a vector
 #define v2d_vec_x(v) (v2d_vec_a(v)[0])
@@ -54,11 +92,19 @@ typedef double _Complex v2d_vec_t;
 // Return the X or Y component of a vector depending on idx
 #define v2d_vec_idx(v, i) ((i) ? cimag(v) : creal(v))
 
+// Multiply two vectors with complex number semantics
+// Unlike the * operator, this doesn't check for infinities and NaNs, which makes it much faster
+static inline v2d_vec_t v2d_vec_mul(v2d_vec_t a, v2d_vec_t b) {
+	v2d_real_t ax = v2dvx(a), ay = v2dvy(a), bx = v2dvx(b), by = v2dvy(b);
+	return v2d_vec(ax*bx - ay*by, ax*by + ay*bx);
+}
+
 // Calculate the square of a vector's magnitude
 double v2d_vec_mag2(v2d_vec_t v);
 
 // Calculate a vector's magnitude
-#define v2d_vec_mag(v) (cabs(v))
+// Unlike cabs, this can overflow for components larger than about 1e154, but it is much faster
+#define v2d_vec_mag(v) (sqrt(v2d_vec_mag2(v)))
 
 // Normalize a vector
 v2d_vec_t v2d_vec_norm(v2d_vec_t v);
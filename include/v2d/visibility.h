@@ -0,0 +1,85 @@
+/* v2d/visibility.h
+ *
+ * Visibility calculations work out which parts of the world can be seen
+ * from a point. This is useful for line-of-sight checks, field-of-view
+ * effects and 2D lighting.
+ *
+ * The result is the visibility polygon: the region that is visible from the
+ * origin, out to a square of a given range around it. It is computed with an
+ * angular sweep over the endpoints of every occluder edge, which needs far
+ * fewer intersection tests than casting individual rays. Circles are
+ * approximated by polygons with V2D_VIS_CIRCLE_SIDES sides.
+ *
+ * Results are cached. Calculating visibility again with the same origin and
+ * range reuses the previous polygon, unless an occluder within range has
+ * changed.
+ *
+ */
+#ifndef _V2D_VISIBILITY_H
+#define _V2D_VISIBILITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "v2d.h"
+#include "v2d/collide.h"
+#include "v2d/vector.h"
+
+#ifndef V2D_VIS_CIRCLE_SIDES
+#define V2D_VIS_CIRCLE_SIDES 16
+#endif
+
+// An occluder edge, relative to the origin
+// `a` is always clockwise of `b` as seen from the origin
+struct v2d_vis_segment {
+	v2d_vec_t a, b;
+};
+
+struct v2d_vis_event {
+	double angle;
+	uint32_t seg;
+	_Bool begin;
+};
+
+struct v2d_visibility {
+	// The visibility polygon, in anticlockwise order around the origin
+	v2d_vec_t *poly;
+	size_t n_poly, cap_poly;
+
+	// The parameters the polygon was computed with
+	v2d_vec_t origin;
+	double range;
+
+	// True if the last call to v2d_vis_compute changed the polygon
+	_Bool changed;
+
+	// Cache state
+	_Bool valid;
+	uint64_t hash;
+
+	// Scratch space used during computation
+	struct v2d_vis_segment *segs;
+	size_t n_segs, cap_segs;
+	struct v2d_vis_event *events;
+	size_t n_events, cap_events;
+	uint32_t *active;
+	size_t n_active, cap_active;
+};
+
+// Initialize a visibility calculation
+void v2d_vis_init(v2d_visibility_t *vis);
+
+// Free all memory used by a visibility calculation
+void v2d_vis_destroy(v2d_visibility_t *vis);
+
+// Compute the visibility polygon from `origin`, out to `range` in each axis, blocked by `occluders`
+// If nothing within range has changed since the last call, the previous polygon is kept
+// Returns false on failure
+_Bool v2d_vis_compute(v2d_visibility_t *vis, v2d_vec_t origin, double range, const v2d_shape_t *occluders, size_t n);
+
+// Force the next call to v2d_vis_compute to recompute the polygon
+void v2d_vis_invalidate(v2d_visibility_t *vis);
+
+// Return true if a point is within the most recently computed visibility polygon
+_Bool v2d_vis_visible(const v2d_visibility_t *vis, v2d_vec_t p);
+
+#endif
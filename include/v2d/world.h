@@ -4,35 +4,284 @@
  * efficient manner. It can be used with the render component or as part of a
  * broad-phase collision detection system.
  *
+ * Adding or removing entities while the world is being iterated over (for
+ * example, from inside an entity's update callback) is not safe. Instead, use
+ * v2d_world_defer_add and v2d_world_defer_del, which queue the change until
+ * the next call to v2d_world_flush. v2d_loop_update_world does this for you
+ * once every entity has been updated.
+ *
+ * Entities that only need to do something occasionally, such as waiting out
+ * a cooldown, can sleep with v2d_world_sleep instead of checking the time in
+ * every update. Sleeping entities are left out of updates entirely, so the
+ * cost of updating a world depends on how many entities are awake rather
+ * than on how many there are.
+ *
+ * Entities that don't need updating every tick, such as those far away or
+ * off screen, can be put in a lower frequency bucket with v2d_world_set_lod.
+ * An entity in bucket k is updated every 2^k ticks, with dt covering all the
+ * ticks since its last update. Entities in the same bucket are spread evenly
+ * across those ticks, so the work done per tick stays flat.
+ * v2d_world_lod_camera can choose buckets automatically by distance from the
+ * camera.
+ *
+ * Each entity is drawn on one of V2D_WORLD_LAYERS layers, chosen with
+ * v2d_world_set_layer. See v2d/layer.h for how layers are rendered.
+ *
+ * Entities can also be given a shape with v2d_world_set_shape, which puts them
+ * in a broad phase (see v2d/broad.h) owned by the world. The world can then
+ * find entities in a region, within a radius, nearest to a point or along a
+ * ray without looking at every entity. Queries can be limited to certain
+ * categories of entity using the filters described in v2d/broad.h.
+ *
  */
 #ifndef _V2D_WORLD_H
 #define _V2D_WORLD_H
 
 #include "v2d.h"
+#include <stdint.h>
+#include "v2d/alloc.h"
+#include "v2d/broad.h"
+#include "v2d/collide.h"
+#include "v2d/timer.h"
+#include "v2d/transform.h"
+
+// The length of a tick of a world's timer wheel, in seconds
+#ifndef V2D_WORLD_TIMER_RESOLUTION
+#define V2D_WORLD_TIMER_RESOLUTION 0.001
+#endif
+
+// The number of update frequency buckets. Entities in bucket k are updated every 2^k ticks
+#define V2D_WORLD_LOD_BUCKETS 4
+// Each bucket has one list of awake entities per tick in its cycle
+#define V2D_WORLD_LOD_LISTS ((1 << V2D_WORLD_LOD_BUCKETS) - 1)
+
+// The number of layers entities can be drawn on
+#define V2D_WORLD_LAYERS 8
 
 struct v2d_world_entity_list {
 	v2d_ent_cb_t *ent;
-	struct v2d_world_entity_list *next;
+	struct v2d_world_entity_list *next, *prev;
+
+	// If not NULL, the entity was allocated from this pool and is owned by the world
+	v2d_pool_t *pool;
+
+	// The list of awake entities this entity is in, if it is awake
+	struct v2d_world_entity_list *awake_next, *awake_prev;
+	_Bool awake;
+	// The entity's update frequency bucket, and which of the world's awake lists it belongs in
+	uint8_t lod, list;
+	// The world time at the entity's last update
+	double updated;
+	// Counts up as entities are added. Entities woken at the same time are linked in this order
+	uint64_t seq;
+	// Set while the entity is waiting in the world's list of woken entities
+	_Bool waking;
+	// The layer the entity is drawn on
+	uint8_t layer;
+	// Wakes the entity when it fires
+	v2d_timer_t wake;
+
+	// The entity's proxy in the world's spatial index, or V2D_PROXY_NONE if it has no shape
+	uint32_t proxy;
+};
+
+// A queued change to a world's entities
+struct v2d_world_command {
+	enum {
+		V2D_WORLD_CMD_ADD,
+		V2D_WORLD_CMD_DEL,
+	} type;
+	v2d_ent_t *ent;
+	v2d_pool_t *pool;
 };
 
 struct v2d_world {
 	struct v2d_world_entity_list *entities;
+
+	// Entity list nodes are allocated from here
+	v2d_pool_t nodes;
+
+	// Hash table mapping entities to their list nodes, used to remove entities in O(1) time
+	struct v2d_world_entity_list **index;
+	size_t index_cap, index_used;
+
+	// Changes queued by v2d_world_defer_*
+	struct v2d_world_command *queue;
+	size_t queue_len, queue_cap;
+
+	// Awake entities, by bucket and then by the tick in the bucket's cycle they are updated on
+	struct v2d_world_entity_list *awake[V2D_WORLD_LOD_LISTS];
+	size_t awake_count[V2D_WORLD_LOD_LISTS];
+	// The next entity to be updated while v2d_loop_update_world is running
+	struct v2d_world_entity_list *awake_cursor;
+
+	// The number of entities on each layer, so empty layers can be skipped
+	size_t layer_count[V2D_WORLD_LAYERS];
+
+	// The number of updates so far, and the total time the world has been updated for in seconds
+	uint64_t ticks;
+	double time;
+	// Wakes sleeping entities. Other code may schedule its own timers here too
+	v2d_timer_wheel_t timers;
+	// Entities whose wake timers fired during v2d_world_advance_timers, waiting to be linked
+	struct v2d_world_entity_list **woken;
+	size_t n_woken, cap_woken;
+	// The seq of the next entity added
+	uint64_t next_seq;
+
+	// Spatial index of entities with shapes. Each proxy's data is its entity
+	v2d_broad_t spatial;
 };
 
 // Creates a new world
+// Returns NULL on failure
 v2d_world_t *v2d_world_new(void);
 
 // Frees a world and calls the destructors of any entities it contains
+// Entities added with a pool are returned to it. Changes that are still queued are discarded
 void v2d_world_free(v2d_world_t *world);
 
-// Adds an entity to the world. No checks are made for duplicate entities
-void v2d_world_add_entity(v2d_world_t *world, v2d_ent_t *entity);
+// Adds an entity to the world. Adding an entity that is already in the world does nothing
+// Returns true on success, false on failure
+_Bool v2d_world_add_entity(v2d_world_t *world, v2d_ent_t *entity);
+
+// Adds an entity that was allocated from `pool` to the world, which takes ownership of it
+// When the entity is removed from the world, its destroy callback is called and it is returned to the pool
+// Returns true on success, false on failure
+_Bool v2d_world_add_pooled(v2d_world_t *world, v2d_ent_t *entity, v2d_pool_t *pool);
 
-// Removes an entity from the world
-// This requires a traversal of the entire entity list until the desired object is found, which takes O(n) time
+// Removes an entity from the world in O(1) time
+// Entities added with v2d_world_add_entity are not destroyed, while pooled entities are destroyed and returned to their pool
 // Returns true on success, false if the object was not found in the world
 _Bool v2d_world_del_entity(v2d_world_t *world, v2d_ent_t *entity);
 
+// Remove every entity with a non-zero snapshot type (see v2d/snapshot.h), calling destructors as v2d_world_free does
+// This is used before loading a snapshot over a world, so the saved entities can be recreated without disturbing the others
+void v2d_world_clear_saved(v2d_world_t *world);
+
+// Stop updating an entity until `seconds` seconds have passed, or until it is woken with v2d_world_wake if `seconds` is infinite
+// When it wakes, its first update is passed the whole time since it went to sleep as dt
+// This is safe to call from update callbacks, including on the entity being updated
+// Returns false if the entity is not in the world
+_Bool v2d_world_sleep(v2d_world_t *world, v2d_ent_t *entity, double seconds);
+
+// Wake a sleeping entity, so it is updated again. Does nothing if the entity is awake
+// Returns false if the entity is not in the world
+_Bool v2d_world_wake(v2d_world_t *world, v2d_ent_t *entity);
+
+// Return true if an entity is awake. New entities start awake
+_Bool v2d_world_awake(const v2d_world_t *world, const v2d_ent_t *entity);
+
+// Advance the world's timer wheel by `seconds` seconds, waking every entity whose sleep has finished
+// Entities woken together are linked in the order they were added to the world rather than the order their timers fire in,
+// so the order they're updated in doesn't depend on how the wheel happens to be laid out. v2d_loop_update_world calls this
+void v2d_world_advance_timers(v2d_world_t *world, double seconds);
+
+// Put an entity in update frequency bucket `lod`, so it is updated every 2^lod ticks. Bucket 0 is updated every tick
+// Values of `lod` past the last bucket select the last bucket
+// Returns false if the entity is not in the world
+_Bool v2d_world_set_lod(v2d_world_t *world, v2d_ent_t *entity, unsigned lod);
+
+// Chooses buckets for v2d_world_lod_camera
+struct v2d_world_lod_config {
+	// Find the position of an entity, returning false if it doesn't have one. Entities without a position keep their bucket
+	_Bool (*pos)(const v2d_ent_t *entity, v2d_vec_t *pos, void *ctx);
+	void *ctx;
+
+	// Entities further than distance[i] from the centre of the view, in v2d screen coordinates, go in bucket i + 1 or higher
+	// These must be in increasing order
+	double distance[V2D_WORLD_LOD_BUCKETS - 1];
+};
+
+// Choose the bucket of every entity in the world from its distance to the centre of the view
+// `camera` converts world coordinates to v2d screen coordinates, like v2d_render_t's camera_tr
+// This looks at every entity, so it is meant to be called every few frames rather than every tick
+void v2d_world_lod_camera(v2d_world_t *world, v2d_transform_t camera, const struct v2d_world_lod_config *conf);
+
+// Put an entity on a layer. Layer 0 is drawn first, and is where new entities start
+// Returns false if the entity is not in the world or the layer doesn't exist
+_Bool v2d_world_set_layer(v2d_world_t *world, v2d_ent_t *entity, unsigned layer);
+
+// Give an entity a shape, so it can be found by spatial queries. Call this again whenever the entity moves
+// Returns false if the entity is not in the world, or on failure
+_Bool v2d_world_set_shape(v2d_world_t *world, v2d_ent_t *entity, v2d_shape_t shape);
+
+// Remove an entity's shape, so it is no longer found by spatial queries
+void v2d_world_clear_shape(v2d_world_t *world, v2d_ent_t *entity);
+
+// Set the filter used to decide which spatial queries find an entity. The entity must have a shape
+// Returns false if the entity is not in the world or has no shape
+_Bool v2d_world_set_filter(v2d_world_t *world, v2d_ent_t *entity, v2d_filter_t filter);
+
+// In the following queries, `filter` may be NULL to find entities of every category
+
+// Find every entity whose shape overlaps a rect
+// Up to `max_out` entities are written into `out`
+// Returns the total number of entities found, which may be more than `max_out`
+size_t v2d_world_query_rect(v2d_world_t *world, v2d_rect_t rect, const v2d_filter_t *filter, v2d_ent_t **out, size_t max_out);
+
+// Find every entity whose shape is within `radius` of `center`
+// Up to `max_out` entities are written into `out`
+// Returns the total number of entities found, which may be more than `max_out`
+size_t v2d_world_query_radius(v2d_world_t *world, v2d_vec_t center, double radius, const v2d_filter_t *filter, v2d_ent_t **out, size_t max_out);
+
+// Find the `k` entities whose shapes are nearest to `point`, ignoring any further away than `max_dist`, which may be infinite
+// They are written into `out` in order of increasing distance, and their distances into `dist`. Both must have room for `k` elements
+// Returns the number of entities found, which is at most `k`
+size_t v2d_world_nearest(v2d_world_t *world, v2d_vec_t point, double max_dist, const v2d_filter_t *filter, size_t k, v2d_ent_t **out, double *dist);
+
+// Find the first entity whose shape is hit by a ray, which runs from r.pos to r.pos + r.dir
+// If `t` is not NULL, it receives the fraction of the ray's length at which the entity was hit
+// Returns NULL if nothing was hit
+v2d_ent_t *v2d_world_raycast(v2d_world_t *world, v2d_ray_t ray, const v2d_filter_t *filter, double *t);
+
+// The state of a world's clocks. Snapshots save this so updates carry on from where they left off
+struct v2d_world_clock {
+	uint64_t ticks;
+	double time;
+	uint64_t timer_now;
+	double timer_accumulator;
+	uint64_t next_seq;
+};
+
+// How an entity is scheduled to be updated. Snapshots save this for every entity
+struct v2d_world_schedule {
+	uint64_t seq;
+	// The number of timer ticks until the entity wakes, or 0 if it isn't waiting to wake
+	uint64_t wake;
+	double updated;
+	uint8_t awake, lod, list, layer;
+	uint32_t reserved;
+};
+
+// Get a world's clocks
+void v2d_world_get_clock(const v2d_world_t *world, struct v2d_world_clock *clock);
+
+// Set a world's clocks, such as when loading a snapshot
+// Timers that are still pending keep the number of ticks they had left, so entities that aren't saved sleep as long as before
+void v2d_world_set_clock(v2d_world_t *world, const struct v2d_world_clock *clock);
+
+// Get how an entity is scheduled to be updated
+// Returns false if the entity is not in the world
+_Bool v2d_world_get_schedule(const v2d_world_t *world, const v2d_ent_t *entity, struct v2d_world_schedule *sched);
+
+// Reschedule an entity. An awake entity is put at the front of its list, so entities must be rescheduled in reverse update order
+// Returns false if the entity is not in the world or the schedule is invalid
+_Bool v2d_world_set_schedule(v2d_world_t *world, v2d_ent_t *entity, const struct v2d_world_schedule *sched);
+
+// Queue an entity to be added to the world by the next call to v2d_world_flush
+// If `pool` is not NULL, this behaves like v2d_world_add_pooled, otherwise like v2d_world_add_entity
+// Returns true on success, false on failure
+_Bool v2d_world_defer_add(v2d_world_t *world, v2d_ent_t *entity, v2d_pool_t *pool);
+
+// Queue an entity to be removed from the world by the next call to v2d_world_flush
+// Returns true on success, false on failure
+_Bool v2d_world_defer_del(v2d_world_t *world, v2d_ent_t *entity);
+
+// Apply every queued change, in the order they were queued
+// Changes queued by entity destructors while flushing are also applied
+void v2d_world_flush(v2d_world_t *world);
+
 // Used in a for loop to loop through all the entities in a world
 // Usage:
 //  for (struct my_entity_type *v2d_world_iterate(ent, world)) {
@@ -0,0 +1,175 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "v2d.h"
+
+// Used to align allocations in arenas and pools, since C99 has no max_align_t
+union _max_align {
+	long double ld;
+	long long ll;
+	void *p;
+	void (*fp)(void);
+	double _Complex c;
+};
+#define ALIGN(size) (((size) + sizeof (union _max_align) - 1) & ~(sizeof (union _max_align) - 1))
+
+static void *_std_alloc(void *ctx, size_t size) {
+	return malloc(size);
+}
+
+static void _std_free(void *ctx, void *ptr) {
+	free(ptr);
+}
+
+v2d_allocator_t v2d_allocator = {_std_alloc, _std_free, NULL};
+
+void *v2d_alloc(size_t size) {
+	void *ptr = v2d_allocator.alloc(v2d_allocator.ctx, size);
+	if (!ptr) {
+		v2d_raise_error(V2D_ERROR_MEMORY, "Out of memory");
+		return NULL;
+	}
+	v2d_stat_add(allocs, 1);
+	return ptr;
+}
+
+void v2d_free(void *ptr) {
+	if (ptr) v2d_allocator.free(v2d_allocator.ctx, ptr);
+}
+
+bool v2d_array_reserve(void *array, size_t *cap, size_t elem, size_t n) {
+	if (n <= *cap) return true;
+
+	size_t new_cap = *cap ? *cap : 16;
+	while (new_cap < n) new_cap *= 2;
+
+	// The array pointer could be of any type, so copy it rather than accessing it through a (void **)
+	void *old, *new;
+	memcpy(&old, array, sizeof old);
+
+	new = v2d_alloc(new_cap * elem);
+	if (!new) return false;
+	if (old) memcpy(new, old, *cap * elem);
+	v2d_free(old);
+
+	memcpy(array, &new, sizeof new);
+	*cap = new_cap;
+	return true;
+}
+
+// --- Pools ---
+
+struct v2d_pool_chunk {
+	struct v2d_pool_chunk *next;
+	union _max_align data[];
+};
+
+void v2d_pool_init(v2d_pool_t *pool, size_t block_size, size_t chunk_blocks) {
+	// Free blocks store the free list pointer inside themselves, so they need to be at least that big
+	if (block_size < sizeof (void *)) block_size = sizeof (void *);
+	pool->block_size = ALIGN(block_size);
+	pool->chunk_blocks = chunk_blocks ? chunk_blocks : 1;
+	pool->free_list = NULL;
+	pool->chunks = NULL;
+}
+
+void v2d_pool_destroy(v2d_pool_t *pool) {
+	struct v2d_pool_chunk *chunk = pool->chunks;
+	while (chunk) {
+		struct v2d_pool_chunk *next = chunk->next;
+		v2d_free(chunk);
+		chunk = next;
+	}
+	pool->free_list = NULL;
+	pool->chunks = NULL;
+}
+
+void *v2d_pool_alloc(v2d_pool_t *pool) {
+	if (!pool->free_list) {
+		// Out of blocks; allocate another chunk and thread all of its blocks onto the free list
+		struct v2d_pool_chunk *chunk = v2d_alloc(sizeof *chunk + pool->block_size * pool->chunk_blocks);
+		if (!chunk) return NULL;
+		chunk->next = pool->chunks;
+		pool->chunks = chunk;
+
+		char *block = (char *)chunk->data;
+		for (size_t i = 0; i < pool->chunk_blocks; i++, block += pool->block_size) {
+			*(void **)block = pool->free_list;
+			pool->free_list = block;
+		}
+	}
+
+	void *block = pool->free_list;
+	pool->free_list = *(void **)block;
+	return block;
+}
+
+void v2d_pool_free(v2d_pool_t *pool, void *block) {
+	if (!block) return;
+	*(void **)block = pool->free_list;
+	pool->free_list = block;
+}
+
+// --- Arenas ---
+
+struct v2d_arena_chunk {
+	struct v2d_arena_chunk *next;
+	size_t size, used;
+	union _max_align data[];
+};
+
+v2d_arena_t v2d_frame_arena = {64 * 1024, NULL, NULL};
+
+void v2d_arena_init(v2d_arena_t *arena, size_t chunk_size) {
+	arena->chunk_size = chunk_size;
+	arena->chunks = arena->cur = NULL;
+}
+
+void v2d_arena_destroy(v2d_arena_t *arena) {
+	struct v2d_arena_chunk *chunk = arena->chunks;
+	while (chunk) {
+		struct v2d_arena_chunk *next = chunk->next;
+		v2d_free(chunk);
+		chunk = next;
+	}
+	arena->chunks = arena->cur = NULL;
+}
+
+void *v2d_arena_alloc(v2d_arena_t *arena, size_t size) {
+	size = ALIGN(size);
+
+	struct v2d_arena_chunk *chunk = arena->cur;
+	if (!chunk || chunk->size - chunk->used < size) {
+		// The current chunk is full. After a reset, the next chunk may be free for reuse
+		if (chunk && chunk->next && chunk->next->size >= size) {
+			chunk = chunk->next;
+		} else {
+			size_t chunk_size = arena->chunk_size > size ? arena->chunk_size : size;
+			struct v2d_arena_chunk *new_chunk = v2d_alloc(sizeof *new_chunk + chunk_size);
+			if (!new_chunk) return NULL;
+			new_chunk->size = chunk_size;
+
+			// Insert the new chunk after the current one, so any chunks after it can still be reused
+			if (chunk) {
+				new_chunk->next = chunk->next;
+				chunk->next = new_chunk;
+			} else {
+				new_chunk->next = arena->chunks;
+				arena->chunks = new_chunk;
+			}
+			chunk = new_chunk;
+		}
+
+		chunk->used = 0;
+		arena->cur = chunk;
+	}
+
+	void *ptr = (char *)chunk->data + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+void v2d_arena_reset(v2d_arena_t *arena) {
+	arena->cur = arena->chunks;
+	if (arena->cur) arena->cur->used = 0;
+}
@@ -0,0 +1,388 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL.h>
+#include "v2d.h"
+
+// The smallest number of hash buckets. Must be a power of two
+#define BUCKETS_MIN 64
+
+// The placeholder is a magenta and black checkerboard, so missing textures stand out
+#define PLACEHOLDER_SIZE 8
+
+// --- Loader threads ---
+
+static void _push(v2d_asset_t **head, v2d_asset_t **tail, v2d_asset_t *asset) {
+	asset->queue_next = NULL;
+	if (*tail) (*tail)->queue_next = asset;
+	else *head = asset;
+	*tail = asset;
+}
+
+static v2d_asset_t *_pop(v2d_asset_t **head, v2d_asset_t **tail) {
+	v2d_asset_t *asset = *head;
+	if (!asset) return NULL;
+	*head = asset->queue_next;
+	if (!*head) *tail = NULL;
+	asset->queue_next = NULL;
+	return asset;
+}
+
+// Loader threads mustn't use v2d_alloc or the stats, so decoding is left entirely to SDL
+static int _loader(void *data) {
+	v2d_assets_t *assets = data;
+
+	SDL_LockMutex(assets->lock);
+	for (;;) {
+		while (!assets->quit && !assets->decode_head) {
+			SDL_CondWait(assets->wake, assets->lock);
+		}
+		if (assets->quit) break;
+
+		v2d_asset_t *asset = _pop(&assets->decode_head, &assets->decode_tail);
+		asset->state = V2D_ASSET_DECODING;
+
+		// The path can't change or be freed while the asset is decoding
+		SDL_UnlockMutex(assets->lock);
+		SDL_Surface *surface = SDL_LoadBMP(asset->path);
+		SDL_LockMutex(assets->lock);
+
+		// Failures go through the upload queue too, so they can be reported on the main thread
+		asset->surface = surface;
+		asset->state = V2D_ASSET_DECODED;
+		_push(&assets->upload_head, &assets->upload_tail, asset);
+	}
+	SDL_UnlockMutex(assets->lock);
+	return 0;
+}
+
+// Start loading an asset if it isn't loaded or on its way
+static void _queue_decode(v2d_assets_t *assets, v2d_asset_t *asset) {
+	SDL_LockMutex(assets->lock);
+	if (asset->state == V2D_ASSET_UNLOADED) {
+		asset->state = V2D_ASSET_QUEUED;
+		_push(&assets->decode_head, &assets->decode_tail, asset);
+		SDL_CondSignal(assets->wake);
+	}
+	SDL_UnlockMutex(assets->lock);
+}
+
+// --- Creation ---
+
+static SDL_Texture *_make_placeholder(v2d_render_t *render) {
+	SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, PLACEHOLDER_SIZE, PLACEHOLDER_SIZE, 32, SDL_PIXELFORMAT_RGBA8888);
+	if (!surface) {
+		v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
+		return NULL;
+	}
+
+	int half = PLACEHOLDER_SIZE / 2;
+	SDL_FillRect(surface, NULL, 0x000000FF);
+	SDL_FillRect(surface, &(SDL_Rect){0, 0, half, half}, 0xFF00FFFF);
+	SDL_FillRect(surface, &(SDL_Rect){half, half, half, half}, 0xFF00FFFF);
+
+	SDL_Texture *tex = SDL_CreateTextureFromSurface(render->sdl_ren, surface);
+	if (!tex) v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
+	SDL_FreeSurface(surface);
+	v2d_stat_add(sdl_calls, 1);
+	return tex;
+}
+
+v2d_assets_t *v2d_assets_new(v2d_render_t *render, unsigned n_threads, size_t memory_cap) {
+	if (!n_threads) n_threads = 1;
+
+	v2d_assets_t *assets = v2d_alloc(sizeof *assets);
+	if (!assets) return NULL;
+	*assets = (v2d_assets_t){
+		.render = render,
+		.memory_cap = memory_cap,
+		.upload_budget = V2D_ASSETS_UPLOAD_BUDGET,
+	};
+
+	assets->buckets = v2d_alloc(BUCKETS_MIN * sizeof *assets->buckets);
+	if (!assets->buckets) goto fail;
+	memset(assets->buckets, 0, BUCKETS_MIN * sizeof *assets->buckets);
+	assets->n_buckets = BUCKETS_MIN;
+
+	assets->placeholder = _make_placeholder(render);
+	if (!assets->placeholder) goto fail;
+
+	assets->lock = SDL_CreateMutex();
+	assets->wake = SDL_CreateCond();
+	if (!assets->lock || !assets->wake) {
+		v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
+		goto fail;
+	}
+
+	assets->threads = v2d_alloc(n_threads * sizeof *assets->threads);
+	if (!assets->threads) goto fail;
+	for (; assets->n_threads < n_threads; assets->n_threads++) {
+		SDL_Thread *thread = SDL_CreateThread(_loader, "v2d_assets", assets);
+		if (!thread) {
+			v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
+			goto fail;
+		}
+		assets->threads[assets->n_threads] = thread;
+	}
+
+	return assets;
+
+fail:
+	v2d_assets_free(assets);
+	return NULL;
+}
+
+static void _free_asset(v2d_asset_t *asset) {
+	if (asset->surface) SDL_FreeSurface(asset->surface);
+	if (asset->texture) SDL_DestroyTexture(asset->texture);
+	v2d_free(asset->path);
+	v2d_free(asset);
+}
+
+void v2d_assets_free(v2d_assets_t *assets) {
+	if (!assets) return;
+
+	if (assets->lock) {
+		SDL_LockMutex(assets->lock);
+		assets->quit = true;
+		SDL_CondBroadcast(assets->wake);
+		SDL_UnlockMutex(assets->lock);
+	}
+	for (unsigned i = 0; i < assets->n_threads; i++) {
+		SDL_WaitThread(assets->threads[i], NULL);
+	}
+
+	// With the threads stopped, every asset is safe to free, whatever state it's in
+	for (size_t i = 0; assets->buckets && i < assets->n_buckets; i++) {
+		v2d_asset_t *next;
+		for (v2d_asset_t *asset = assets->buckets[i]; asset; asset = next) {
+			next = asset->hash_next;
+			_free_asset(asset);
+		}
+	}
+
+	v2d_free(assets->threads);
+	v2d_free(assets->buckets);
+	if (assets->placeholder) SDL_DestroyTexture(assets->placeholder);
+	if (assets->wake) SDL_DestroyCond(assets->wake);
+	if (assets->lock) SDL_DestroyMutex(assets->lock);
+	v2d_free(assets);
+}
+
+// --- Handles ---
+
+// FNV-1a
+static size_t _hash_path(const char *path) {
+	uint64_t hash = UINT64_C(14695981039346656037);
+	for (; *path; path++) {
+		hash ^= (unsigned char)*path;
+		hash *= UINT64_C(1099511628211);
+	}
+	return (size_t)hash;
+}
+
+static v2d_asset_t **_find(v2d_assets_t *assets, const char *path) {
+	v2d_asset_t **link = &assets->buckets[_hash_path(path) & (assets->n_buckets - 1)];
+	while (*link && strcmp((*link)->path, path)) link = &(*link)->hash_next;
+	return link;
+}
+
+// Double the number of buckets once there are more assets than buckets
+static void _grow(v2d_assets_t *assets) {
+	if (assets->n_assets < assets->n_buckets) return;
+
+	size_t n_buckets = assets->n_buckets * 2;
+	v2d_asset_t **buckets = v2d_alloc(n_buckets * sizeof *buckets);
+	if (!buckets) return; // Longer chains are slower, but still correct
+	memset(buckets, 0, n_buckets * sizeof *buckets);
+
+	for (size_t i = 0; i < assets->n_buckets; i++) {
+		v2d_asset_t *next;
+		for (v2d_asset_t *asset = assets->buckets[i]; asset; asset = next) {
+			next = asset->hash_next;
+			v2d_asset_t **bucket = &buckets[_hash_path(asset->path) & (n_buckets - 1)];
+			asset->hash_next = *bucket;
+			*bucket = asset;
+		}
+	}
+
+	v2d_free(assets->buckets);
+	assets->buckets = buckets;
+	assets->n_buckets = n_buckets;
+}
+
+// Remove an asset the loader threads aren't using, and free it
+static void _remove(v2d_assets_t *assets, v2d_asset_t *asset) {
+	v2d_asset_t **link = _find(assets, asset->path);
+	*link = asset->hash_next;
+	assets->n_assets--;
+	_free_asset(asset);
+}
+
+v2d_asset_t *v2d_assets_load(v2d_assets_t *assets, const char *path) {
+	v2d_asset_t **link = _find(assets, path);
+	v2d_asset_t *asset = *link;
+	if (asset) {
+		asset->refs++;
+		_queue_decode(assets, asset);
+		return asset;
+	}
+
+	asset = v2d_alloc(sizeof *asset);
+	if (!asset) return NULL;
+	size_t len = strlen(path) + 1;
+	*asset = (v2d_asset_t){.path = v2d_alloc(len), .refs = 1};
+	if (!asset->path) {
+		v2d_free(asset);
+		return NULL;
+	}
+	memcpy(asset->path, path, len);
+
+	*link = asset;
+	assets->n_assets++;
+	_grow(assets);
+
+	_queue_decode(assets, asset);
+	return asset;
+}
+
+void v2d_assets_release(v2d_assets_t *assets, v2d_asset_t *asset) {
+	if (!asset || --asset->refs) return;
+
+	// Textures stay cached until they're evicted, and assets the loader threads hold are dealt with once they're done
+	SDL_LockMutex(assets->lock);
+	bool gone = false;
+	switch (asset->state) {
+	case V2D_ASSET_QUEUED:
+		// Take it out of the decode queue
+		for (v2d_asset_t **link = &assets->decode_head, *prev = NULL; *link; prev = *link, link = &(*link)->queue_next) {
+			if (*link != asset) continue;
+			*link = asset->queue_next;
+			if (assets->decode_tail == asset) assets->decode_tail = prev;
+			break;
+		}
+		gone = true;
+		break;
+	case V2D_ASSET_UNLOADED:
+	case V2D_ASSET_FAILED:
+		gone = true;
+		break;
+	default:
+		break;
+	}
+	SDL_UnlockMutex(assets->lock);
+
+	if (gone) _remove(assets, asset);
+}
+
+enum v2d_asset_state v2d_asset_state(v2d_assets_t *assets, v2d_asset_t *asset) {
+	SDL_LockMutex(assets->lock);
+	enum v2d_asset_state state = asset->state;
+	SDL_UnlockMutex(assets->lock);
+	return state;
+}
+
+// --- LRU list ---
+
+static void _lru_unlink(v2d_assets_t *assets, v2d_asset_t *asset) {
+	if (asset->lru_prev) asset->lru_prev->lru_next = asset->lru_next;
+	else assets->lru_head = asset->lru_next;
+	if (asset->lru_next) asset->lru_next->lru_prev = asset->lru_prev;
+	else assets->lru_tail = asset->lru_prev;
+	asset->lru_prev = asset->lru_next = NULL;
+}
+
+static void _lru_push(v2d_assets_t *assets, v2d_asset_t *asset) {
+	asset->lru_prev = NULL;
+	asset->lru_next = assets->lru_head;
+	if (assets->lru_head) assets->lru_head->lru_prev = asset;
+	else assets->lru_tail = asset;
+	assets->lru_head = asset;
+}
+
+SDL_Texture *v2d_asset_texture(v2d_assets_t *assets, v2d_asset_t *asset) {
+	if (!asset->texture) {
+		_queue_decode(assets, asset);
+		return assets->placeholder;
+	}
+
+	asset->used = assets->frame;
+	if (assets->lru_head != asset) {
+		_lru_unlink(assets, asset);
+		_lru_push(assets, asset);
+	}
+	return asset->texture;
+}
+
+// --- Updating ---
+
+// Upload one decoded asset. Returns false if there was nothing to upload
+static bool _upload_one(v2d_assets_t *assets) {
+	SDL_LockMutex(assets->lock);
+	v2d_asset_t *asset = _pop(&assets->upload_head, &assets->upload_tail);
+	SDL_Surface *surface = asset ? asset->surface : NULL;
+	if (asset) asset->surface = NULL;
+	SDL_UnlockMutex(assets->lock);
+	if (!asset) return false;
+
+	// Nobody wants it any more, so don't spend time uploading it
+	if (!asset->refs) {
+		if (surface) SDL_FreeSurface(surface);
+		_remove(assets, asset);
+		return true;
+	}
+
+	enum v2d_asset_state state = V2D_ASSET_FAILED;
+	if (!surface) {
+		v2d_raise_error(V2D_ERROR_IO, "Failed to load image");
+	} else {
+		asset->texture = SDL_CreateTextureFromSurface(assets->render->sdl_ren, surface);
+		v2d_stat_add(sdl_calls, 1);
+		if (asset->texture) {
+			asset->bytes = (size_t)surface->w * surface->h * 4;
+			asset->used = assets->frame;
+			assets->memory += asset->bytes;
+			_lru_push(assets, asset);
+			state = V2D_ASSET_READY;
+		} else {
+			v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
+		}
+		SDL_FreeSurface(surface);
+	}
+
+	SDL_LockMutex(assets->lock);
+	asset->state = state;
+	SDL_UnlockMutex(assets->lock);
+	return true;
+}
+
+static void _evict(v2d_assets_t *assets) {
+	while (assets->memory > assets->memory_cap) {
+		v2d_asset_t *asset = assets->lru_tail;
+		if (!asset || asset->used >= assets->frame) break;
+
+		_lru_unlink(assets, asset);
+		SDL_DestroyTexture(asset->texture);
+		asset->texture = NULL;
+		assets->memory -= asset->bytes;
+
+		SDL_LockMutex(assets->lock);
+		asset->state = V2D_ASSET_UNLOADED;
+		SDL_UnlockMutex(assets->lock);
+
+		if (!asset->refs) _remove(assets, asset);
+	}
+}
+
+void v2d_assets_update(v2d_assets_t *assets) {
+	v2d_prof_zone("assets") {
+		uint64_t start = SDL_GetPerformanceCounter();
+		uint64_t budget = assets->upload_budget * SDL_GetPerformanceFrequency();
+		while (_upload_one(assets)) {
+			if (SDL_GetPerformanceCounter() - start >= budget) break;
+		}
+
+		_evict(assets);
+	}
+	assets->frame++;
+}
@@ -0,0 +1,287 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "v2d.h"
+
+void v2d_broad_init(v2d_broad_t *broad) {
+	*broad = (v2d_broad_t){0};
+	broad->stamp = 1;
+}
+
+void v2d_broad_destroy(v2d_broad_t *broad) {
+	v2d_free(broad->proxies);
+	v2d_free(broad->free_ids);
+	v2d_free(broad->dead_ids);
+	v2d_free(broad->order);
+	v2d_free(broad->pairs);
+	*broad = (v2d_broad_t){0};
+}
+
+static void _set_shape(const v2d_broad_t *broad, struct v2d_broad_proxy *p, v2d_shape_t shape) {
+	v2d_rect_t bounds = v2d_shape_bounds(shape);
+	p->moved = broad->stamp;
+	p->shape = shape;
+	p->min = bounds.pos;
+	p->max = bounds.pos + bounds.dim;
+}
+
+uint32_t v2d_broad_add(v2d_broad_t *broad, v2d_shape_t shape, void *data) {
+	// Make sure everything we need has room first, so failure leaves the broad phase untouched
+	if (!v2d_array_reserve(&broad->order, &broad->cap_order, sizeof *broad->order, broad->n_order + 1)) return V2D_PROXY_NONE;
+	if (!broad->n_free) {
+		if (broad->n_proxies >= V2D_PROXY_NONE) return V2D_PROXY_NONE;
+		if (!v2d_array_reserve(&broad->proxies, &broad->cap_proxies, sizeof *broad->proxies, broad->n_proxies + 1)) return V2D_PROXY_NONE;
+		// Every ID needs a slot in dead_ids when it is deleted, so reserve that now too
+		if (!v2d_array_reserve(&broad->dead_ids, &broad->cap_dead, sizeof *broad->dead_ids, broad->n_proxies + 1)) return V2D_PROXY_NONE;
+		if (!v2d_array_reserve(&broad->free_ids, &broad->cap_free, sizeof *broad->free_ids, broad->n_proxies + 1)) return V2D_PROXY_NONE;
+	}
+
+	uint32_t id = broad->n_free ? broad->free_ids[--broad->n_free] : broad->n_proxies++;
+	struct v2d_broad_proxy *p = broad->proxies + id;
+	_set_shape(broad, p, shape);
+	p->data = data;
+	p->filter = V2D_FILTER_DEFAULT;
+	p->alive = p->active = true;
+
+	// Add it to the end of the order; the next update will sort it into place
+	broad->order[broad->n_order++] = id;
+	return id;
+}
+
+void v2d_broad_del(v2d_broad_t *broad, uint32_t id) {
+	struct v2d_broad_proxy *p = broad->proxies + id;
+	if (!p->alive) return;
+	p->alive = false;
+
+	// The ID is still in `order`, so it can't be reused until the next update removes it
+	broad->dead_ids[broad->n_dead++] = id;
+}
+
+void v2d_broad_move(v2d_broad_t *broad, uint32_t id, v2d_shape_t shape) {
+	_set_shape(broad, broad->proxies + id, shape);
+}
+
+void v2d_broad_set_active(v2d_broad_t *broad, uint32_t id, bool active) {
+	broad->proxies[id].active = active;
+}
+
+void v2d_broad_set_filter(v2d_broad_t *broad, uint32_t id, v2d_filter_t filter) {
+	broad->proxies[id].filter = filter;
+}
+
+void v2d_broad_update(v2d_broad_t *broad) {
+	struct v2d_broad_proxy *proxies = broad->proxies;
+	uint32_t *order = broad->order;
+
+	// Remove deleted proxies from the order, then allow their IDs to be reused
+	if (broad->n_dead) {
+		size_t n = 0;
+		for (size_t i = 0; i < broad->n_order; i++) {
+			if (proxies[order[i]].alive) order[n++] = order[i];
+		}
+		broad->n_order = n;
+
+		for (size_t i = 0; i < broad->n_dead; i++) {
+			broad->free_ids[broad->n_free++] = broad->dead_ids[i];
+		}
+		broad->n_dead = 0;
+	}
+
+	// Insertion sort, which is close to O(n) because the order rarely changes much between updates
+	v2d_real_t max_width = 0;
+	for (size_t i = 0; i < broad->n_order; i++) {
+		uint32_t id = order[i];
+		v2d_real_t x = v2dvx(proxies[id].min);
+		v2d_real_t width = v2dvx(proxies[id].max) - x;
+		if (width > max_width) max_width = width;
+
+		size_t j = i;
+		for (; j > 0 && v2dvx(proxies[order[j-1]].min) > x; j--) {
+			order[j] = order[j-1];
+		}
+		order[j] = id;
+	}
+	broad->max_width = max_width;
+}
+
+static inline bool _overlap_y(const struct v2d_broad_proxy *a, const struct v2d_broad_proxy *b) {
+	return v2dvy(a->min) <= v2dvy(b->max) && v2dvy(b->min) <= v2dvy(a->max);
+}
+
+static inline bool _add_pair(v2d_broad_t *broad, uint32_t a, uint32_t b) {
+	if (!v2d_array_reserve(&broad->pairs, &broad->cap_pairs, sizeof *broad->pairs, broad->n_pairs + 1)) return false;
+	broad->pairs[broad->n_pairs++] = a < b ? (v2d_pair_t){a, b} : (v2d_pair_t){b, a};
+	return true;
+}
+
+v2d_pair_t *v2d_broad_pairs(v2d_broad_t *broad, size_t *n_pairs) {
+	v2d_broad_update(broad);
+
+	const struct v2d_broad_proxy *proxies = broad->proxies;
+	const uint32_t *order = broad->order;
+	const size_t n = broad->n_order;
+	broad->n_pairs = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		const struct v2d_broad_proxy *p = proxies + order[i];
+		if (!p->active) continue;
+
+		v2d_real_t min_x = v2dvx(p->min), max_x = v2dvx(p->max);
+
+		// Sweep forward over every proxy whose left edge is within this one
+		for (size_t j = i + 1; j < n && v2dvx(proxies[order[j]].min) <= max_x; j++) {
+			const struct v2d_broad_proxy *q = proxies + order[j];
+			if (!_overlap_y(p, q) || !v2d_filter_pair(p->filter, q->filter)) continue;
+			if (!_add_pair(broad, order[i], order[j])) goto fail;
+		}
+
+		// Sweep backward to find inactive proxies that overlap this one
+		// Active ones have already been found by their own forward sweep
+		for (size_t j = i; j > 0 && v2dvx(proxies[order[j-1]].min) >= min_x - broad->max_width; j--) {
+			const struct v2d_broad_proxy *q = proxies + order[j-1];
+			if (q->active || v2dvx(q->max) < min_x || !_overlap_y(p, q) || !v2d_filter_pair(p->filter, q->filter)) continue;
+			if (!_add_pair(broad, order[i], order[j-1])) goto fail;
+		}
+	}
+
+	broad->stamp++;
+	*n_pairs = broad->n_pairs;
+	return broad->pairs;
+
+fail:
+	broad->stamp++;
+	*n_pairs = broad->n_pairs = 0;
+	return NULL;
+}
+
+// Binary search for the first proxy in the order whose left edge is at least `x`
+static size_t _search(const v2d_broad_t *broad, v2d_real_t x) {
+	size_t lo = 0, hi = broad->n_order;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (v2dvx(broad->proxies[broad->order[mid]].min) < x) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+void v2d_broad_visit(v2d_broad_t *broad, v2d_vec_t min, v2d_vec_t max, const v2d_filter_t *filter, v2d_broad_visit_t fn, void *ctx) {
+	v2d_broad_update(broad);
+
+	const struct v2d_broad_proxy *proxies = broad->proxies;
+	const uint32_t *order = broad->order;
+	v2d_real_t min_x = v2dvx(min), max_x = v2dvx(max);
+
+	// Start from the first proxy that could reach the query box
+	for (size_t i = _search(broad, min_x - broad->max_width); i < broad->n_order && v2dvx(proxies[order[i]].min) <= max_x; i++) {
+		const struct v2d_broad_proxy *p = proxies + order[i];
+		if (v2dvx(p->max) < min_x || v2dvy(p->max) < v2dvy(min) || v2dvy(p->min) > v2dvy(max)) continue;
+		if (filter && !v2d_filter_query(*filter, p->filter)) continue;
+		if (!fn(broad, order[i], ctx)) break;
+	}
+}
+
+struct _query_ctx {
+	uint32_t *out;
+	size_t max_out, n;
+
+	// Only used by radius queries
+	v2d_vec_t center;
+	double radius;
+};
+
+static bool _query_add(v2d_broad_t *broad, uint32_t id, void *ctx) {
+	struct _query_ctx *q = ctx;
+	if (q->n < q->max_out) q->out[q->n] = id;
+	q->n++;
+	return true;
+}
+
+size_t v2d_broad_query(v2d_broad_t *broad, v2d_vec_t min, v2d_vec_t max, const v2d_filter_t *filter, uint32_t *out, size_t max_out) {
+	struct _query_ctx q = {out, max_out, 0};
+	v2d_broad_visit(broad, min, max, filter, _query_add, &q);
+	return q.n;
+}
+
+static bool _query_add_radius(v2d_broad_t *broad, uint32_t id, void *ctx) {
+	struct _query_ctx *q = ctx;
+	if (v2d_shape_distance(broad->proxies[id].shape, q->center) > q->radius) return true;
+	return _query_add(broad, id, ctx);
+}
+
+size_t v2d_broad_query_radius(v2d_broad_t *broad, v2d_vec_t center, double radius, const v2d_filter_t *filter, uint32_t *out, size_t max_out) {
+	struct _query_ctx q = {out, max_out, 0, center, radius};
+	v2d_vec_t r = v2d_vec(radius, radius);
+	v2d_broad_visit(broad, center - r, center + r, filter, _query_add_radius, &q);
+	return q.n;
+}
+
+size_t v2d_broad_nearest(v2d_broad_t *broad, v2d_vec_t point, double max_dist, const v2d_filter_t *filter, size_t k, uint32_t *ids, void **data, double *dist) {
+	if (!k) return 0;
+	v2d_broad_update(broad);
+
+	const struct v2d_broad_proxy *proxies = broad->proxies;
+	const uint32_t *order = broad->order;
+	v2d_real_t px = v2dvx(point);
+
+	// Proxies to the right of `right` start at or after the point, so their left edge bounds their distance from below
+	// Proxies to the left of `left` start before it, so the widest proxy's width bounds how far they can reach towards it
+	size_t right = _search(broad, px), left = right;
+	size_t n = 0;
+
+	while (left > 0 || right < broad->n_order) {
+		// The furthest distance still worth looking at
+		double limit = n == k ? dist[k-1] : max_dist;
+
+		double right_bound = right < broad->n_order ? v2dvx(proxies[order[right]].min) - px : INFINITY;
+		double left_bound = left > 0 ? px - v2dvx(proxies[order[left-1]].min) - broad->max_width : INFINITY;
+		if (left_bound < 0) left_bound = 0;
+		if (right_bound > limit && left_bound > limit) break;
+
+		// Step whichever side is closer, so the search expands evenly
+		uint32_t id = left_bound < right_bound ? order[--left] : order[right++];
+		if (filter && !v2d_filter_query(*filter, proxies[id].filter)) continue;
+		double d = v2d_shape_distance(proxies[id].shape, point);
+		if (d > limit || (n == k && d >= limit)) continue;
+
+		// Insert into the sorted results, dropping the furthest if they're full
+		size_t i = n < k ? n++ : k - 1;
+		for (; i > 0 && dist[i-1] > d; i--) {
+			dist[i] = dist[i-1];
+			if (ids) ids[i] = ids[i-1];
+			if (data) data[i] = data[i-1];
+		}
+		dist[i] = d;
+		if (ids) ids[i] = id;
+		if (data) data[i] = proxies[id].data;
+	}
+
+	return n;
+}
+
+struct _raycast_ctx {
+	v2d_ray_t ray;
+	uint32_t id;
+	double t;
+};
+
+static bool _raycast_visit(v2d_broad_t *broad, uint32_t id, void *ctx) {
+	struct _raycast_ctx *r = ctx;
+	double t = v2d_raycast_shape_entry(r->ray, broad->proxies[id].shape);
+	if (t < r->t) {
+		r->t = t;
+		r->id = id;
+	}
+	return true;
+}
+
+uint32_t v2d_broad_raycast(v2d_broad_t *broad, v2d_ray_t ray, const v2d_filter_t *filter, double *t) {
+	struct _raycast_ctx r = {ray, V2D_PROXY_NONE, INFINITY};
+	v2d_vec_t end = ray.pos + ray.dir;
+	v2d_vec_t min = v2d_vec(fmin(v2dvx(ray.pos), v2dvx(end)), fmin(v2dvy(ray.pos), v2dvy(end)));
+	v2d_vec_t max = v2d_vec(fmax(v2dvx(ray.pos), v2dvx(end)), fmax(v2dvy(ray.pos), v2dvy(end)));
+	v2d_broad_visit(broad, min, max, filter, _raycast_visit, &r);
+
+	if (t) *t = r.t;
+	return r.id;
+}
@@ -1,7 +1,9 @@
 #include <math.h>
 #include <stdbool.h>
 #include "v2d/collide.h"
+#include "v2d/stats.h"
 #include "v2d/vector.h"
+#include "collide_internal.h"
 
 // Clamp a scalar to between two others
 static inline double _clamp(double a, double min, double max) {
@@ -19,7 +21,7 @@ static inline v2d_vec_t _clampv(v2d_vec_t a, v2d_vec_t min, v2d_vec_t max) {
 
 // Flip a rect's dimensions if they are negative
 static v2d_rect_t _rect_fix(v2d_rect_t r) {
-	double *p = v2d_vec_a(r.pos), *d = v2d_vec_a(r.dim);
+	v2d_real_t *p = v2d_vec_a(r.pos), *d = v2d_vec_a(r.dim);
 
 	// Hopefully the compiler will be nice and unroll this loop for us
 	for (int i = 0; i < 2; i++) {
@@ -53,7 +55,11 @@ bool v2d_collide_circle_circle(v2d_circle_t a, v2d_circle_t b) {
 	// The distance the two circles need to be within to collide
 	double d = a.rad + b.rad;
 	// We compare squares because that's faster
-	return v2d_vec_mag2(a.pos - b.pos) < d*d;
+	bool hit = v2d_vec_mag2(a.pos - b.pos) < d*d;
+
+	v2d_stat_add(pairs_tested, 1);
+	v2d_stat_add(pairs_hit, hit);
+	return hit;
 }
 
 bool v2d_collide_rect_rect(v2d_rect_t a, v2d_rect_t b) {
@@ -65,6 +71,8 @@ bool v2d_collide_rect_rect(v2d_rect_t a, v2d_rect_t b) {
 	v2d_vec_t amin = a.pos, amax = a.pos + a.dim;
 	v2d_vec_t bmin = b.pos, bmax = b.pos + b.dim;
 
+	v2d_stat_add(pairs_tested, 1);
+
 	// a is to the left of b
 	if (v2dvx(amax) < v2dvx(bmin)) return false;
 	// b is to the left of a
@@ -75,19 +83,29 @@ bool v2d_collide_rect_rect(v2d_rect_t a, v2d_rect_t b) {
 	if (v2dvy(bmax) < v2dvy(amin)) return false;
 
 	// If none of those are true, we're colliding
+	v2d_stat_add(pairs_hit, 1);
 	return true;
 }
 
 bool v2d_collide_circle_rect(v2d_circle_t a, v2d_rect_t b) {
 	v2d_vec_t min = b.pos, max = b.pos + b.dim;
-	return v2d_vec_mag2(_clampv(a.pos, min, max) - a.pos) < a.rad*a.rad;
+	bool hit = v2d_vec_mag2(_clampv(a.pos, min, max) - a.pos) < a.rad*a.rad;
+
+	v2d_stat_add(pairs_tested, 1);
+	v2d_stat_add(pairs_hit, hit);
+	return hit;
 }
 
 double v2d_raycast_circle(v2d_ray_t r, v2d_circle_t c) {
+	// Shortcut
+	if (v2d_collide_point_circle(r.pos + r.dir, c)) return 0;
+	return v2d_raycast_circle_entry(r, c);
+}
+
+double v2d_raycast_circle_entry(v2d_ray_t r, v2d_circle_t c) {
 	// Shortcut
 	if (v2d_collide_point_circle(r.pos, c)) return 0;
 	if (r.dir == 0) return INFINITY;
-	if (v2d_collide_point_circle(r.pos + r.dir, c)) return 0;
 
 	// Translate the ray's position to origin
 	v2d_vec_t cpos = c.pos - r.pos;
@@ -96,16 +114,15 @@ double v2d_raycast_circle(v2d_ray_t r, v2d_circle_t c) {
 	double rmag = v2d_vec_mag(r.dir);
 	double rimag = 1/rmag;
 
-	// Project the center point of the circle onto the ray
+	// Project the center point of the circle onto the ray's line
 	// This is an actual distance, not a λ value
 	double proj = v2d_vec_dot(cpos, r.dir) * rimag;
 
-	// Make sure we don't go outside of the ray
-	if (proj < 0) proj = 0;
-	else if (proj > rmag) proj = rmag;
+	// The ray starts outside the circle, so if the center is behind it, it's moving away
+	if (proj < 0) return INFINITY;
 
-	// Otherwise, check the distance from the projected point to the circle's center
-	double distance = v2d_vec_mag2(cpos - r.dir*proj*rimag);
+	// Otherwise, check the distance from the line to the circle's center
+	double distance = v2d_vec_mag2(cpos) - proj*proj;
 	// If it's more than the circle's radius, there's no collision
 	if (distance >= c.rad*c.rad) return INFINITY;
 
@@ -122,12 +139,17 @@ double v2d_raycast_circle(v2d_ray_t r, v2d_circle_t c) {
 }
 
 double v2d_raycast_rect(v2d_ray_t r, v2d_rect_t b) {
+	// Shortcut
+	if (v2d_collide_point_rect(r.pos + r.dir, b)) return 0;
+	return v2d_raycast_rect_entry(r, b);
+}
+
+double v2d_raycast_rect_entry(v2d_ray_t r, v2d_rect_t b) {
 	// This uses the "slab" method of ray-AABB intersection
 
 	// Shortcut
 	if (v2d_collide_point_rect(r.pos, b)) return 0;
 	if (r.dir == 0) return INFINITY;
-	if (v2d_collide_point_rect(r.pos + r.dir, b)) return 0;
 
 	// The two corners of the rect
 	b = _rect_fix(b);
@@ -158,3 +180,224 @@ double v2d_raycast_rect(v2d_ray_t r, v2d_rect_t b) {
 	if (0 <= h && h <= 1) return h;
 	return INFINITY;
 }
+
+bool v2d_collide_shape_shape(v2d_shape_t a, v2d_shape_t b) {
+	switch (a.type) {
+	case V2D_SHAPE_CIRCLE:
+		switch (b.type) {
+		case V2D_SHAPE_CIRCLE:
+			return v2d_collide_circle_circle(a.s.circle, b.s.circle);
+		case V2D_SHAPE_RECT:
+			return v2d_collide_circle_rect(a.s.circle, b.s.rect);
+		}
+		break;
+
+	case V2D_SHAPE_RECT:
+		switch (b.type) {
+		case V2D_SHAPE_CIRCLE:
+			return v2d_collide_circle_rect(b.s.circle, a.s.rect);
+		case V2D_SHAPE_RECT:
+			return v2d_collide_rect_rect(a.s.rect, b.s.rect);
+		}
+		break;
+	}
+	return false;
+}
+
+// --- Contact generation ---
+// The tests themselves don't touch the stats, so the pipeline can run them from job functions
+
+static bool _contact_circle_circle(v2d_circle_t a, v2d_circle_t b, v2d_contact_t *c) {
+	double d = a.rad + b.rad;
+	v2d_vec_t delta = b.pos - a.pos;
+	double dist2 = v2d_vec_mag2(delta);
+	if (dist2 >= d*d) return false;
+
+	// If the centers are in exactly the same place, any direction will do
+	double dist = sqrt(dist2);
+	c->normal = dist > 0 ? delta / dist : v2d_vec(1, 0);
+	c->depth = d - dist;
+	c->point = a.pos + c->normal * a.rad;
+
+	return true;
+}
+
+static bool _contact_rect_rect(v2d_rect_t a, v2d_rect_t b, v2d_contact_t *c) {
+	a = _rect_fix(a);
+	b = _rect_fix(b);
+	v2d_vec_t amin = a.pos, amax = a.pos + a.dim;
+	v2d_vec_t bmin = b.pos, bmax = b.pos + b.dim;
+
+	// The overlapping region
+	v2d_vec_t omin = v2d_vec(fmax(v2dvx(amin), v2dvx(bmin)), fmax(v2dvy(amin), v2dvy(bmin)));
+	v2d_vec_t omax = v2d_vec(fmin(v2dvx(amax), v2dvx(bmax)), fmin(v2dvy(amax), v2dvy(bmax)));
+	v2d_vec_t overlap = omax - omin;
+	if (v2dvx(overlap) <= 0 || v2dvy(overlap) <= 0) return false;
+
+	// Push the rects apart along the axis with the least overlap
+	v2d_vec_t dcenter = (bmin + bmax) - (amin + amax);
+	if (v2dvx(overlap) < v2dvy(overlap)) {
+		c->normal = v2d_vec(v2dvx(dcenter) < 0 ? -1 : 1, 0);
+		c->depth = v2dvx(overlap);
+	} else {
+		c->normal = v2d_vec(0, v2dvy(dcenter) < 0 ? -1 : 1);
+		c->depth = v2dvy(overlap);
+	}
+	c->point = (omin + omax) / 2;
+
+	return true;
+}
+
+static bool _contact_circle_rect(v2d_circle_t a, v2d_rect_t b, v2d_contact_t *c) {
+	b = _rect_fix(b);
+	v2d_vec_t min = b.pos, max = b.pos + b.dim;
+	v2d_vec_t closest = _clampv(a.pos, min, max);
+
+	if (closest != a.pos) {
+		// The center is outside the rect, so the closest point on the rect is on its surface
+		v2d_vec_t delta = closest - a.pos;
+		double dist2 = v2d_vec_mag2(delta);
+		if (dist2 >= a.rad*a.rad) return false;
+
+		double dist = sqrt(dist2);
+		c->normal = delta / dist;
+		c->depth = a.rad - dist;
+		c->point = closest;
+	} else {
+		// The center is inside the rect, so push it out through the nearest edge
+		double left = v2dvx(a.pos) - v2dvx(min), right = v2dvx(max) - v2dvx(a.pos);
+		double bottom = v2dvy(a.pos) - v2dvy(min), top = v2dvy(max) - v2dvy(a.pos);
+		double dx = fmin(left, right), dy = fmin(bottom, top);
+
+		// The normal points from the circle into the rect, so it's the opposite of the edge's outward normal
+		if (dx < dy) {
+			c->normal = v2d_vec(left < right ? 1 : -1, 0);
+			c->depth = a.rad + dx;
+			c->point = a.pos - c->normal * dx;
+		} else {
+			c->normal = v2d_vec(0, bottom < top ? 1 : -1);
+			c->depth = a.rad + dy;
+			c->point = a.pos - c->normal * dy;
+		}
+	}
+
+	return true;
+}
+
+static bool _contact_rect_circle(v2d_rect_t a, v2d_circle_t b, v2d_contact_t *c) {
+	if (!_contact_circle_rect(b, a, c)) return false;
+	c->normal = -c->normal;
+	return true;
+}
+
+static bool _contact_shape_shape(v2d_shape_t a, v2d_shape_t b, v2d_contact_t *c) {
+	switch (a.type) {
+	case V2D_SHAPE_CIRCLE:
+		switch (b.type) {
+		case V2D_SHAPE_CIRCLE:
+			return _contact_circle_circle(a.s.circle, b.s.circle, c);
+		case V2D_SHAPE_RECT:
+			return _contact_circle_rect(a.s.circle, b.s.rect, c);
+		}
+		break;
+
+	case V2D_SHAPE_RECT:
+		switch (b.type) {
+		case V2D_SHAPE_CIRCLE:
+			return _contact_rect_circle(a.s.rect, b.s.circle, c);
+		case V2D_SHAPE_RECT:
+			return _contact_rect_rect(a.s.rect, b.s.rect, c);
+		}
+		break;
+	}
+	return false;
+}
+
+// Count a test towards the stats, passing its result through
+static inline bool _count(bool hit) {
+	v2d_stat_add(pairs_tested, 1);
+	v2d_stat_add(pairs_hit, hit);
+	return hit;
+}
+
+bool v2d_contact_circle_circle(v2d_circle_t a, v2d_circle_t b, v2d_contact_t *c) {
+	return _count(_contact_circle_circle(a, b, c));
+}
+
+bool v2d_contact_rect_rect(v2d_rect_t a, v2d_rect_t b, v2d_contact_t *c) {
+	return _count(_contact_rect_rect(a, b, c));
+}
+
+bool v2d_contact_circle_rect(v2d_circle_t a, v2d_rect_t b, v2d_contact_t *c) {
+	return _count(_contact_circle_rect(a, b, c));
+}
+
+bool v2d_contact_rect_circle(v2d_rect_t a, v2d_circle_t b, v2d_contact_t *c) {
+	return _count(_contact_rect_circle(a, b, c));
+}
+
+bool v2d_contact_shape_shape(v2d_shape_t a, v2d_shape_t b, v2d_contact_t *c) {
+	return _count(_contact_shape_shape(a, b, c));
+}
+
+bool v2d_contact_shape_shape_uncounted(v2d_shape_t a, v2d_shape_t b, v2d_contact_t *c) {
+	return _contact_shape_shape(a, b, c);
+}
+
+// --- Shapes ---
+
+double v2d_raycast_shape(v2d_ray_t r, v2d_shape_t s) {
+	switch (s.type) {
+	case V2D_SHAPE_CIRCLE:
+		return v2d_raycast_circle(r, s.s.circle);
+	case V2D_SHAPE_RECT:
+		return v2d_raycast_rect(r, s.s.rect);
+	}
+	return INFINITY;
+}
+
+double v2d_raycast_shape_entry(v2d_ray_t r, v2d_shape_t s) {
+	switch (s.type) {
+	case V2D_SHAPE_CIRCLE:
+		return v2d_raycast_circle_entry(r, s.s.circle);
+	case V2D_SHAPE_RECT:
+		return v2d_raycast_rect_entry(r, s.s.rect);
+	}
+	return INFINITY;
+}
+
+v2d_rect_t v2d_shape_bounds(v2d_shape_t s) {
+	switch (s.type) {
+	case V2D_SHAPE_CIRCLE:
+		return (v2d_rect_t){s.s.circle.pos - v2d_vec(s.s.circle.rad, s.s.circle.rad), v2d_vec(2*s.s.circle.rad, 2*s.s.circle.rad)};
+	case V2D_SHAPE_RECT:
+		return _rect_fix(s.s.rect);
+	}
+	return (v2d_rect_t){0, 0};
+}
+
+v2d_shape_t v2d_shape_translate(v2d_shape_t s, v2d_vec_t delta) {
+	switch (s.type) {
+	case V2D_SHAPE_CIRCLE:
+		s.s.circle.pos += delta;
+		break;
+	case V2D_SHAPE_RECT:
+		s.s.rect.pos += delta;
+		break;
+	}
+	return s;
+}
+
+double v2d_shape_distance(v2d_shape_t s, v2d_vec_t p) {
+	switch (s.type) {
+	case V2D_SHAPE_CIRCLE:
+		return fmax(v2d_vec_mag(p - s.s.circle.pos) - s.s.circle.rad, 0);
+	case V2D_SHAPE_RECT:;
+		v2d_rect_t b = _rect_fix(s.s.rect);
+		v2d_vec_t max = b.pos + b.dim;
+		double dx = fmax(fmax(v2dvx(b.pos) - v2dvx(p), v2dvx(p) - v2dvx(max)), 0);
+		double dy = fmax(fmax(v2dvy(b.pos) - v2dvy(p), v2dvy(p) - v2dvy(max)), 0);
+		return sqrt(dx*dx + dy*dy);
+	}
+	return INFINITY;
+}
@@ -0,0 +1,16 @@
+/* collide_internal.h
+ *
+ * Collision functions shared between v2d's own modules, which aren't part of
+ * the public API.
+ *
+ */
+#ifndef _V2D_COLLIDE_INTERNAL_H
+#define _V2D_COLLIDE_INTERNAL_H
+
+#include <stdbool.h>
+#include "v2d/collide.h"
+
+// The same as v2d_contact_shape_shape, but not counted in v2d/stats.h, so it's safe to call from job functions
+bool v2d_contact_shape_shape_uncounted(v2d_shape_t a, v2d_shape_t b, v2d_contact_t *c);
+
+#endif
@@ -2,62 +2,151 @@
 #include <stdint.h>
 #include "v2d.h"
 
+static void _render_world(const v2d_world_t *world, v2d_render_t *render, v2d_layers_t *layers, bool stats_overlay, v2d_pacer_t *pacer);
+
 v2d_gameloop_config_t v2d_gameloop_config_default(void) {
-	return (v2d_gameloop_config_t){NULL, NULL, {0}, NULL, 1000/60};
+	return (v2d_gameloop_config_t){NULL, NULL, {0}, NULL, 1000/60, false, 0, NULL, NULL, NULL, NULL};
 }
 
 void v2d_gameloop(v2d_gameloop_config_t conf) {
-	uint32_t tnow, told = SDL_GetTicks(), tnext = told + conf.frame_time_ms;
+	v2d_pacer_t own_pacer, *pacer = conf.pacer;
+	if (!pacer) {
+		pacer = &own_pacer;
+		v2d_pacer_init(pacer, conf.frame_time_ms / 1000.0, conf.render && conf.render->vsync);
+	}
+
+	uint64_t tnow, told = SDL_GetPerformanceCounter();
+	double freq = SDL_GetPerformanceFrequency();
+	double fixed_dt = conf.rollback ? conf.rollback->dt : conf.fixed_dt;
+	double accumulator = 0;
 
 	while (v2d_loop_process_events(conf.dis, conf.quit_action, conf.render)) {
-		// Update the world until it's time to render the next frame
-		while (!SDL_TICKS_PASSED((tnow = SDL_GetTicks()), tnext)) {
-			v2d_loop_update_world(conf.world, (tnow - told) / 1000.0);
-			told = tnow;
+		// Anything in the frame arena was only needed for the last frame
+		v2d_arena_reset(&v2d_frame_arena);
+
+		// Update the world until it's time to render the next frame, sleeping whenever there's nothing to do
+		for (;;) {
+			tnow = SDL_GetPerformanceCounter();
+			double wait = v2d_pacer_remaining(pacer);
+			if (fixed_dt <= 0) {
+				// A variable step is taken once per frame, just before rendering, so it sees the latest state
+				if (wait <= 0) {
+					v2d_loop_update_world(conf.world, (tnow - told) / freq);
+					told = tnow;
+					break;
+				}
+			} else {
+				// Run as many whole steps as have elapsed, carrying the remainder over
+				// If steps take longer than they simulate, catching up would only make the next frame later, so the excess is dropped
+				accumulator += (tnow - told) / freq;
+				if (accumulator > V2D_LOOP_MAX_STEPS * fixed_dt) {
+					v2d_pacer_drop_time(pacer, accumulator - V2D_LOOP_MAX_STEPS * fixed_dt);
+					accumulator = V2D_LOOP_MAX_STEPS * fixed_dt;
+				}
+				for (; accumulator >= fixed_dt; accumulator -= fixed_dt) {
+					if (!conf.rollback) v2d_loop_update_world(conf.world, fixed_dt);
+					else if (!v2d_rollback_tick(conf.rollback)) v2d_warn("rollback failed at tick %lu", (unsigned long)conf.rollback->tick);
+				}
+				told = tnow;
+				if (wait <= 0) break;
+
+				// Wake in time for the next step
+				if (fixed_dt - accumulator < wait) wait = fixed_dt - accumulator;
+			}
+			v2d_pacer_sleep(wait);
 		}
 
+		v2d_pacer_begin_frame(pacer);
+
+		// Textures that finished loading are uploaded in time to be drawn this frame
+		if (conf.assets) v2d_assets_update(conf.assets);
+
 		// Render everything
-		v2d_loop_render_world(conf.world, conf.render);
+		_render_world(conf.world, conf.render, conf.layers, conf.stats_overlay, pacer);
 
-		// Set the time for the next frame to be rendered
-		tnext += conf.frame_time_ms;
+		// Schedule the next frame, skipping any that were missed
+		v2d_pacer_end_frame(pacer);
+		v2d_stats_end_frame();
 	}
 }
 
 bool v2d_loop_process_events(v2d_action_dispatcher_t dis, const v2d_action_t *quit_action, v2d_render_t *render) {
+		bool quit = false;
 		SDL_Event ev;
-		while (SDL_PollEvent(&ev)) {
-			if (ev.type == SDL_QUIT) return false;
-			if (render && ev.type == SDL_WINDOWEVENT && ev.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+		v2d_prof_zone("events") while (!quit && SDL_PollEvent(&ev)) {
+			v2d_stat_add(sdl_calls, 1);
+			if (ev.type == SDL_QUIT) quit = true;
+			else if (render && ev.type == SDL_WINDOWEVENT && ev.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
 				v2d_render_transform_center(render, ev.window.data1, ev.window.data2);
-				continue;
+			} else {
+				v2d_adis_handle_event(dis, ev, v2d_render_transform(render));
 			}
-			v2d_adis_handle_event(dis, ev, v2d_render_transform(render));
 		}
+		if (quit) return false;
 		if (quit_action && quit_action->value.s) return false;
 		return true;
 }
 
-void v2d_loop_update_world(const v2d_world_t *world, double dt) {
+void v2d_loop_update_world(v2d_world_t *world, double dt) {
 	if (!world) return;
-	struct v2d_world_entity_list *l = world->entities;
-	for (; l; l = l->next) {
-		if (l->ent->update) l->ent->update(l->ent, dt);
+
+	// Wake any entities whose sleep has finished, so they are updated below
+	world->ticks++;
+	world->time += dt;
+	v2d_world_advance_timers(world, dt);
+
+	v2d_prof_zone("update") for (int lod = 0; lod < V2D_WORLD_LOD_BUCKETS; lod++) {
+		// Each bucket updates one of its lists per tick, cycling through them
+		size_t list = ((size_t)1 << lod) - 1 + (world->ticks & (((uint64_t)1 << lod) - 1));
+
+		// Entities may put themselves or others to sleep while being updated, so the next one is kept in the world where that can adjust it
+		for (struct v2d_world_entity_list *l = world->awake[list]; l; l = world->awake_cursor) {
+			world->awake_cursor = l->awake_next;
+			if (!l->ent->update) continue;
+
+			// Entities are passed the whole time since their last update, which covers any ticks they slept through or skipped
+			double ent_dt = world->time - l->updated;
+			l->updated = world->time;
+			l->ent->update(l->ent, ent_dt);
+			v2d_stat_add(entities_updated, 1);
+		}
 	}
+
+	// Now that nothing is iterating over the world, it's safe to add and remove entities
+	v2d_world_flush(world);
 }
 
-void v2d_loop_render_world(const v2d_world_t *world, v2d_render_t *render) {
+static void _render_world(const v2d_world_t *world, v2d_render_t *render, v2d_layers_t *layers, bool stats_overlay, v2d_pacer_t *pacer) {
 	if (!render) return;
 
-	v2d_render_rgb(render, 0, 0, 0);
-	v2d_render_clear(render);
+	v2d_prof_zone("render") {
+		v2d_render_rgb(render, 0, 0, 0);
+		v2d_render_clear(render);
 
-	if (world) {
-		struct v2d_world_entity_list *l = world->entities;
-		for (; l; l = l->next) {
-			if (l->ent->render) l->ent->render(l->ent, render);
+		if (world && layers) {
+			v2d_layers_render(layers, world);
+		} else if (world) {
+			struct v2d_world_entity_list *l = world->entities;
+			for (; l; l = l->next) {
+				if (l->ent->render) l->ent->render(l->ent, render);
+			}
 		}
+
+		if (stats_overlay) v2d_stats_draw_overlay(render);
 	}
 
-	v2d_render_flip(render);
+	if (pacer) v2d_pacer_present(pacer);
+	v2d_prof_zone("flip") v2d_render_flip(render);
+}
+
+void v2d_loop_render_world(const v2d_world_t *world, v2d_render_t *render) {
+	_render_world(world, render, NULL, false, NULL);
+}
+
+void v2d_loop_render_world_stats(const v2d_world_t *world, v2d_render_t *render) {
+	_render_world(world, render, NULL, true, NULL);
+}
+
+void v2d_loop_render_layers(const v2d_world_t *world, v2d_layers_t *layers) {
+	_render_world(world, layers->render, layers, false, NULL);
 }
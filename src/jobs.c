@@ -0,0 +1,150 @@
+#include <stdbool.h>
+#include <SDL.h>
+#include "v2d.h"
+
+// Take chunks of the current job until there are none left
+static void _work(v2d_jobs_t *jobs, unsigned worker) {
+	for (;;) {
+		size_t begin = (size_t)SDL_AtomicAdd(&jobs->next, (int)jobs->chunk);
+		if (begin >= jobs->n) break;
+		size_t end = begin + jobs->chunk;
+		if (end > jobs->n) end = jobs->n;
+		jobs->fn(jobs->ctx, begin, end, worker);
+	}
+}
+
+struct _thread_arg {
+	v2d_jobs_t *jobs;
+	unsigned worker;
+};
+
+static int _thread(void *data) {
+	struct _thread_arg arg = *(struct _thread_arg *)data;
+	v2d_free(data);
+	v2d_jobs_t *jobs = arg.jobs;
+
+	unsigned generation = 0;
+	SDL_LockMutex(jobs->lock);
+	for (;;) {
+		while (!jobs->quit && jobs->generation == generation) {
+			SDL_CondWait(jobs->start, jobs->lock);
+		}
+		if (jobs->quit) break;
+		generation = jobs->generation;
+
+		SDL_UnlockMutex(jobs->lock);
+		_work(jobs, arg.worker);
+		SDL_LockMutex(jobs->lock);
+
+		if (--jobs->running == 0) SDL_CondSignal(jobs->done);
+	}
+	SDL_UnlockMutex(jobs->lock);
+	return 0;
+}
+
+v2d_jobs_t *v2d_jobs_new(unsigned n_threads) {
+	if (!n_threads) {
+		int cpus = SDL_GetCPUCount();
+		n_threads = cpus > 1 ? cpus - 1 : 0;
+	}
+
+	v2d_jobs_t *jobs = v2d_alloc(sizeof *jobs);
+	if (!jobs) return NULL;
+	*jobs = (v2d_jobs_t){0};
+
+	jobs->lock = SDL_CreateMutex();
+	jobs->start = SDL_CreateCond();
+	jobs->done = SDL_CreateCond();
+	if (!jobs->lock || !jobs->start || !jobs->done) {
+		v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
+		goto fail;
+	}
+
+	if (n_threads) {
+		jobs->threads = v2d_alloc(n_threads * sizeof *jobs->threads);
+		if (!jobs->threads) goto fail;
+	}
+
+	for (; jobs->n_threads < n_threads; jobs->n_threads++) {
+		struct _thread_arg *arg = v2d_alloc(sizeof *arg);
+		if (!arg) goto fail;
+		*arg = (struct _thread_arg){jobs, jobs->n_threads + 1};
+
+		SDL_Thread *thread = SDL_CreateThread(_thread, "v2d_jobs", arg);
+		if (!thread) {
+			v2d_free(arg);
+			v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
+			goto fail;
+		}
+		jobs->threads[jobs->n_threads] = thread;
+	}
+
+	return jobs;
+
+fail:
+	v2d_jobs_free(jobs);
+	return NULL;
+}
+
+void v2d_jobs_free(v2d_jobs_t *jobs) {
+	if (!jobs) return;
+
+	if (jobs->lock) {
+		SDL_LockMutex(jobs->lock);
+		jobs->quit = true;
+		SDL_CondBroadcast(jobs->start);
+		SDL_UnlockMutex(jobs->lock);
+	}
+
+	for (unsigned i = 0; i < jobs->n_threads; i++) {
+		SDL_WaitThread(jobs->threads[i], NULL);
+	}
+
+	v2d_free(jobs->threads);
+	if (jobs->done) SDL_DestroyCond(jobs->done);
+	if (jobs->start) SDL_DestroyCond(jobs->start);
+	if (jobs->lock) SDL_DestroyMutex(jobs->lock);
+	v2d_free(jobs);
+}
+
+unsigned v2d_jobs_workers(const v2d_jobs_t *jobs) {
+	return jobs ? jobs->n_threads + 1 : 1;
+}
+
+void v2d_jobs_parallel_for(v2d_jobs_t *jobs, size_t n, size_t chunk, v2d_job_fn_t fn, void *ctx) {
+	if (!n) return;
+
+	if (!jobs || !jobs->n_threads || n == 1) {
+		fn(ctx, 0, n, 0);
+		return;
+	}
+
+	if (!chunk) {
+		// Aim for a few chunks per thread, so threads that finish early can help the others
+		chunk = n / (4 * v2d_jobs_workers(jobs));
+		if (!chunk) chunk = 1;
+	}
+
+	// The chunk counter is an int, so make sure it can't overflow
+	if (n > SDL_MAX_SINT32 - chunk) {
+		fn(ctx, 0, n, 0);
+		return;
+	}
+
+	SDL_LockMutex(jobs->lock);
+	jobs->fn = fn;
+	jobs->ctx = ctx;
+	jobs->n = n;
+	jobs->chunk = chunk;
+	SDL_AtomicSet(&jobs->next, 0);
+	jobs->running = jobs->n_threads;
+	jobs->generation++;
+	SDL_CondBroadcast(jobs->start);
+	SDL_UnlockMutex(jobs->lock);
+
+	_work(jobs, 0);
+
+	SDL_LockMutex(jobs->lock);
+	while (jobs->running) SDL_CondWait(jobs->done, jobs->lock);
+	SDL_UnlockMutex(jobs->lock);
+}
@@ -0,0 +1,146 @@
+#include <complex.h>
+#include <math.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include "v2d.h"
+
+v2d_layers_t *v2d_layers_new(v2d_render_t *render) {
+	v2d_layers_t *layers = v2d_alloc(sizeof *layers);
+	if (!layers) return NULL;
+
+	layers->render = render;
+	for (int i = 0; i < V2D_WORLD_LAYERS; i++) {
+		layers->layers[i] = (struct v2d_layer){.parallax = v2d_vec(1, 1), .dirty = true};
+	}
+	return layers;
+}
+
+static void _drop_cache(struct v2d_layer *layer) {
+	if (layer->target) SDL_DestroyTexture(layer->target);
+	layer->target = NULL;
+	layer->dirty = true;
+}
+
+void v2d_layers_free(v2d_layers_t *layers) {
+	if (!layers) return;
+	for (int i = 0; i < V2D_WORLD_LAYERS; i++) _drop_cache(&layers->layers[i]);
+	v2d_free(layers);
+}
+
+void v2d_layers_invalidate(v2d_layers_t *layers, unsigned layer) {
+	if (layer < V2D_WORLD_LAYERS) layers->layers[layer].dirty = true;
+}
+
+// The camera a layer is drawn with, after parallax
+static v2d_transform_t _camera(const struct v2d_layer *layer, v2d_transform_t camera) {
+	if (layer->screen_space) return v2d_transform_new();
+	camera.add = v2d_vec(v2dvx(camera.add) * v2dvx(layer->parallax), v2dvy(camera.add) * v2dvy(layer->parallax));
+	return camera;
+}
+
+static void _draw(const v2d_world_t *world, v2d_render_t *render, unsigned layer) {
+	for (struct v2d_world_entity_list *l = world->entities; l; l = l->next) {
+		if (l->layer == layer && l->ent->render) l->ent->render(l->ent, render);
+	}
+}
+
+// Find where a layer's cache should be copied to, or return false if the cache can't be used as it is
+static bool _cache_rect(const struct v2d_layer *layer, const v2d_render_t *render, v2d_transform_t camera, int w, int h, SDL_Rect *dst) {
+	if (!layer->target || layer->dirty) return false;
+	if (layer->target_w != w + 2*V2D_LAYER_MARGIN || layer->target_h != h + 2*V2D_LAYER_MARGIN) return false;
+
+	// Rotation, zoom and changes to the screen transformation can't be made up for by moving the cache
+	if (camera.mul != layer->target_camera.mul) return false;
+	if (render->screen_tr.mul != layer->target_screen.mul || render->screen_tr.add != layer->target_screen.add) return false;
+
+	// Panning can, as long as the margin still covers the screen
+	v2d_vec_t offset = conj(camera.add - layer->target_camera.add) * render->screen_tr.mul;
+	double dx = round(v2dvx(offset)), dy = round(v2dvy(offset));
+	if (fabs(dx) > V2D_LAYER_MARGIN || fabs(dy) > V2D_LAYER_MARGIN) return false;
+
+	*dst = (SDL_Rect){dx - V2D_LAYER_MARGIN, dy - V2D_LAYER_MARGIN, layer->target_w, layer->target_h};
+	return true;
+}
+
+// Draw a layer into its cache, with the screen in the middle and the margin around it
+static bool _redraw(struct v2d_layer *layer, v2d_render_t *render, const v2d_world_t *world, unsigned index, v2d_transform_t camera, int w, int h) {
+	SDL_Renderer *ren = render->sdl_ren;
+	int tw = w + 2*V2D_LAYER_MARGIN, th = h + 2*V2D_LAYER_MARGIN;
+	if (layer->target && (layer->target_w != tw || layer->target_h != th)) _drop_cache(layer);
+
+	if (!layer->target) {
+		layer->target = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, tw, th);
+		v2d_stat_add(sdl_calls, 1);
+		if (!layer->target) {
+			v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
+			return false;
+		}
+		SDL_SetTextureBlendMode(layer->target, SDL_BLENDMODE_BLEND);
+		layer->target_w = tw;
+		layer->target_h = th;
+	}
+
+	SDL_Texture *prev = SDL_GetRenderTarget(ren);
+	if (SDL_SetRenderTarget(ren, layer->target)) {
+		v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
+		_drop_cache(layer);
+		return false;
+	}
+
+	// Clear to transparent, so the layers behind show through
+	Uint8 r, g, b, a;
+	SDL_GetRenderDrawColor(ren, &r, &g, &b, &a);
+	SDL_SetRenderDrawColor(ren, 0, 0, 0, 0);
+	SDL_RenderClear(ren);
+	SDL_SetRenderDrawColor(ren, r, g, b, a);
+	v2d_stat_add(sdl_calls, 6);
+
+	// The cache is drawn straight away even when tracking damage, and its new contents damage wherever it's copied to
+	struct v2d_render_damage *damage = render->damage;
+	v2d_transform_t saved_camera = render->camera_tr, saved_screen = render->screen_tr;
+	render->damage = NULL;
+	render->camera_tr = camera;
+	render->screen_tr.add += v2d_vec(V2D_LAYER_MARGIN, V2D_LAYER_MARGIN);
+	_draw(world, render, index);
+	render->damage = damage;
+	render->camera_tr = saved_camera;
+	render->screen_tr = saved_screen;
+	v2d_render_damage(render, NULL);
+
+	SDL_SetRenderTarget(ren, prev);
+	layer->target_camera = camera;
+	layer->target_screen = render->screen_tr;
+	layer->dirty = false;
+	return true;
+}
+
+void v2d_layers_render(v2d_layers_t *layers, const v2d_world_t *world) {
+	v2d_render_t *render = layers->render;
+	v2d_transform_t camera = render->camera_tr;
+
+	int w, h;
+	SDL_GetRendererOutputSize(render->sdl_ren, &w, &h);
+	bool targets = SDL_RenderTargetSupported(render->sdl_ren);
+	v2d_stat_add(sdl_calls, 2);
+
+	v2d_prof_zone("layers") for (unsigned i = 0; i < V2D_WORLD_LAYERS; i++) {
+		struct v2d_layer *layer = layers->layers + i;
+		if (!layer->cached && layer->target) _drop_cache(layer);
+		if (!world->layer_count[i]) continue;
+
+		v2d_transform_t layer_camera = _camera(layer, camera);
+		SDL_Rect dst;
+		bool cached = layer->cached && targets && (_cache_rect(layer, render, layer_camera, w, h, &dst)
+			|| (_redraw(layer, render, world, i, layer_camera, w, h) && _cache_rect(layer, render, layer_camera, w, h, &dst)));
+
+		if (cached) {
+			v2d_render_copy(render, layer->target, NULL, &dst);
+		} else {
+			// Uncached, or the cache couldn't be made, so draw straight to the screen
+			render->camera_tr = layer_camera;
+			_draw(world, render, i);
+		}
+	}
+
+	render->camera_tr = camera;
+}
@@ -0,0 +1,574 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "v2d.h"
+
+#define NONE UINT32_MAX
+#define CLOSED (UINT32_MAX - 1)
+#define SQRT2 1.41421356f
+
+// Directions, anticlockwise from +X. Odd directions are diagonal
+static const int _dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+static const int _dy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+#define OPPOSITE(d) (((d) + 4) & 7)
+#define COST(d) ((d) & 1 ? SQRT2 : 1.0f)
+
+static int _dir(int dx, int dy) {
+	for (int d = 0; d < 8; d++) {
+		if (_dx[d] == dx && _dy[d] == dy) return d;
+	}
+	return -1;
+}
+
+static inline bool _free(const v2d_nav_t *nav, int x, int y) {
+	return x >= 0 && y >= 0 && x < nav->w && y < nav->h && !nav->blockers[y*nav->w + x];
+}
+
+// Return true if an agent can move from a cell in direction d
+static inline bool _can_move(const v2d_nav_t *nav, int x, int y, int d) {
+	if (!_free(nav, x + _dx[d], y + _dy[d])) return false;
+	if (d & 1) return _free(nav, x + _dx[d], y) && _free(nav, x, y + _dy[d]);
+	return true;
+}
+
+// Searches
+
+static bool _search_init(struct v2d_nav_search *s, size_t cells) {
+	*s = (struct v2d_nav_search){0};
+	s->stamps = v2d_alloc(cells * sizeof *s->stamps);
+	s->g = v2d_alloc(cells * sizeof *s->g);
+	s->f = v2d_alloc(cells * sizeof *s->f);
+	s->parent = v2d_alloc(cells * sizeof *s->parent);
+	s->heap_pos = v2d_alloc(cells * sizeof *s->heap_pos);
+	s->heap = v2d_alloc(cells * sizeof *s->heap);
+	if (!s->stamps || !s->g || !s->f || !s->parent || !s->heap_pos || !s->heap) return false;
+	memset(s->stamps, 0, cells * sizeof *s->stamps);
+	return true;
+}
+
+static void _search_destroy(struct v2d_nav_search *s) {
+	v2d_free(s->stamps);
+	v2d_free(s->g);
+	v2d_free(s->f);
+	v2d_free(s->parent);
+	v2d_free(s->heap_pos);
+	v2d_free(s->heap);
+}
+
+static void _search_begin(struct v2d_nav_search *s, size_t cells) {
+	s->n_heap = 0;
+	if (++s->stamp == 0) {
+		// The stamp wrapped around, so old stamps could look current
+		memset(s->stamps, 0, cells * sizeof *s->stamps);
+		s->stamp = 1;
+	}
+}
+
+static inline void _touch(struct v2d_nav_search *s, uint32_t c) {
+	if (s->stamps[c] == s->stamp) return;
+	s->stamps[c] = s->stamp;
+	s->g[c] = INFINITY;
+	s->parent[c] = NONE;
+	s->heap_pos[c] = NONE;
+}
+
+// An indexed binary min-heap of cells, ordered by `key`
+
+static void _heap_set(struct v2d_nav_search *s, size_t i, uint32_t c) {
+	s->heap[i] = c;
+	s->heap_pos[c] = i;
+}
+
+static void _heap_up(struct v2d_nav_search *s, const float *key, size_t i) {
+	uint32_t c = s->heap[i];
+	while (i > 0) {
+		size_t up = (i - 1) / 2;
+		if (key[s->heap[up]] <= key[c]) break;
+		_heap_set(s, i, s->heap[up]);
+		i = up;
+	}
+	_heap_set(s, i, c);
+}
+
+static void _heap_down(struct v2d_nav_search *s, const float *key, size_t i) {
+	uint32_t c = s->heap[i];
+	for (;;) {
+		size_t child = 2*i + 1;
+		if (child >= s->n_heap) break;
+		if (child + 1 < s->n_heap && key[s->heap[child + 1]] < key[s->heap[child]]) child++;
+		if (key[c] <= key[s->heap[child]]) break;
+		_heap_set(s, i, s->heap[child]);
+		i = child;
+	}
+	_heap_set(s, i, c);
+}
+
+// Insert a touched cell into the heap, or move it up if its key decreased
+static void _heap_push(struct v2d_nav_search *s, const float *key, uint32_t c) {
+	size_t i = s->heap_pos[c];
+	if (i == NONE || i == CLOSED) {
+		i = s->n_heap++;
+		_heap_set(s, i, c);
+	}
+	_heap_up(s, key, i);
+}
+
+static uint32_t _heap_pop(struct v2d_nav_search *s, const float *key) {
+	uint32_t c = s->heap[0];
+	if (--s->n_heap) {
+		_heap_set(s, 0, s->heap[s->n_heap]);
+		_heap_down(s, key, 0);
+	}
+	s->heap_pos[c] = CLOSED;
+	return c;
+}
+
+// Grid
+
+v2d_nav_t *v2d_nav_new(v2d_vec_t origin, double cell_size, int w, int h) {
+	v2d_nav_t *nav = v2d_alloc(sizeof *nav);
+	if (!nav) return NULL;
+	*nav = (v2d_nav_t){
+		.origin = origin,
+		.cell_size = cell_size,
+		.w = w, .h = h,
+	};
+
+	size_t cells = (size_t)w * h;
+	nav->blockers = v2d_alloc(cells * sizeof *nav->blockers);
+	nav->queue = v2d_alloc(cells * sizeof *nav->queue);
+	nav->searches = v2d_alloc(sizeof *nav->searches);
+	if (!nav->blockers || !nav->queue || !nav->searches) goto fail;
+	memset(nav->blockers, 0, cells * sizeof *nav->blockers);
+
+	nav->n_searches = 1;
+	if (!_search_init(nav->searches, cells)) goto fail;
+
+	return nav;
+
+fail:
+	v2d_nav_free(nav);
+	return NULL;
+}
+
+void v2d_nav_free(v2d_nav_t *nav) {
+	for (int i = 0; i < V2D_NAV_FIELDS; i++) {
+		v2d_free(nav->fields[i].dist);
+		v2d_free(nav->fields[i].next);
+	}
+	for (unsigned i = 0; i < nav->n_searches; i++) {
+		_search_destroy(&nav->searches[i]);
+	}
+	v2d_free(nav->searches);
+	v2d_free(nav->blockers);
+	v2d_free(nav->changed);
+	v2d_free(nav->queue);
+	v2d_free(nav);
+}
+
+bool v2d_nav_cell(const v2d_nav_t *nav, v2d_vec_t pos, int *x, int *y) {
+	v2d_vec_t rel = (pos - nav->origin) / nav->cell_size;
+	double fx = floor(v2dvx(rel)), fy = floor(v2dvy(rel));
+	if (fx < 0 || fy < 0 || fx >= nav->w || fy >= nav->h) return false;
+	*x = fx;
+	*y = fy;
+	return true;
+}
+
+v2d_vec_t v2d_nav_cell_center(const v2d_nav_t *nav, int x, int y) {
+	return nav->origin + v2d_vec(x + 0.5, y + 0.5) * nav->cell_size;
+}
+
+bool v2d_nav_walkable(const v2d_nav_t *nav, int x, int y) {
+	return _free(nav, x, y);
+}
+
+static void _repair_fields(v2d_nav_t *nav);
+
+// Add delta to the blocker count of every cell overlapping a rect, recording cells that change between blocked and free
+static bool _change_rect(v2d_nav_t *nav, v2d_rect_t rect, int delta) {
+	v2d_rect_t b = v2d_shape_bounds(V2D_SHAPE_RECT_LIT(rect.pos, rect.dim));
+	v2d_vec_t lo = (b.pos - nav->origin) / nav->cell_size;
+	v2d_vec_t hi = (b.pos + b.dim - nav->origin) / nav->cell_size;
+
+	int x0 = fmax(floor(v2dvx(lo)), 0), x1 = fmin(ceil(v2dvx(hi)), nav->w) - 1;
+	int y0 = fmax(floor(v2dvy(lo)), 0), y1 = fmin(ceil(v2dvy(hi)), nav->h) - 1;
+	if (x1 < x0 || y1 < y0) return true;
+
+	// Make room for every cell to change first, so running out of memory can't leave a change unrecorded
+	size_t cells = (size_t)(x1 - x0 + 1) * (y1 - y0 + 1);
+	if (!v2d_array_reserve(&nav->changed, &nav->cap_changed, sizeof *nav->changed, nav->n_changed + cells)) return false;
+
+	for (int y = y0; y <= y1; y++) {
+		for (int x = x0; x <= x1; x++) {
+			uint32_t c = y*nav->w + x;
+			if (delta < 0 && !nav->blockers[c]) continue;
+			if (delta > 0 && nav->blockers[c] == UINT16_MAX) continue;
+
+			nav->blockers[c] += delta;
+			if (nav->blockers[c] == (delta > 0 ? 1 : 0)) nav->changed[nav->n_changed++] = c;
+		}
+	}
+	return true;
+}
+
+bool v2d_nav_add_rect(v2d_nav_t *nav, v2d_rect_t rect) {
+	return v2d_nav_add_rects(nav, &rect, 1);
+}
+
+bool v2d_nav_remove_rect(v2d_nav_t *nav, v2d_rect_t rect) {
+	nav->n_changed = 0;
+	bool ok = _change_rect(nav, rect, -1);
+	_repair_fields(nav);
+	return ok;
+}
+
+bool v2d_nav_add_rects(v2d_nav_t *nav, const v2d_rect_t *rects, size_t n) {
+	nav->n_changed = 0;
+	bool ok = true;
+	for (size_t i = 0; ok && i < n; i++) {
+		ok = _change_rect(nav, rects[i], 1);
+	}
+	_repair_fields(nav);
+	return ok;
+}
+
+// Jump Point Search
+
+static inline float _octile(int dx, int dy) {
+	dx = abs(dx);
+	dy = abs(dy);
+	return dx > dy ? dx + (SQRT2 - 1)*dy : dy + (SQRT2 - 1)*dx;
+}
+
+// Move from a cell in a direction until reaching a jump point
+// Returns false if there's no jump point in that direction
+static bool _jump(const v2d_nav_t *nav, int x, int y, int dx, int dy, int gx, int gy, int *jx, int *jy) {
+	for (;; x += dx, y += dy) {
+		if (!_free(nav, x, y)) return false;
+		if (x == gx && y == gy) break;
+
+		if (dx && dy) {
+			int tx, ty;
+			if (_jump(nav, x + dx, y, dx, 0, gx, gy, &tx, &ty) || _jump(nav, x, y + dy, 0, dy, gx, gy, &tx, &ty)) break;
+			// Don't cut corners
+			if (!_free(nav, x + dx, y) || !_free(nav, x, y + dy)) return false;
+		} else if (dx) {
+			// Forced neighbours: a wall behind us ends, opening up a new direction
+			if ((_free(nav, x, y - 1) && !_free(nav, x - dx, y - 1)) || (_free(nav, x, y + 1) && !_free(nav, x - dx, y + 1))) break;
+		} else {
+			if ((_free(nav, x - 1, y) && !_free(nav, x - 1, y - dy)) || (_free(nav, x + 1, y) && !_free(nav, x + 1, y - dy))) break;
+		}
+	}
+
+	*jx = x;
+	*jy = y;
+	return true;
+}
+
+static inline int _sign(int x) {
+	return (x > 0) - (x < 0);
+}
+
+// Return the directions worth searching from a cell, given the direction it was reached from, as a bit mask
+static unsigned _prune(const v2d_nav_t *nav, int x, int y, int dx, int dy) {
+	unsigned dirs = 0;
+
+	if (!dx && !dy) {
+		// The start cell searches everywhere
+		for (int d = 0; d < 8; d++) {
+			if (_can_move(nav, x, y, d)) dirs |= 1u << d;
+		}
+		return dirs;
+	}
+
+	for (int d = 0; d < 8; d++) {
+		int ddx = _dx[d], ddy = _dy[d];
+		bool keep;
+		if (dx && dy) {
+			keep = (ddx == dx && ddy == 0) || (ddx == 0 && ddy == dy) || (ddx == dx && ddy == dy);
+		} else if (dx) {
+			keep = ddx == dx || (ddx == 0 && ddy != 0);
+		} else {
+			keep = ddy == dy || (ddy == 0 && ddx != 0);
+		}
+		if (keep && _can_move(nav, x, y, d)) dirs |= 1u << d;
+	}
+	return dirs;
+}
+
+static size_t _find_path(v2d_nav_t *nav, struct v2d_nav_search *s, v2d_vec_t from, v2d_vec_t to, v2d_vec_t *path, size_t max) {
+	int sx, sy, gx, gy;
+	if (!v2d_nav_cell(nav, from, &sx, &sy) || !v2d_nav_cell(nav, to, &gx, &gy)) return 0;
+	if (!_free(nav, sx, sy) || !_free(nav, gx, gy)) return 0;
+
+	uint32_t start = sy*nav->w + sx, goal = gy*nav->w + gx;
+	_search_begin(s, (size_t)nav->w * nav->h);
+
+	_touch(s, start);
+	s->g[start] = 0;
+	s->f[start] = _octile(gx - sx, gy - sy);
+	_heap_push(s, s->f, start);
+
+	bool found = false;
+	while (s->n_heap) {
+		uint32_t c = _heap_pop(s, s->f);
+		if (c == goal) {
+			found = true;
+			break;
+		}
+
+		int x = c % nav->w, y = c / nav->w;
+		int px = 0, py = 0;
+		if (s->parent[c] != NONE) {
+			px = _sign(x - (int)(s->parent[c] % nav->w));
+			py = _sign(y - (int)(s->parent[c] / nav->w));
+		}
+
+		unsigned dirs = _prune(nav, x, y, px, py);
+		for (int d = 0; d < 8; d++) {
+			if (!(dirs & (1u << d))) continue;
+
+			int jx, jy;
+			if (!_jump(nav, x + _dx[d], y + _dy[d], _dx[d], _dy[d], gx, gy, &jx, &jy)) continue;
+
+			uint32_t j = jy*nav->w + jx;
+			_touch(s, j);
+			if (s->heap_pos[j] == CLOSED) continue;
+
+			float g = s->g[c] + _octile(jx - x, jy - y);
+			if (g < s->g[j]) {
+				s->g[j] = g;
+				s->f[j] = g + _octile(gx - jx, gy - jy);
+				s->parent[j] = c;
+				_heap_push(s, s->f, j);
+			}
+		}
+	}
+
+	if (!found) return 0;
+
+	size_t n = 0;
+	for (uint32_t c = goal; c != NONE; c = s->parent[c]) n++;
+
+	size_t i = n;
+	for (uint32_t c = goal; c != NONE; c = s->parent[c]) {
+		if (--i < max) path[i] = v2d_nav_cell_center(nav, c % nav->w, c / nav->w);
+	}
+	return n;
+}
+
+size_t v2d_nav_find_path(v2d_nav_t *nav, v2d_vec_t from, v2d_vec_t to, v2d_vec_t *path, size_t max) {
+	size_t n;
+	v2d_prof_zone("nav path") {
+		n = _find_path(nav, &nav->searches[0], from, to, path, max);
+	}
+	return n;
+}
+
+struct _batch {
+	v2d_nav_t *nav;
+	struct v2d_nav_query *queries;
+};
+
+static void _find_paths_job(void *ctx, size_t begin, size_t end, unsigned worker) {
+	struct _batch *batch = ctx;
+	for (size_t i = begin; i < end; i++) {
+		struct v2d_nav_query *q = &batch->queries[i];
+		q->n = _find_path(batch->nav, &batch->nav->searches[worker], q->from, q->to, q->path, q->max);
+	}
+}
+
+bool v2d_nav_find_paths(v2d_nav_t *nav, struct v2d_nav_query *queries, size_t n, v2d_jobs_t *jobs) {
+	// Make sure every worker has its own search, since the workers can't allocate
+	unsigned workers = v2d_jobs_workers(jobs);
+	if (nav->n_searches < workers) {
+		struct v2d_nav_search *searches = v2d_alloc(workers * sizeof *searches);
+		if (!searches) return false;
+		memcpy(searches, nav->searches, nav->n_searches * sizeof *searches);
+
+		size_t cells = (size_t)nav->w * nav->h;
+		for (unsigned i = nav->n_searches; i < workers; i++) {
+			if (!_search_init(&searches[i], cells)) {
+				for (unsigned j = nav->n_searches; j <= i; j++) _search_destroy(&searches[j]);
+				v2d_free(searches);
+				return false;
+			}
+		}
+
+		v2d_free(nav->searches);
+		nav->searches = searches;
+		nav->n_searches = workers;
+	}
+
+	v2d_prof_zone("nav paths") {
+		struct _batch batch = {nav, queries};
+		v2d_jobs_parallel_for(jobs, n, 0, _find_paths_job, &batch);
+	}
+	return true;
+}
+
+// Flow fields
+
+// Run Dijkstra's algorithm outwards from the cells in the search's heap, lowering distances in the field
+static void _propagate(v2d_nav_t *nav, struct v2d_nav_field *field, struct v2d_nav_search *s) {
+	while (s->n_heap) {
+		uint32_t c = _heap_pop(s, field->dist);
+		int x = c % nav->w, y = c / nav->w;
+
+		for (int d = 0; d < 8; d++) {
+			if (!_can_move(nav, x, y, d)) continue;
+
+			uint32_t n = (y + _dy[d])*nav->w + x + _dx[d];
+			float dist = field->dist[c] + COST(d);
+			if (dist < field->dist[n]) {
+				field->dist[n] = dist;
+				field->next[n] = OPPOSITE(d);
+				_touch(s, n);
+				_heap_push(s, field->dist, n);
+			}
+		}
+	}
+}
+
+static void _compute_field(v2d_nav_t *nav, struct v2d_nav_field *field) {
+	size_t cells = (size_t)nav->w * nav->h;
+	for (size_t i = 0; i < cells; i++) {
+		field->dist[i] = INFINITY;
+		field->next[i] = -1;
+	}
+	if (nav->blockers[field->goal]) return;
+
+	struct v2d_nav_search *s = &nav->searches[0];
+	_search_begin(s, cells);
+	field->dist[field->goal] = 0;
+	_touch(s, field->goal);
+	_heap_push(s, field->dist, field->goal);
+	_propagate(nav, field, s);
+}
+
+static void _invalidate(v2d_nav_t *nav, struct v2d_nav_field *field, uint32_t c, size_t *n_queue) {
+	if (field->dist[c] == INFINITY) return;
+	field->dist[c] = INFINITY;
+	field->next[c] = -1;
+	nav->queue[(*n_queue)++] = c;
+}
+
+// Update a field after the cells in nav->changed have been blocked or freed
+static void _repair_field(v2d_nav_t *nav, struct v2d_nav_field *field) {
+	for (size_t i = 0; i < nav->n_changed; i++) {
+		if (nav->changed[i] == field->goal) {
+			_compute_field(nav, field);
+			return;
+		}
+	}
+	if (nav->blockers[field->goal]) return;
+
+	// Find every cell whose route passed through a newly blocked cell, and forget its distance
+	size_t n_queue = 0;
+	for (size_t i = 0; i < nav->n_changed; i++) {
+		uint32_t c = nav->changed[i];
+		if (!nav->blockers[c]) continue;
+		_invalidate(nav, field, c, &n_queue);
+
+		// Diagonal moves around the corners of this cell are no longer allowed
+		int x = c % nav->w, y = c / nav->w;
+		for (int d = 1; d < 8; d += 2) {
+			int ax = x + _dx[d], ay = y, bx = x, by = y + _dy[d];
+			if (!_free(nav, ax, ay) || !_free(nav, bx, by)) continue;
+			uint32_t a = ay*nav->w + ax, b = by*nav->w + bx;
+			if (field->next[a] == _dir(-_dx[d], _dy[d])) _invalidate(nav, field, a, &n_queue);
+			if (field->next[b] == _dir(_dx[d], -_dy[d])) _invalidate(nav, field, b, &n_queue);
+		}
+	}
+	for (size_t i = 0; i < n_queue; i++) {
+		uint32_t c = nav->queue[i];
+		int x = c % nav->w, y = c / nav->w;
+		for (int d = 0; d < 8; d++) {
+			int nx = x + _dx[d], ny = y + _dy[d];
+			if (nx < 0 || ny < 0 || nx >= nav->w || ny >= nav->h) continue;
+			uint32_t n = ny*nav->w + nx;
+			if (field->next[n] == OPPOSITE(d)) _invalidate(nav, field, n, &n_queue);
+		}
+	}
+
+	// Then spread distances back in from the edges of the forgotten region and from newly freed cells
+	struct v2d_nav_search *s = &nav->searches[0];
+	_search_begin(s, (size_t)nav->w * nav->h);
+	for (size_t i = 0; i < n_queue + nav->n_changed; i++) {
+		uint32_t c = i < n_queue ? nav->queue[i] : nav->changed[i - n_queue];
+		if (nav->blockers[c]) continue;
+
+		int x = c % nav->w, y = c / nav->w;
+		for (int d = 0; d < 8; d++) {
+			int nx = x + _dx[d], ny = y + _dy[d];
+			if (nx < 0 || ny < 0 || nx >= nav->w || ny >= nav->h) continue;
+			uint32_t n = ny*nav->w + nx;
+			if (field->dist[n] == INFINITY) continue;
+			_touch(s, n);
+			_heap_push(s, field->dist, n);
+		}
+	}
+	_propagate(nav, field, s);
+}
+
+static void _repair_fields(v2d_nav_t *nav) {
+	if (!nav->n_changed) return;
+	v2d_prof_zone("nav repair") {
+		for (int i = 0; i < V2D_NAV_FIELDS; i++) {
+			if (nav->fields[i].used) _repair_field(nav, &nav->fields[i]);
+		}
+	}
+	nav->n_changed = 0;
+}
+
+const struct v2d_nav_field *v2d_nav_field(v2d_nav_t *nav, v2d_vec_t goal) {
+	int x, y;
+	if (!v2d_nav_cell(nav, goal, &x, &y)) return NULL;
+	uint32_t c = y*nav->w + x;
+
+	// Look for a cached field, or else the least recently used one
+	struct v2d_nav_field *field = &nav->fields[0];
+	for (int i = 0; i < V2D_NAV_FIELDS; i++) {
+		struct v2d_nav_field *f = &nav->fields[i];
+		if (f->used && f->goal == c) {
+			f->last_used = ++nav->clock;
+			return f;
+		}
+		if (!f->used || (field->used && f->last_used < field->last_used)) field = f;
+	}
+
+	if (!field->dist) {
+		size_t cells = (size_t)nav->w * nav->h;
+		field->dist = v2d_alloc(cells * sizeof *field->dist);
+		if (!field->dist) return NULL;
+		field->next = v2d_alloc(cells * sizeof *field->next);
+		if (!field->next) {
+			v2d_free(field->dist);
+			field->dist = NULL;
+			return NULL;
+		}
+	}
+
+	field->used = true;
+	field->goal = c;
+	field->last_used = ++nav->clock;
+	v2d_prof_zone("nav field") {
+		_compute_field(nav, field);
+	}
+	return field;
+}
+
+v2d_vec_t v2d_nav_flow(const v2d_nav_t *nav, const struct v2d_nav_field *field, v2d_vec_t pos) {
+	int x, y;
+	if (!v2d_nav_cell(nav, pos, &x, &y)) return 0;
+	int d = field->next[y*nav->w + x];
+	if (d < 0) return 0;
+
+	// Head for the center of the next cell, so agents don't clip the corners of walls
+	v2d_vec_t dir = v2d_nav_cell_center(nav, x + _dx[d], y + _dy[d]) - pos;
+	double mag = v2d_vec_mag(dir);
+	return mag > 0 ? dir / mag : 0;
+}
@@ -0,0 +1,101 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "v2d.h"
+
+// How much of the gap between the expected render time and a faster frame is closed each frame
+#define COST_DECAY (1.0/16)
+
+static double _seconds(int64_t ticks) {
+	return ticks / (double)SDL_GetPerformanceFrequency();
+}
+
+static uint64_t _ticks(double seconds) {
+	return seconds * SDL_GetPerformanceFrequency();
+}
+
+void v2d_pacer_init(v2d_pacer_t *pacer, double frame_time, bool vsync) {
+	if (frame_time < 0) frame_time = 0;
+	*pacer = (v2d_pacer_t){.frame_time = frame_time, .vsync = vsync};
+	pacer->next = SDL_GetPerformanceCounter() + _ticks(frame_time);
+}
+
+double v2d_pacer_remaining(const v2d_pacer_t *pacer) {
+	int64_t until = pacer->next - SDL_GetPerformanceCounter();
+	return _seconds(until) - pacer->render_cost - V2D_PACER_SLACK;
+}
+
+void v2d_pacer_begin_frame(v2d_pacer_t *pacer) {
+	pacer->render_start = SDL_GetPerformanceCounter();
+}
+
+void v2d_pacer_present(v2d_pacer_t *pacer) {
+	double cost = _seconds(SDL_GetPerformanceCounter() - pacer->render_start);
+	if (cost > pacer->render_cost) pacer->render_cost = cost;
+	else pacer->render_cost += (cost - pacer->render_cost) * COST_DECAY;
+}
+
+void v2d_pacer_end_frame(v2d_pacer_t *pacer) {
+	uint64_t now = SDL_GetPerformanceCounter();
+	uint64_t period = _ticks(pacer->frame_time);
+
+	if (pacer->last_frame) {
+		double interval = _seconds(now - pacer->last_frame);
+		pacer->history[pacer->frames % V2D_PACER_HISTORY] = interval;
+
+		// Presenting waited for the display, so any gap of more than a frame and a half is a missed refresh
+		if (pacer->vsync && period && interval > 1.5 * pacer->frame_time) {
+			pacer->dropped += lround(interval / pacer->frame_time) - 1;
+		}
+	}
+	pacer->frames++;
+	pacer->last_frame = now;
+
+	if (pacer->vsync && (int64_t)(now - pacer->next) > -(int64_t)_ticks(V2D_PACER_SLACK / 2)) {
+		// The present waited for the refresh, so that's what the next frame is timed from
+		// Presents that return well before the deadline didn't wait, for example because nothing was drawn, so they keep the schedule
+		pacer->next = now + period;
+	} else if (!period) {
+		pacer->next = now;
+	} else {
+		pacer->next += period;
+		if ((int64_t)(now - pacer->next) >= 0) {
+			// Skip the slots that have already passed, rather than rendering them all at once
+			uint64_t missed = (now - pacer->next) / period + 1;
+			pacer->next += missed * period;
+			pacer->dropped += missed;
+		}
+	}
+}
+
+void v2d_pacer_drop_time(v2d_pacer_t *pacer, double seconds) {
+	pacer->dropped_time += seconds;
+}
+
+struct v2d_frame_stats v2d_pacer_stats(const v2d_pacer_t *pacer) {
+	struct v2d_frame_stats stats = {
+		.frames = pacer->frames,
+		.dropped = pacer->dropped,
+		.render = pacer->render_cost,
+		.dropped_time = pacer->dropped_time,
+	};
+
+	// The first frame has nothing to be timed against
+	uint64_t n = pacer->frames ? pacer->frames - 1 : 0;
+	if (n > V2D_PACER_HISTORY) n = V2D_PACER_HISTORY;
+	if (!n) return stats;
+
+	stats.last = pacer->history[(pacer->frames - 1) % V2D_PACER_HISTORY];
+	for (uint64_t i = 0; i < n; i++) {
+		double t = pacer->history[(pacer->frames - 1 - i) % V2D_PACER_HISTORY];
+		stats.mean += t;
+		if (t > stats.worst) stats.worst = t;
+	}
+	stats.mean /= n;
+	return stats;
+}
+
+void v2d_pacer_sleep(double seconds) {
+	if (seconds >= 0.001) SDL_Delay(seconds * 1000);
+}
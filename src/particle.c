@@ -0,0 +1,172 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL.h>
+#include "v2d.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define USE_SSE
+#include <xmmintrin.h>
+#endif
+
+static void _update(v2d_ent_t *ent, double dt) {
+	v2d_emitter_t *em = ent;
+
+	em->rate_accumulator += em->rate * dt;
+	if (em->rate_accumulator >= 1) {
+		size_t count = em->rate_accumulator;
+		em->rate_accumulator -= count;
+		v2d_emitter_emit(em, count);
+	}
+
+	v2d_emitter_update(em, dt);
+}
+
+static void _render(v2d_ent_t *ent, v2d_render_t *render) {
+	v2d_emitter_render(ent, render);
+}
+
+v2d_emitter_t *v2d_emitter_new(size_t cap) {
+	// Round the capacity up so SIMD loops never need to stop partway through an array
+	size_t padded = (cap + 3) & ~(size_t)3;
+
+	// Everything lives in a single allocation: the emitter, then each particle array
+	size_t array_size = padded * sizeof (float);
+	size_t header = (sizeof (v2d_emitter_t) + 15) & ~(size_t)15;
+	char *mem = v2d_alloc(header + 5*array_size + padded * sizeof (SDL_FPoint));
+	if (!mem) return NULL;
+
+	// The padding is updated along with the live particles, so it must hold ordinary numbers rather than garbage
+	memset(mem + header, 0, 5*array_size);
+
+	v2d_emitter_t *em = (v2d_emitter_t *)mem;
+	*em = (v2d_emitter_t){
+		.cb = {_render, _update, NULL},
+		.cap = cap,
+		.x = (float *)(mem + header),
+		.y = (float *)(mem + header + array_size),
+		.vx = (float *)(mem + header + 2*array_size),
+		.vy = (float *)(mem + header + 3*array_size),
+		.life = (float *)(mem + header + 4*array_size),
+		.points = (SDL_FPoint *)(mem + header + 5*array_size),
+		.life_min = 1, .life_max = 1,
+		.r = 1, .g = 1, .b = 1, .a = 1,
+		.rng = 0x9e3779b9,
+	};
+	return em;
+}
+
+void v2d_emitter_free(v2d_emitter_t *em) {
+	v2d_free(em);
+}
+
+// xorshift32, returning a float in [0, 1)
+static inline float _randf(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (x >> 8) * (1.0f / (1 << 24));
+}
+
+size_t v2d_emitter_emit(v2d_emitter_t *em, size_t count) {
+	if (count > em->cap - em->n) count = em->cap - em->n;
+
+	float px = v2dvx(em->pos), py = v2dvy(em->pos);
+	float vx = v2dvx(em->vel), vy = v2dvy(em->vel);
+	float spread = em->spread;
+	float life_min = em->life_min, life_range = em->life_max - em->life_min;
+
+	for (size_t i = em->n; i < em->n + count; i++) {
+		// Uniformly distributed within a circle of radius `spread`
+		float angle = _randf(&em->rng) * 6.2831853f;
+		float mag = sqrtf(_randf(&em->rng)) * spread;
+
+		em->x[i] = px;
+		em->y[i] = py;
+		em->vx[i] = vx + cosf(angle) * mag;
+		em->vy[i] = vy + sinf(angle) * mag;
+		em->life[i] = life_min + _randf(&em->rng) * life_range;
+	}
+
+	em->n += count;
+	return count;
+}
+
+void v2d_emitter_update(v2d_emitter_t *em, double dt) {
+	if (!em->n) return;
+
+	v2d_prof_zone("particles") {
+		float *restrict x = em->x, *restrict y = em->y;
+		float *restrict vx = em->vx, *restrict vy = em->vy;
+		float *restrict life = em->life;
+
+		const float fdt = dt;
+		const float gx = v2dvx(em->gravity) * fdt, gy = v2dvy(em->gravity) * fdt;
+		const float damp = pow(1 - em->drag, dt);
+
+		// The arrays are padded to a multiple of 4, so there's no need for a scalar tail
+		size_t n = (em->n + 3) & ~(size_t)3;
+
+#ifdef USE_SSE
+		const __m128 vdt = _mm_set1_ps(fdt), vdamp = _mm_set1_ps(damp);
+		const __m128 vgx = _mm_set1_ps(gx), vgy = _mm_set1_ps(gy);
+		// The allocator doesn't promise any alignment, so the loads and stores are unaligned
+		for (size_t i = 0; i < n; i += 4) {
+			__m128 nvx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), vgx), vdamp);
+			__m128 nvy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), vgy), vdamp);
+			_mm_storeu_ps(vx + i, nvx);
+			_mm_storeu_ps(vy + i, nvy);
+			_mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(nvx, vdt)));
+			_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(nvy, vdt)));
+			_mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), vdt));
+		}
+#else
+		for (size_t i = 0; i < n; i++) {
+			vx[i] = (vx[i] + gx) * damp;
+			vy[i] = (vy[i] + gy) * damp;
+			x[i] += vx[i] * fdt;
+			y[i] += vy[i] * fdt;
+			life[i] -= fdt;
+		}
+#endif
+
+		// Remove dead particles by moving the last live particle into their place
+		n = em->n;
+		for (size_t i = 0; i < n;) {
+			if (life[i] > 0) {
+				i++;
+				continue;
+			}
+			n--;
+			x[i] = x[n];
+			y[i] = y[n];
+			vx[i] = vx[n];
+			vy[i] = vy[n];
+			life[i] = life[n];
+		}
+		em->n = n;
+	}
+}
+
+void v2d_emitter_render(v2d_emitter_t *em, v2d_render_t *render) {
+	if (!em->n) return;
+
+	// Particles are drawn in the same way as v2d_render_draw_pixel, but all at once:
+	// conjugate the position, then apply the render transformation
+	v2d_transform_t tr = v2d_render_transform(render);
+	const float mx = v2dvx(tr.mul), my = v2dvy(tr.mul);
+	const float ax = v2dvx(tr.add), ay = v2dvy(tr.add);
+
+	const float *restrict x = em->x, *restrict y = em->y;
+	SDL_FPoint *restrict points = em->points;
+	for (size_t i = 0; i < em->n; i++) {
+		points[i].x = x[i]*mx + y[i]*my + ax;
+		points[i].y = x[i]*my - y[i]*mx + ay;
+	}
+
+	v2d_render_rgba(render, em->r, em->g, em->b, em->a);
+	v2d_render_draw_points(render, points, em->n);
+}
@@ -0,0 +1,343 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "v2d.h"
+
+// Contacts can overlap by this much before position correction kicks in, which stops resting contacts jittering
+#define SLOP 0.01
+// How much of the remaining overlap is corrected every step
+#define BAUMGARTE 0.2
+// Collisions slower than this don't bounce, which also helps resting contacts settle
+#define RESTITUTION_SPEED 1.0
+// The most steps an update callback will take, so a slow frame can't cause a spiral of ever longer updates
+#define MAX_STEPS 8
+
+#define IS(phys, id, flag) ((phys)->flags[id] & (flag))
+#define DYNAMIC_AWAKE (V2D_BODY_ALIVE | V2D_BODY_AWAKE)
+
+static void _update(v2d_ent_t *ent, double dt) {
+	v2d_physics_t *phys = ent;
+	phys->accumulator += dt;
+
+	int steps = 0;
+	while (phys->accumulator >= phys->fixed_dt) {
+		if (steps++ == MAX_STEPS) {
+			phys->accumulator = 0;
+			break;
+		}
+		v2d_physics_step(phys, phys->fixed_dt);
+		phys->accumulator -= phys->fixed_dt;
+	}
+}
+
+v2d_physics_t *v2d_physics_new(void) {
+	v2d_physics_t *phys = v2d_alloc(sizeof *phys);
+	if (!phys) return NULL;
+
+	*phys = (v2d_physics_t){
+		.cb = {NULL, _update, NULL},
+		.gravity = v2d_vec(0, -9.81),
+		.iterations = 8,
+		.sleep_speed = 0.05,
+		.sleep_time = 0.5,
+		.fixed_dt = 1/60.0,
+	};
+	v2d_broad_init(&phys->broad);
+
+	return phys;
+}
+
+void v2d_physics_free(v2d_physics_t *phys) {
+	if (!phys) return;
+
+	v2d_free(phys->pos);
+	v2d_free(phys->vel);
+	v2d_free(phys->force);
+	v2d_free(phys->inv_mass);
+	v2d_free(phys->restitution);
+	v2d_free(phys->friction);
+	v2d_free(phys->rest_time);
+	v2d_free(phys->sleep_next);
+	v2d_free(phys->shape);
+	v2d_free(phys->proxy);
+	v2d_free(phys->flags);
+	v2d_free(phys->data);
+	v2d_free(phys->free_ids);
+	v2d_free(phys->contacts);
+	v2d_free(phys->island);
+	v2d_free(phys->island_rest);
+	v2d_broad_destroy(&phys->broad);
+	v2d_free(phys);
+}
+
+// Make room for n bodies in every per-body array
+static bool _reserve(v2d_physics_t *phys, size_t n) {
+	if (n <= phys->cap_bodies) return true;
+	size_t cap;
+
+	// Each array starts from the same capacity, so they all end up the same size
+#define RESERVE(field) \
+	cap = phys->cap_bodies; \
+	if (!v2d_array_reserve(&phys->field, &cap, sizeof *phys->field, n)) return false;
+
+	RESERVE(pos) RESERVE(vel) RESERVE(force)
+	RESERVE(inv_mass) RESERVE(restitution) RESERVE(friction)
+	RESERVE(rest_time) RESERVE(sleep_next)
+	RESERVE(shape) RESERVE(proxy) RESERVE(flags) RESERVE(data)
+	RESERVE(island) RESERVE(island_rest) RESERVE(free_ids)
+#undef RESERVE
+
+	phys->cap_bodies = cap;
+	phys->cap_free = cap;
+	return true;
+}
+
+uint32_t v2d_physics_add(v2d_physics_t *phys, const struct v2d_body_def *def) {
+	uint32_t id;
+	if (phys->n_free) {
+		id = phys->free_ids[phys->n_free - 1];
+	} else {
+		if (phys->n_bodies >= V2D_BODY_NONE) return V2D_BODY_NONE;
+		if (!_reserve(phys, phys->n_bodies + 1)) return V2D_BODY_NONE;
+		id = phys->n_bodies;
+	}
+
+	uint32_t proxy = v2d_broad_add(&phys->broad, v2d_shape_translate(def->shape, def->pos), (void *)(uintptr_t)id);
+	if (proxy == V2D_PROXY_NONE) return V2D_BODY_NONE;
+
+	// Nothing else can fail, so commit to the ID
+	if (phys->n_free) phys->n_free--;
+	else phys->n_bodies++;
+
+	bool is_static = def->mass <= 0;
+	phys->pos[id] = def->pos;
+	phys->vel[id] = is_static ? 0 : def->vel;
+	phys->force[id] = 0;
+	phys->inv_mass[id] = is_static ? 0 : 1 / def->mass;
+	phys->restitution[id] = def->restitution;
+	phys->friction[id] = def->friction;
+	phys->rest_time[id] = 0;
+	phys->sleep_next[id] = id;
+	phys->shape[id] = def->shape;
+	phys->proxy[id] = proxy;
+	phys->flags[id] = V2D_BODY_ALIVE | (is_static ? V2D_BODY_STATIC : V2D_BODY_AWAKE);
+	phys->data[id] = def->data;
+
+	// Static bodies never need to be tested against each other
+	if (is_static) v2d_broad_set_active(&phys->broad, proxy, false);
+
+	return id;
+}
+
+void v2d_physics_del(v2d_physics_t *phys, uint32_t id) {
+	if (!IS(phys, id, V2D_BODY_ALIVE)) return;
+
+	// Removing a body from a sleeping island could leave the rest of it floating, so wake it first
+	v2d_physics_wake(phys, id);
+
+	v2d_broad_del(&phys->broad, phys->proxy[id]);
+	phys->flags[id] = 0;
+	phys->free_ids[phys->n_free++] = id;
+}
+
+void v2d_physics_wake(v2d_physics_t *phys, uint32_t id) {
+	if (IS(phys, id, V2D_BODY_STATIC) || !IS(phys, id, V2D_BODY_ALIVE) || IS(phys, id, V2D_BODY_AWAKE)) return;
+
+	// Wake every body in the island, breaking up the ring as we go
+	uint32_t i = id;
+	do {
+		uint32_t next = phys->sleep_next[i];
+		phys->flags[i] |= V2D_BODY_AWAKE;
+		phys->rest_time[i] = 0;
+		phys->sleep_next[i] = i;
+		v2d_broad_set_active(&phys->broad, phys->proxy[i], true);
+		i = next;
+	} while (i != id);
+}
+
+bool v2d_physics_awake(const v2d_physics_t *phys, uint32_t id) {
+	return IS(phys, id, V2D_BODY_AWAKE);
+}
+
+void v2d_physics_set_pos(v2d_physics_t *phys, uint32_t id, v2d_vec_t pos) {
+	phys->pos[id] = pos;
+	v2d_broad_move(&phys->broad, phys->proxy[id], v2d_shape_translate(phys->shape[id], pos));
+	v2d_physics_wake(phys, id);
+}
+
+void v2d_physics_set_vel(v2d_physics_t *phys, uint32_t id, v2d_vec_t vel) {
+	if (IS(phys, id, V2D_BODY_STATIC)) return;
+	phys->vel[id] = vel;
+	v2d_physics_wake(phys, id);
+}
+
+void v2d_physics_apply_force(v2d_physics_t *phys, uint32_t id, v2d_vec_t force) {
+	if (IS(phys, id, V2D_BODY_STATIC)) return;
+	phys->force[id] += force;
+	v2d_physics_wake(phys, id);
+}
+
+void v2d_physics_apply_impulse(v2d_physics_t *phys, uint32_t id, v2d_vec_t impulse) {
+	if (IS(phys, id, V2D_BODY_STATIC)) return;
+	phys->vel[id] += impulse * phys->inv_mass[id];
+	v2d_physics_wake(phys, id);
+}
+
+// --- Simulation ---
+
+static void _integrate_velocities(v2d_physics_t *phys, double dt) {
+	for (size_t i = 0; i < phys->n_bodies; i++) {
+		if ((phys->flags[i] & DYNAMIC_AWAKE) != DYNAMIC_AWAKE) continue;
+		phys->vel[i] += (phys->gravity + phys->force[i] * phys->inv_mass[i]) * dt;
+		phys->force[i] = 0;
+	}
+}
+
+static void _find_contacts(v2d_physics_t *phys, double dt) {
+	size_t n_pairs;
+	v2d_pair_t *pairs = v2d_broad_pairs(&phys->broad, &n_pairs);
+	phys->n_contacts = 0;
+
+	for (size_t i = 0; i < n_pairs; i++) {
+		const struct v2d_broad_proxy *pa = phys->broad.proxies + pairs[i].a, *pb = phys->broad.proxies + pairs[i].b;
+		uint32_t a = (uintptr_t)pa->data, b = (uintptr_t)pb->data;
+
+		v2d_contact_t contact;
+		if (!v2d_contact_shape_shape(pa->shape, pb->shape, &contact)) continue;
+		if (!v2d_array_reserve(&phys->contacts, &phys->cap_contacts, sizeof *phys->contacts, phys->n_contacts + 1)) {
+			v2d_warn("out of memory for contacts; some collisions will be missed");
+			return;
+		}
+
+		// One of the bodies is awake, so anything it touches must be woken too
+		v2d_physics_wake(phys, a);
+		v2d_physics_wake(phys, b);
+
+		// Bodies don't rotate, so the effective mass is the same along the normal and the tangent
+		double mass = 1 / (phys->inv_mass[a] + phys->inv_mass[b]);
+		double e = fmax(phys->restitution[a], phys->restitution[b]);
+		double vn = v2d_vec_dot(phys->vel[b] - phys->vel[a], contact.normal);
+
+		// Push overlapping bodies apart, and make fast collisions bounce
+		double bias = BAUMGARTE / dt * fmax(contact.depth - SLOP, 0);
+		if (vn < -RESTITUTION_SPEED) bias = fmax(bias, -e * vn);
+
+		phys->contacts[phys->n_contacts++] = (struct v2d_body_contact){
+			.a = a, .b = b,
+			.contact = contact,
+			.mass_n = mass, .mass_t = mass,
+			.bias = bias,
+			.restitution = e,
+			.friction = sqrt(phys->friction[a] * phys->friction[b]),
+		};
+	}
+}
+
+static void _solve(v2d_physics_t *phys) {
+	v2d_vec_t *vel = phys->vel;
+	const double *inv_mass = phys->inv_mass;
+
+	for (int it = 0; it < phys->iterations; it++) {
+		for (size_t i = 0; i < phys->n_contacts; i++) {
+			struct v2d_body_contact *c = phys->contacts + i;
+			v2d_vec_t n = c->contact.normal, t = v2d_vec(-v2dvy(n), v2dvx(n));
+
+			// Normal impulse. The accumulated impulse must never pull the bodies together
+			double vn = v2d_vec_dot(vel[c->b] - vel[c->a], n);
+			double impulse = c->impulse_n + c->mass_n * (c->bias - vn);
+			if (impulse < 0) impulse = 0;
+			v2d_vec_t p = n * (impulse - c->impulse_n);
+			c->impulse_n = impulse;
+			vel[c->a] -= p * inv_mass[c->a];
+			vel[c->b] += p * inv_mass[c->b];
+
+			// Friction impulse, limited by the normal impulse
+			double vt = v2d_vec_dot(vel[c->b] - vel[c->a], t);
+			double max_t = c->friction * c->impulse_n;
+			impulse = c->impulse_t - c->mass_t * vt;
+			if (impulse < -max_t) impulse = -max_t;
+			if (impulse > max_t) impulse = max_t;
+			p = t * (impulse - c->impulse_t);
+			c->impulse_t = impulse;
+			vel[c->a] -= p * inv_mass[c->a];
+			vel[c->b] += p * inv_mass[c->b];
+		}
+	}
+}
+
+static void _integrate_positions(v2d_physics_t *phys, double dt) {
+	for (size_t i = 0; i < phys->n_bodies; i++) {
+		if ((phys->flags[i] & DYNAMIC_AWAKE) != DYNAMIC_AWAKE) continue;
+		phys->pos[i] += phys->vel[i] * dt;
+		v2d_broad_move(&phys->broad, phys->proxy[i], v2d_shape_translate(phys->shape[i], phys->pos[i]));
+	}
+}
+
+static uint32_t _find_root(uint32_t *island, uint32_t i) {
+	while (island[i] != i) {
+		// Path halving keeps the trees shallow
+		island[i] = island[island[i]];
+		i = island[i];
+	}
+	return i;
+}
+
+static void _sleep_islands(v2d_physics_t *phys, double dt) {
+	size_t n = phys->n_bodies;
+	uint32_t *island = phys->island;
+	double *island_rest = phys->island_rest;
+
+	// Track how long each awake body has been at rest
+	double sleep_speed2 = phys->sleep_speed * phys->sleep_speed;
+	for (size_t i = 0; i < n; i++) {
+		island[i] = i;
+		if ((phys->flags[i] & DYNAMIC_AWAKE) != DYNAMIC_AWAKE) continue;
+		if (v2d_vec_mag2(phys->vel[i]) < sleep_speed2) phys->rest_time[i] += dt;
+		else phys->rest_time[i] = 0;
+		island_rest[i] = INFINITY;
+	}
+
+	// Bodies touching each other form an island. Static bodies don't join islands together
+	for (size_t i = 0; i < phys->n_contacts; i++) {
+		uint32_t a = phys->contacts[i].a, b = phys->contacts[i].b;
+		if (IS(phys, a, V2D_BODY_STATIC) || IS(phys, b, V2D_BODY_STATIC)) continue;
+		a = _find_root(island, a);
+		b = _find_root(island, b);
+		if (a != b) island[a] = b;
+	}
+
+	// An island can only sleep once every body in it has been at rest for long enough
+	for (size_t i = 0; i < n; i++) {
+		if ((phys->flags[i] & DYNAMIC_AWAKE) != DYNAMIC_AWAKE) continue;
+		uint32_t root = _find_root(island, i);
+		island_rest[root] = fmin(island_rest[root], phys->rest_time[i]);
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if ((phys->flags[i] & DYNAMIC_AWAKE) != DYNAMIC_AWAKE) continue;
+		uint32_t root = _find_root(island, i);
+		if (island_rest[root] < phys->sleep_time) continue;
+
+		// Link the body into its island's ring, which starts at the root
+		if (i != root) {
+			phys->sleep_next[i] = phys->sleep_next[root];
+			phys->sleep_next[root] = i;
+		}
+
+		phys->flags[i] &= ~V2D_BODY_AWAKE;
+		phys->vel[i] = 0;
+		v2d_broad_set_active(&phys->broad, phys->proxy[i], false);
+	}
+}
+
+void v2d_physics_step(v2d_physics_t *phys, double dt) {
+	if (dt <= 0) return;
+
+	v2d_prof_zone("physics") {
+		_integrate_velocities(phys, dt);
+		_find_contacts(phys, dt);
+		_solve(phys);
+		_integrate_positions(phys, dt);
+		_sleep_islands(phys, dt);
+	}
+}
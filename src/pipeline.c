@@ -0,0 +1,259 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "v2d.h"
+#include "collide_internal.h"
+
+// The smallest size of the pair index. Must be a power of two
+#define INDEX_MIN 64
+
+// Below this many narrow-phase tests, waking the thread pool costs more than it saves
+#define PARALLEL_MIN 256
+
+void v2d_pipeline_init(v2d_pipeline_t *pl, v2d_broad_t *broad) {
+	*pl = (v2d_pipeline_t){.broad = broad};
+}
+
+void v2d_pipeline_destroy(v2d_pipeline_t *pl) {
+	v2d_free(pl->candidates);
+	v2d_free(pl->work);
+	v2d_free(pl->tests);
+	v2d_free(pl->pairs);
+	v2d_free(pl->index);
+	v2d_free(pl->seen);
+	v2d_free(pl->events);
+	*pl = (v2d_pipeline_t){0};
+}
+
+void v2d_pipeline_set_static(v2d_pipeline_t *pl, const v2d_static_t *statics) {
+	pl->statics = statics;
+
+	// The new index's shapes may have the same IDs as the old one's, so any cached results are no good
+	for (size_t i = 0; i < pl->n_pairs; i++) {
+		if (pl->pairs[i].pair.b & V2D_PIPELINE_STATIC) pl->pairs[i].tested = 0;
+	}
+}
+
+// --- Pair index ---
+// Open addressing with linear probing. Slots hold an index into `pairs` plus one, so that zero means empty
+
+static size_t _hash_pair(v2d_pair_t p) {
+	uint64_t key = (uint64_t)p.a << 32 | p.b;
+	return (size_t)(key * UINT64_C(11400714819323198485) >> 32);
+}
+
+static uint32_t *_index_find(const v2d_pipeline_t *pl, v2d_pair_t p) {
+	size_t mask = pl->cap_index - 1;
+	for (size_t i = _hash_pair(p) & mask;; i = (i + 1) & mask) {
+		uint32_t *slot = pl->index + i;
+		if (!*slot) return slot;
+		v2d_pair_t q = pl->pairs[*slot - 1].pair;
+		if (q.a == p.a && q.b == p.b) return slot;
+	}
+}
+
+// Rebuild the index to hold every pair, with room for `extra` more
+static bool _index_rebuild(v2d_pipeline_t *pl, size_t extra) {
+	// Keep the load factor at or below 1/2
+	size_t cap = pl->cap_index ? pl->cap_index : INDEX_MIN;
+	while (cap < 2 * (pl->n_pairs + extra)) cap *= 2;
+	if (cap != pl->cap_index) {
+		uint32_t *index = v2d_alloc(cap * sizeof *index);
+		if (!index) return false;
+		v2d_free(pl->index);
+		pl->index = index;
+		pl->cap_index = cap;
+	}
+
+	memset(pl->index, 0, pl->cap_index * sizeof *pl->index);
+	for (size_t i = 0; i < pl->n_pairs; i++) {
+		*_index_find(pl, pl->pairs[i].pair) = i + 1;
+	}
+	return true;
+}
+
+// --- Stepping ---
+
+// Static colliders never move, so their stamp is always the oldest possible
+static uint32_t _moved(const v2d_pipeline_t *pl, uint32_t id) {
+	return id & V2D_PIPELINE_STATIC ? 0 : pl->broad->proxies[id].moved;
+}
+
+// The broad phase doesn't report pairs where neither proxy is active, such as two sleeping objects
+// If neither has been deleted or moved since the pair was last tested, they're still exactly as they were
+static bool _resting(const v2d_pipeline_t *pl, const struct v2d_pipeline_pair *p) {
+	uint32_t ids[2] = {p->pair.a, p->pair.b};
+	for (int i = 0; i < 2; i++) {
+		if (ids[i] & V2D_PIPELINE_STATIC) continue;
+		if (ids[i] >= pl->broad->n_proxies) return false;
+		const struct v2d_broad_proxy *proxy = pl->broad->proxies + ids[i];
+		if (!proxy->alive || proxy->active || proxy->moved > p->tested) return false;
+	}
+	if (!p->tested) return false;
+
+	// Filters can change without the proxy moving
+	v2d_filter_t fb = p->pair.b & V2D_PIPELINE_STATIC ? pl->statics->filters[p->pair.b & ~V2D_PIPELINE_STATIC] : pl->broad->proxies[p->pair.b].filter;
+	return v2d_filter_pair(pl->broad->proxies[p->pair.a].filter, fb);
+}
+
+static v2d_shape_t _shape(const v2d_pipeline_t *pl, uint32_t id) {
+	return id & V2D_PIPELINE_STATIC ? pl->statics->shapes[id & ~V2D_PIPELINE_STATIC] : pl->broad->proxies[id].shape;
+}
+
+struct _static_ctx {
+	v2d_pipeline_t *pl;
+	uint32_t proxy;
+	bool ok;
+};
+
+static bool _add_static(const v2d_static_t *index, uint32_t id, void *ctx) {
+	struct _static_ctx *c = ctx;
+	v2d_pipeline_t *pl = c->pl;
+	if (!v2d_filter_pair(pl->broad->proxies[c->proxy].filter, index->filters[id])) return true;
+
+	c->ok = v2d_array_reserve(&pl->candidates, &pl->cap_candidates, sizeof *pl->candidates, pl->n_candidates + 1);
+	if (c->ok) pl->candidates[pl->n_candidates++] = (v2d_pair_t){c->proxy, id | V2D_PIPELINE_STATIC};
+	return c->ok;
+}
+
+// Gather the pairs found by the broad phase, plus every active proxy's pairs with static colliders
+static bool _find_candidates(v2d_pipeline_t *pl) {
+	v2d_broad_t *broad = pl->broad;
+	size_t n;
+	v2d_pair_t *found = v2d_broad_pairs(broad, &n);
+
+	pl->n_candidates = 0;
+	if (!v2d_array_reserve(&pl->candidates, &pl->cap_candidates, sizeof *pl->candidates, n)) return false;
+	if (n) memcpy(pl->candidates, found, n * sizeof *found);
+	pl->n_candidates = n;
+
+	if (!pl->statics) return true;
+	for (uint32_t id = 0; id < broad->n_proxies; id++) {
+		const struct v2d_broad_proxy *p = broad->proxies + id;
+		if (!p->alive || !p->active) continue;
+
+		struct _static_ctx c = {pl, id, true};
+		v2d_static_visit(pl->statics, p->min, p->max, NULL, _add_static, &c);
+		if (!c.ok) return false;
+	}
+	return true;
+}
+
+static bool _add_event(v2d_pipeline_t *pl, int type, v2d_pair_t pair, v2d_contact_t contact) {
+	if (!v2d_array_reserve(&pl->events, &pl->cap_events, sizeof *pl->events, pl->n_events + 1)) return false;
+	pl->events[pl->n_events++] = (struct v2d_collision_event){type, pair, contact};
+	return true;
+}
+
+struct _narrow {
+	v2d_pipeline_t *pl;
+	uint32_t stamp;
+};
+
+// Each test writes only to its own pair, so the results don't depend on how the tests are split between threads
+static void _narrow_job(void *ctx, size_t begin, size_t end, unsigned worker) {
+	const struct _narrow *job = ctx;
+	v2d_pipeline_t *pl = job->pl;
+	for (size_t i = begin; i < end; i++) {
+		struct v2d_pipeline_pair *p = pl->pairs + pl->tests[i];
+		p->touching = v2d_contact_shape_shape_uncounted(_shape(pl, p->pair.a), _shape(pl, p->pair.b), &p->contact);
+		p->tested = job->stamp;
+	}
+}
+
+static bool _step(v2d_pipeline_t *pl, v2d_jobs_t *jobs) {
+	uint32_t stamp = pl->broad->stamp;
+	pl->n_events = pl->n_tested = pl->n_skipped = 0;
+
+	if (!_find_candidates(pl)) return false;
+	size_t n = pl->n_candidates;
+	const v2d_pair_t *found = pl->candidates;
+
+	// Make room for every pair to be new, so nothing can fail part way through
+	size_t max_pairs = pl->n_pairs + n;
+	if (max_pairs >= UINT32_MAX) return false;
+	if (!v2d_array_reserve(&pl->pairs, &pl->cap_pairs, sizeof *pl->pairs, max_pairs)) return false;
+	if (!v2d_array_reserve(&pl->seen, &pl->cap_seen, sizeof *pl->seen, max_pairs)) return false;
+	if (!v2d_array_reserve(&pl->work, &pl->cap_work, sizeof *pl->work, n)) return false;
+	if (!v2d_array_reserve(&pl->tests, &pl->cap_tests, sizeof *pl->tests, n)) return false;
+	if (!_index_rebuild(pl, n)) return false;
+	memset(pl->seen, 0, max_pairs * sizeof *pl->seen);
+
+	for (size_t i = 0; i < n; i++) {
+		uint32_t *slot = _index_find(pl, found[i]);
+		if (!*slot) {
+			pl->pairs[pl->n_pairs] = (struct v2d_pipeline_pair){.pair = found[i]};
+			*slot = ++pl->n_pairs;
+		}
+		struct v2d_pipeline_pair *p = pl->pairs + *slot - 1;
+		pl->seen[*slot - 1] = true;
+		pl->work[i] = *slot - 1;
+
+		// If neither proxy has moved since the last test, the result is still valid
+		p->was_touching = p->touching;
+		if (p->tested && _moved(pl, p->pair.a) <= p->tested && _moved(pl, p->pair.b) <= p->tested) {
+			pl->n_skipped++;
+		} else {
+			pl->tests[pl->n_tested++] = *slot - 1;
+		}
+	}
+
+	struct _narrow job = {pl, stamp};
+	v2d_jobs_parallel_for(pl->n_tested < PARALLEL_MIN ? NULL : jobs, pl->n_tested, 0, _narrow_job, &job);
+
+	// The job functions can't touch the stats, so count their tests here
+	v2d_stat_add(pairs_tested, pl->n_tested);
+	for (size_t i = 0; i < pl->n_tested; i++) {
+		v2d_stat_add(pairs_hit, pl->pairs[pl->tests[i]].touching);
+	}
+
+	// Produce the events in candidate order, the same as if the tests had run one by one
+	for (size_t i = 0; i < n; i++) {
+		struct v2d_pipeline_pair *p = pl->pairs + pl->work[i];
+		bool was_touching = p->was_touching;
+		if (p->touching) {
+			if (!_add_event(pl, was_touching ? V2D_COLLISION_STAY : V2D_COLLISION_BEGIN, p->pair, p->contact)) return false;
+		} else if (was_touching) {
+			if (!_add_event(pl, V2D_COLLISION_END, p->pair, (v2d_contact_t){0})) return false;
+		}
+	}
+
+	// Forget pairs that no longer overlap, ending any that were touching
+	// Resting pairs weren't found, but they still overlap, so they're kept and carry on touching
+	size_t kept = 0;
+	for (size_t i = 0; i < pl->n_pairs; i++) {
+		struct v2d_pipeline_pair *p = pl->pairs + i;
+		if (pl->seen[i]) {
+			pl->pairs[kept++] = *p;
+		} else if (_resting(pl, p)) {
+			p->was_touching = p->touching;
+			pl->n_skipped++;
+			if (p->touching && !_add_event(pl, V2D_COLLISION_STAY, p->pair, p->contact)) return false;
+			pl->pairs[kept++] = *p;
+		} else if (p->touching) {
+			if (!_add_event(pl, V2D_COLLISION_END, p->pair, (v2d_contact_t){0})) return false;
+		}
+	}
+	pl->n_pairs = kept;
+
+	return _index_rebuild(pl, 0);
+}
+
+const struct v2d_collision_event *v2d_pipeline_step(v2d_pipeline_t *pl, size_t *n_events) {
+	return v2d_pipeline_step_parallel(pl, NULL, n_events);
+}
+
+const struct v2d_collision_event *v2d_pipeline_step_parallel(v2d_pipeline_t *pl, v2d_jobs_t *jobs, size_t *n_events) {
+	bool ok = false;
+	v2d_prof_zone("pipeline") ok = _step(pl, jobs);
+
+	if (!ok) {
+		// The pair set may be half updated, so start again from nothing
+		pl->n_pairs = pl->n_events = 0;
+		*n_events = 0;
+		return NULL;
+	}
+
+	*n_events = pl->n_events;
+	return pl->events;
+}
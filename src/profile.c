@@ -0,0 +1,147 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <SDL.h>
+#include "v2d/profile.h"
+
+#ifdef V2D_PROFILE
+
+#if V2D_PROFILE_RING_SIZE & (V2D_PROFILE_RING_SIZE - 1)
+#error "V2D_PROFILE_RING_SIZE must be a power of two"
+#endif
+
+#define RING_MASK (V2D_PROFILE_RING_SIZE - 1)
+
+struct _zone {
+	const char *name;
+	uint64_t start, end;
+};
+
+// Each ring is written by exactly one thread and only read during export
+struct _ring {
+	struct _zone zones[V2D_PROFILE_RING_SIZE];
+	SDL_atomic_t head;
+	SDL_threadID tid;
+	struct _ring *next;
+};
+
+// All rings ever created, as a lock-free singly-linked list
+static struct _ring *_rings = NULL;
+
+// 0 = uninitialized, 1 = initializing, 2 = initialized
+static SDL_atomic_t _init_state = {0};
+static SDL_TLSID _ring_tls;
+
+static void _init(void) {
+	if (SDL_AtomicGet(&_init_state) == 2) return;
+
+	if (SDL_AtomicCAS(&_init_state, 0, 1)) {
+		_ring_tls = SDL_TLSCreate();
+		SDL_AtomicSet(&_init_state, 2);
+	} else {
+		// Another thread got here first; wait for it to finish
+		while (SDL_AtomicGet(&_init_state) != 2);
+	}
+}
+
+static struct _ring *_get_ring(void) {
+	_init();
+
+	struct _ring *ring = SDL_TLSGet(_ring_tls);
+	if (ring) return ring;
+
+	ring = calloc(1, sizeof *ring);
+	if (!ring) return NULL;
+	ring->tid = SDL_ThreadID();
+
+	// Push the new ring onto the global list
+	do {
+		ring->next = SDL_AtomicGetPtr((void **)&_rings);
+	} while (!SDL_AtomicCASPtr((void **)&_rings, ring->next, ring));
+
+	// The ring is never freed, so that zones from exited threads can still be exported
+	SDL_TLSSet(_ring_tls, ring, NULL);
+	return ring;
+}
+
+uint64_t v2d_prof_now(void) {
+	return SDL_GetPerformanceCounter();
+}
+
+void v2d_prof_record(const char *name, uint64_t start, uint64_t end) {
+	struct _ring *ring = _get_ring();
+	if (!ring) return;
+
+	unsigned head = SDL_AtomicGet(&ring->head);
+	ring->zones[head & RING_MASK] = (struct _zone){name, start, end};
+
+	// Once the ring has filled, the head stays between one and two ring sizes, so it can't overflow
+	// The exporter only needs to know where the head is in the ring and whether the ring is full
+	unsigned next = head + 1;
+	if (next == 2 * V2D_PROFILE_RING_SIZE) next = V2D_PROFILE_RING_SIZE;
+
+	// Make sure the zone is written before the exporter can see the new head
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&ring->head, next);
+}
+
+void v2d_prof_clear(void) {
+	for (struct _ring *ring = SDL_AtomicGetPtr((void **)&_rings); ring; ring = ring->next) {
+		SDL_AtomicSet(&ring->head, 0);
+	}
+}
+
+// Write a JSON string, escaping anything that needs it
+static void _write_string(FILE *f, const char *s) {
+	fputc('"', f);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') fputc('\\', f);
+		if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", *s);
+		else fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+bool v2d_prof_export(const char *path) {
+	FILE *f = fopen(path, "w");
+	if (!f) return false;
+
+	struct _ring *rings = SDL_AtomicGetPtr((void **)&_rings);
+
+	// Timestamps are written relative to the earliest recorded zone
+	uint64_t base = UINT64_MAX;
+	for (struct _ring *ring = rings; ring; ring = ring->next) {
+		unsigned head = SDL_AtomicGet(&ring->head);
+		SDL_MemoryBarrierAcquire();
+		unsigned i = head > V2D_PROFILE_RING_SIZE ? head - V2D_PROFILE_RING_SIZE : 0;
+		for (; i != head; i++) {
+			if (ring->zones[i & RING_MASK].start < base) base = ring->zones[i & RING_MASK].start;
+		}
+	}
+
+	// Chrome wants microseconds
+	double scale = 1e6 / SDL_GetPerformanceFrequency();
+	bool first = true;
+
+	fputs("{\"traceEvents\":[", f);
+	for (struct _ring *ring = rings; ring; ring = ring->next) {
+		unsigned head = SDL_AtomicGet(&ring->head);
+		SDL_MemoryBarrierAcquire();
+		unsigned i = head > V2D_PROFILE_RING_SIZE ? head - V2D_PROFILE_RING_SIZE : 0;
+		for (; i != head; i++) {
+			struct _zone z = ring->zones[i & RING_MASK];
+			if (!first) fputc(',', f);
+			first = false;
+
+			fputs("\n{\"name\":", f);
+			_write_string(f, z.name);
+			fprintf(f, ",\"cat\":\"v2d\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+				(unsigned long)ring->tid, (z.start - base) * scale, (z.end - z.start) * scale);
+		}
+	}
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+
+	return fclose(f) == 0;
+}
+
+#endif
@@ -1,17 +1,31 @@
 #include <complex.h>
+#include <math.h>
 #include <stdbool.h>
 #include <SDL.h>
 #include "v2d/render.h"
+#include "v2d/stats.h"
 
 v2d_render_t *v2d_render_new(SDL_Window *sdl_win) {
-	SDL_Renderer *ren = SDL_CreateRenderer(sdl_win, -1, 0);
+	return v2d_render_new_flags(sdl_win, 0);
+}
+
+v2d_render_t *v2d_render_new_flags(SDL_Window *sdl_win, Uint32 flags) {
+	SDL_Renderer *ren = SDL_CreateRenderer(sdl_win, -1, flags);
 	if (!ren) {
 		v2d_raise_error(V2D_ERROR_SDL, SDL_GetError());
 		return NULL;
 	}
 
-	v2d_render_t *render = malloc(sizeof *render);
+	v2d_render_t *render = v2d_alloc(sizeof *render);
+	if (!render) {
+		SDL_DestroyRenderer(ren);
+		return NULL;
+	}
 	render->sdl_ren = ren;
+	render->damage = NULL;
+
+	SDL_RendererInfo info;
+	render->vsync = SDL_GetRendererInfo(ren, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC);
 
 	render->camera_tr = v2d_transform_new();
 	render->screen_tr = v2d_transform_new();
@@ -26,8 +40,9 @@ v2d_render_t *v2d_render_new(SDL_Window *sdl_win) {
 
 void v2d_render_free(v2d_render_t *render) {
 	if (!render) return;
+	v2d_render_track_damage(render, false);
 	SDL_DestroyRenderer(render->sdl_ren);
-	free(render);
+	v2d_free(render);
 }
 
 v2d_vec_t v2d_render_screen_pos(v2d_render_t *render, v2d_vec_t v) {
@@ -49,77 +64,179 @@ v2d_transform_t v2d_render_transform(v2d_render_t *render) {
 	return v2d_tr_compose(cam, scr);
 }
 
+// --- Draw calls ---
+// Every draw call becomes a command, which is run straight away, or recorded if the renderer is tracking damage
+
+// Midpoint circle algorithm stolen from https://en.wikipedia.org/wiki/Midpoint_circle_algorithm#C_example
+static void _draw_circle(SDL_Renderer *ren, int x0, int y0, double rad) {
+	int x = rad - 1;
+	int y = 0;
+	int dx = 1;
+	int dy = 1;
+	int diam = rad*2;
+	int err = dx - diam;
+
+	while (x >= y) {
+		v2d_stat_add(sdl_calls, 8);
+		SDL_RenderDrawPoint(ren, x0 + x, y0 + y);
+		SDL_RenderDrawPoint(ren, x0 + y, y0 + x);
+		SDL_RenderDrawPoint(ren, x0 - y, y0 + x);
+		SDL_RenderDrawPoint(ren, x0 - x, y0 + y);
+		SDL_RenderDrawPoint(ren, x0 - x, y0 - y);
+		SDL_RenderDrawPoint(ren, x0 - y, y0 - x);
+		SDL_RenderDrawPoint(ren, x0 + y, y0 - x);
+		SDL_RenderDrawPoint(ren, x0 + x, y0 - y);
+
+		if (err <= 0) {
+			y++;
+			err += dy;
+			dy += 2;
+		} else {
+			x--;
+			dx += 2;
+			err += dx - diam;
+		}
+	}
+}
+
+// Run a command. `points` is only needed for V2D_RENDER_CMD_POINTS
+static void _exec(SDL_Renderer *ren, const struct v2d_render_cmd *cmd, const SDL_FPoint *points) {
+	switch (cmd->type) {
+	case V2D_RENDER_CMD_CLEAR:
+		SDL_RenderClear(ren);
+		break;
+	case V2D_RENDER_CMD_RECT:
+		SDL_RenderDrawRect(ren, &cmd->c.rect);
+		break;
+	case V2D_RENDER_CMD_FILL_RECT:
+		SDL_RenderFillRect(ren, &cmd->c.rect);
+		break;
+	case V2D_RENDER_CMD_LINE:
+		SDL_RenderDrawLine(ren, cmd->c.line.x1, cmd->c.line.y1, cmd->c.line.x2, cmd->c.line.y2);
+		break;
+	case V2D_RENDER_CMD_CIRCLE:
+		_draw_circle(ren, cmd->c.circle.x, cmd->c.circle.y, cmd->c.circle.rad);
+		return;
+	case V2D_RENDER_CMD_POINTS:
+		SDL_RenderDrawPointsF(ren, points + cmd->c.points.first, cmd->c.points.count);
+		break;
+	case V2D_RENDER_CMD_TEXTURE:
+		SDL_RenderCopy(ren, cmd->c.texture.tex, cmd->c.texture.has_src ? &cmd->c.texture.src : NULL, &cmd->c.texture.dst);
+		break;
+	}
+	v2d_stat_add(sdl_calls, 1);
+}
+
+// Stop tracking damage after running out of memory, drawing what was recorded so the frame is still complete
+static void _abandon_damage(v2d_render_t *render) {
+	struct v2d_render_damage *d = render->damage;
+	SDL_Color current = d->color;
+	for (size_t i = 0; i < d->n_cmds; i++) {
+		SDL_Color c = d->cmds[i].color;
+		SDL_SetRenderDrawColor(render->sdl_ren, c.r, c.g, c.b, c.a);
+		_exec(render->sdl_ren, d->cmds + i, d->points);
+	}
+	SDL_SetRenderDrawColor(render->sdl_ren, current.r, current.g, current.b, current.a);
+	v2d_render_track_damage(render, false);
+}
+
+static void _submit(v2d_render_t *render, struct v2d_render_cmd cmd) {
+	v2d_stat_add(draw_calls, 1);
+
+	struct v2d_render_damage *d = render->damage;
+	if (d) {
+		if (v2d_array_reserve(&d->cmds, &d->cap_cmds, sizeof *d->cmds, d->n_cmds + 1)) {
+			cmd.color = d->color;
+			d->cmds[d->n_cmds++] = cmd;
+			return;
+		}
+		_abandon_damage(render);
+	}
+	_exec(render->sdl_ren, &cmd, NULL);
+}
+
+// Grow a rect by a pixel on every side, to allow for rounding
+static SDL_Rect _pad(SDL_Rect r) {
+	return (SDL_Rect){r.x - 1, r.y - 1, r.w + 2, r.h + 2};
+}
+
 void v2d_render_rgb(v2d_render_t *render, double r, double g, double b) {
-	SDL_SetRenderDrawColor(render->sdl_ren, 255*r, 255*g, 255*b, 255);
+	v2d_render_rgba(render, r, g, b, 1);
 }
 
 void v2d_render_rgba(v2d_render_t *render, double r, double g, double b, double a) {
 	SDL_SetRenderDrawColor(render->sdl_ren, 255*r, 255*g, 255*b, 255*a);
+	if (render->damage) render->damage->color = (SDL_Color){255*r, 255*g, 255*b, 255*a};
+	v2d_stat_add(sdl_calls, 1);
 }
 
 void v2d_render_clear(v2d_render_t *render) {
-	SDL_RenderClear(render->sdl_ren);
+	struct v2d_render_cmd cmd = {.type = V2D_RENDER_CMD_CLEAR};
+	if (render->damage) {
+		SDL_GetRendererOutputSize(render->sdl_ren, &cmd.bounds.w, &cmd.bounds.h);
+		v2d_stat_add(sdl_calls, 1);
+	}
+	_submit(render, cmd);
 }
 
-void v2d_render_flip(v2d_render_t *render) {
-	SDL_RenderPresent(render->sdl_ren);
+void v2d_render_draw_rect(v2d_render_t *render, v2d_vec_t pos, v2d_vec_t size) {
+	v2d_vec_t screen_pos = v2d_render_screen_pos(render, pos);
+	v2d_vec_t screen_size = v2d_render_screen_size(render, size);
+	SDL_Rect r = {
+		v2d_vec_xy(screen_pos),
+		v2d_vec_xy(screen_size),
+	};
+
+	SDL_Rect bounds = r;
+	v2d_render_util_fix_rect(&bounds);
+	_submit(render, (struct v2d_render_cmd){.type = V2D_RENDER_CMD_RECT, .bounds = _pad(bounds), .c.rect = r});
 }
 
-void v2d_render_draw_rect(v2d_render_t *render, v2d_vec_t pos, v2d_vec_t size) {
+void v2d_render_fill_rect(v2d_render_t *render, v2d_vec_t pos, v2d_vec_t size) {
 	v2d_vec_t screen_pos = v2d_render_screen_pos(render, pos);
 	v2d_vec_t screen_size = v2d_render_screen_size(render, size);
 	SDL_Rect r = {
 		v2d_vec_xy(screen_pos),
 		v2d_vec_xy(screen_size),
 	};
-	SDL_RenderDrawRect(render->sdl_ren, &r);
+	v2d_render_util_fix_rect(&r);
+	_submit(render, (struct v2d_render_cmd){.type = V2D_RENDER_CMD_FILL_RECT, .bounds = _pad(r), .c.rect = r});
 }
 
 void v2d_render_draw_pixel(v2d_render_t *render, v2d_vec_t pos) {
 	pos = v2d_render_screen_pos(render, pos);
-	SDL_RenderDrawPoint(render->sdl_ren, v2d_vec_xy(pos));
+	SDL_Rect r = {v2d_vec_xy(pos), 1, 1};
+	_submit(render, (struct v2d_render_cmd){.type = V2D_RENDER_CMD_FILL_RECT, .bounds = _pad(r), .c.rect = r});
 }
 
 void v2d_render_draw_line(v2d_render_t *render, v2d_vec_t pos, v2d_vec_t dir) {
 	pos = v2d_render_screen_pos(render, pos);
 	dir = v2d_render_screen_size(render, dir);
-	SDL_RenderDrawLine(render->sdl_ren, v2d_vec_xy(pos), v2d_vec_xy(pos + dir));
+
+	struct v2d_render_cmd cmd = {.type = V2D_RENDER_CMD_LINE};
+	cmd.c.line.x1 = v2dvx(pos);
+	cmd.c.line.y1 = v2dvy(pos);
+	cmd.c.line.x2 = v2dvx(pos + dir);
+	cmd.c.line.y2 = v2dvy(pos + dir);
+
+	SDL_Rect bounds = {cmd.c.line.x1, cmd.c.line.y1, cmd.c.line.x2 - cmd.c.line.x1, cmd.c.line.y2 - cmd.c.line.y1};
+	v2d_render_util_fix_rect(&bounds);
+	cmd.bounds = _pad(bounds);
+	_submit(render, cmd);
 }
 
-// Midpoint circle algorithm stolen from https://en.wikipedia.org/wiki/Midpoint_circle_algorithm#C_example
 void v2d_render_draw_circle(v2d_render_t *render, v2d_vec_t center, double radius) {
 	v2d_vec_t pos = v2d_render_screen_pos(render, center);
 	double rad = creal(v2d_render_screen_size(render, radius));
 
-	int x0 = v2dvx(pos);
-	int y0 = v2dvy(pos);
-	int x = rad - 1;
-	int y = 0;
-	int dx = 1;
-	int dy = 1;
-	int diam = rad*2;
-	int err = dx - diam;
-
-	while (x >= y) {
-		SDL_RenderDrawPoint(render->sdl_ren, x0 + x, y0 + y);
-		SDL_RenderDrawPoint(render->sdl_ren, x0 + y, y0 + x);
-		SDL_RenderDrawPoint(render->sdl_ren, x0 - y, y0 + x);
-		SDL_RenderDrawPoint(render->sdl_ren, x0 - x, y0 + y);
-		SDL_RenderDrawPoint(render->sdl_ren, x0 - x, y0 - y);
-		SDL_RenderDrawPoint(render->sdl_ren, x0 - y, y0 - x);
-		SDL_RenderDrawPoint(render->sdl_ren, x0 + y, y0 - x);
-		SDL_RenderDrawPoint(render->sdl_ren, x0 + x, y0 - y);
+	struct v2d_render_cmd cmd = {.type = V2D_RENDER_CMD_CIRCLE};
+	cmd.c.circle.x = v2dvx(pos);
+	cmd.c.circle.y = v2dvy(pos);
+	cmd.c.circle.rad = rad;
 
-		if (err <= 0) {
-			y++;
-			err += dy;
-			dy += 2;
-		} else {
-			x--;
-			dx += 2;
-			err += dx - diam;
-		}
-	}
+	int r = fabs(rad) + 1;
+	cmd.bounds = _pad((SDL_Rect){cmd.c.circle.x - r, cmd.c.circle.y - r, 2*r + 1, 2*r + 1});
+	_submit(render, cmd);
 }
 
 void v2d_render_draw_texture(v2d_render_t *render, SDL_Texture *tex, SDL_Rect *srcrect, v2d_vec_t dstpos, v2d_vec_t dstsize) {
@@ -128,8 +245,219 @@ void v2d_render_draw_texture(v2d_render_t *render, SDL_Texture *tex, SDL_Rect *s
 		v2d_vec_xy(v2d_render_screen_size(render, dstsize)),
 	};
 	v2d_render_util_fix_rect(&dstrect);
+	v2d_render_copy(render, tex, srcrect, &dstrect);
+}
+
+void v2d_render_copy(v2d_render_t *render, SDL_Texture *tex, const SDL_Rect *srcrect, const SDL_Rect *dstrect) {
+	struct v2d_render_cmd cmd = {.type = V2D_RENDER_CMD_TEXTURE};
+	cmd.c.texture.tex = tex;
+	cmd.c.texture.has_src = srcrect != NULL;
+	if (srcrect) cmd.c.texture.src = *srcrect;
+
+	if (dstrect) {
+		cmd.c.texture.dst = *dstrect;
+	} else {
+		SDL_GetRendererOutputSize(render->sdl_ren, &cmd.c.texture.dst.w, &cmd.c.texture.dst.h);
+		v2d_stat_add(sdl_calls, 1);
+	}
+	cmd.bounds = _pad(cmd.c.texture.dst);
+	_submit(render, cmd);
+}
+
+void v2d_render_draw_points(v2d_render_t *render, const SDL_FPoint *points, size_t n) {
+	struct v2d_render_damage *d = render->damage;
+	if (!d) {
+		SDL_RenderDrawPointsF(render->sdl_ren, points, n);
+		v2d_stat_add(draw_calls, 1);
+		v2d_stat_add(sdl_calls, 1);
+		return;
+	}
+
+	if (!v2d_array_reserve(&d->points, &d->cap_points, sizeof *d->points, d->n_points + n)) {
+		_abandon_damage(render);
+		v2d_render_draw_points(render, points, n);
+		return;
+	}
+
+	struct v2d_render_cmd cmd = {.type = V2D_RENDER_CMD_POINTS};
+	cmd.c.points.first = d->n_points;
+	cmd.c.points.count = n;
+
+	float minx = INFINITY, miny = INFINITY, maxx = -INFINITY, maxy = -INFINITY;
+	for (size_t i = 0; i < n; i++) {
+		d->points[d->n_points++] = points[i];
+		minx = fminf(minx, points[i].x);
+		miny = fminf(miny, points[i].y);
+		maxx = fmaxf(maxx, points[i].x);
+		maxy = fmaxf(maxy, points[i].y);
+	}
+	if (n) cmd.bounds = _pad((SDL_Rect){floorf(minx), floorf(miny), ceilf(maxx - floorf(minx)) + 1, ceilf(maxy - floorf(miny)) + 1});
+	_submit(render, cmd);
+}
+
+// --- Damage tracking ---
+
+bool v2d_render_track_damage(v2d_render_t *render, bool enabled) {
+	struct v2d_render_damage *d = render->damage;
+	if (enabled == (d != NULL)) return true;
+
+	if (!enabled) {
+		v2d_free(d->cmds);
+		v2d_free(d->prev);
+		v2d_free(d->points);
+		if (d->target) SDL_DestroyTexture(d->target);
+		v2d_free(d);
+		render->damage = NULL;
+		return true;
+	}
+
+	d = v2d_alloc(sizeof *d);
+	if (!d) return false;
+	*d = (struct v2d_render_damage){0};
+	SDL_GetRenderDrawColor(render->sdl_ren, &d->color.r, &d->color.g, &d->color.b, &d->color.a);
+	v2d_stat_add(sdl_calls, 1);
+	render->damage = d;
+	return true;
+}
+
+static void _union(SDL_Rect *dirty, bool *damaged, SDL_Rect r) {
+	if (*damaged) SDL_UnionRect(dirty, &r, dirty);
+	else *dirty = r;
+	*damaged = true;
+}
+
+void v2d_render_damage(v2d_render_t *render, const SDL_Rect *rect) {
+	struct v2d_render_damage *d = render->damage;
+	if (!d) return;
 
-	SDL_RenderCopy(render->sdl_ren, tex, srcrect, &dstrect);
+	// The whole screen is as big as any rect can usefully be, and it's clipped to the screen in the flip anyway
+	SDL_Rect r = rect ? *rect : (SDL_Rect){0, 0, SDL_MAX_SINT32 / 2, SDL_MAX_SINT32 / 2};
+	_union(&d->marked, &d->has_marked, r);
+}
+
+static bool _rect_eq(SDL_Rect a, SDL_Rect b) {
+	return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+// Return true if two commands draw exactly the same thing
+static bool _same(const struct v2d_render_cmd *a, const struct v2d_render_cmd *b) {
+	if (a->type != b->type || !_rect_eq(a->bounds, b->bounds)) return false;
+	if (a->color.r != b->color.r || a->color.g != b->color.g || a->color.b != b->color.b || a->color.a != b->color.a) return false;
+
+	switch (a->type) {
+	case V2D_RENDER_CMD_CLEAR:
+		return true;
+	case V2D_RENDER_CMD_RECT:
+	case V2D_RENDER_CMD_FILL_RECT:
+		return _rect_eq(a->c.rect, b->c.rect);
+	case V2D_RENDER_CMD_LINE:
+		return a->c.line.x1 == b->c.line.x1 && a->c.line.y1 == b->c.line.y1
+			&& a->c.line.x2 == b->c.line.x2 && a->c.line.y2 == b->c.line.y2;
+	case V2D_RENDER_CMD_CIRCLE:
+		return a->c.circle.x == b->c.circle.x && a->c.circle.y == b->c.circle.y && a->c.circle.rad == b->c.circle.rad;
+	case V2D_RENDER_CMD_POINTS:
+		// Comparing every point would cost as much as drawing them
+		return false;
+	case V2D_RENDER_CMD_TEXTURE:
+		return a->c.texture.tex == b->c.texture.tex && _rect_eq(a->c.texture.dst, b->c.texture.dst)
+			&& a->c.texture.has_src == b->c.texture.has_src && (!a->c.texture.has_src || _rect_eq(a->c.texture.src, b->c.texture.src));
+	}
+	return false;
+}
+
+// Run the recorded commands that touch `clip`, or all of them if it is NULL
+static void _replay(v2d_render_t *render, const SDL_Rect *clip) {
+	struct v2d_render_damage *d = render->damage;
+	SDL_Renderer *ren = render->sdl_ren;
+
+	for (size_t i = 0; i < d->n_cmds; i++) {
+		const struct v2d_render_cmd *cmd = d->cmds + i;
+		if (clip && !SDL_HasIntersection(&cmd->bounds, clip)) continue;
+
+		SDL_SetRenderDrawColor(ren, cmd->color.r, cmd->color.g, cmd->color.b, cmd->color.a);
+		v2d_stat_add(sdl_calls, 1);
+
+		// Clearing ignores the clip rect, so only fill the part being redrawn
+		if (clip && cmd->type == V2D_RENDER_CMD_CLEAR) {
+			SDL_RenderFillRect(ren, clip);
+			v2d_stat_add(sdl_calls, 1);
+		} else {
+			_exec(ren, cmd, d->points);
+		}
+	}
+	SDL_SetRenderDrawColor(ren, d->color.r, d->color.g, d->color.b, d->color.a);
+	v2d_stat_add(sdl_calls, 1);
+}
+
+static void _flip_damaged(v2d_render_t *render) {
+	struct v2d_render_damage *d = render->damage;
+	SDL_Renderer *ren = render->sdl_ren;
+
+	int w, h;
+	SDL_GetRendererOutputSize(ren, &w, &h);
+	SDL_Rect screen = {0, 0, w, h};
+	SDL_Rect dirty = d->marked;
+	bool damaged = d->has_marked;
+
+	// The texture holding the last frame must match the screen, and a new one holds nothing yet
+	if (!d->target || d->w != w || d->h != h) {
+		if (d->target) SDL_DestroyTexture(d->target);
+		d->target = NULL;
+		if (SDL_RenderTargetSupported(ren)) {
+			d->target = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+		}
+		d->w = w;
+		d->h = h;
+		_union(&dirty, &damaged, screen);
+	}
+
+	// Anything drawn differently from last frame is damaged, both where it was and where it is now
+	size_t n = d->n_cmds > d->n_prev ? d->n_cmds : d->n_prev;
+	for (size_t i = 0; i < n; i++) {
+		const struct v2d_render_cmd *cur = i < d->n_cmds ? d->cmds + i : NULL;
+		const struct v2d_render_cmd *old = i < d->n_prev ? d->prev + i : NULL;
+		if (cur && old && _same(cur, old)) continue;
+		if (cur) _union(&dirty, &damaged, cur->bounds);
+		if (old) _union(&dirty, &damaged, old->bounds);
+	}
+
+	if (damaged && SDL_IntersectRect(&dirty, &screen, &dirty)) {
+		if (d->target) {
+			SDL_SetRenderTarget(ren, d->target);
+			SDL_RenderSetClipRect(ren, &dirty);
+			_replay(render, &dirty);
+			SDL_RenderSetClipRect(ren, NULL);
+			SDL_SetRenderTarget(ren, NULL);
+			SDL_RenderCopy(ren, d->target, NULL, NULL);
+			v2d_stat_add(sdl_calls, 5);
+		} else {
+			// There's nowhere to keep the last frame, so the whole of this one has to be drawn
+			_replay(render, NULL);
+		}
+		SDL_RenderPresent(ren);
+		v2d_stat_add(sdl_calls, 1);
+	}
+
+	// This frame becomes the one the next is compared with
+	struct v2d_render_cmd *cmds = d->prev;
+	size_t cap = d->cap_prev;
+	d->prev = d->cmds;
+	d->cap_prev = d->cap_cmds;
+	d->n_prev = d->n_cmds;
+	d->cmds = cmds;
+	d->cap_cmds = cap;
+	d->n_cmds = 0;
+	d->n_points = 0;
+	d->has_marked = false;
+}
+
+void v2d_render_flip(v2d_render_t *render) {
+	if (render->damage) {
+		_flip_damaged(render);
+		return;
+	}
+	SDL_RenderPresent(render->sdl_ren);
+	v2d_stat_add(sdl_calls, 1);
 }
 
 void v2d_render_util_fix_rect(SDL_Rect *rect) {
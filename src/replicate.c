@@ -0,0 +1,717 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "v2d.h"
+
+#define SLOT_BITS 24
+#define SLOT_MASK ((1u << SLOT_BITS) - 1)
+#define MAX_SLOTS SLOT_MASK
+
+// Bit streams, written and read least significant bit first
+
+struct _bits {
+	unsigned char *data;
+	size_t cap; // In bytes
+	size_t bit;
+	bool overflow;
+};
+
+static void _put(struct _bits *b, uint32_t v, int n) {
+	while (n > 0) {
+		size_t byte = b->bit / 8;
+		int off = b->bit % 8, take = 8 - off < n ? 8 - off : n;
+		if (byte >= b->cap) {
+			b->overflow = true;
+		} else {
+			b->data[byte] |= (v & ((1u << take) - 1)) << off;
+		}
+		v >>= take;
+		n -= take;
+		b->bit += take;
+	}
+}
+
+static uint32_t _get(struct _bits *b, int n) {
+	uint32_t v = 0;
+	int shift = 0;
+	while (n > 0) {
+		size_t byte = b->bit / 8;
+		int off = b->bit % 8, take = 8 - off < n ? 8 - off : n;
+		if (byte >= b->cap) {
+			b->overflow = true;
+			return 0;
+		}
+		v |= (uint32_t)((b->data[byte] >> off) & ((1u << take) - 1)) << shift;
+		shift += take;
+		n -= take;
+		b->bit += take;
+	}
+	return v;
+}
+
+// Small numbers are sent in fewer bits, in groups of 7 with a continuation bit
+static void _put_var(struct _bits *b, uint32_t v) {
+	while (v >= 0x80) {
+		_put(b, (v & 0x7f) | 0x80, 8);
+		v >>= 7;
+	}
+	_put(b, v, 8);
+}
+
+static uint32_t _get_var(struct _bits *b) {
+	uint32_t v = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		uint32_t group = _get(b, 8);
+		v |= (group & 0x7f) << shift;
+		if (!(group & 0x80)) break;
+	}
+	return v;
+}
+
+// Signed numbers are zigzag encoded, so small negative numbers are also small
+static void _put_signed(struct _bits *b, int32_t v) {
+	_put_var(b, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+static int32_t _get_signed(struct _bits *b) {
+	uint32_t v = _get_var(b);
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Views
+
+static bool _obj_equal(const struct v2d_repl_object *a, const struct v2d_repl_object *b) {
+	return a->id == b->id && a->tag == b->tag && a->x == b->x && a->y == b->y && a->n_words == b->n_words
+		&& !memcmp(a->state, b->state, a->n_words * sizeof *a->state);
+}
+
+static struct v2d_repl_object *_view_find(const struct v2d_repl_view *view, size_t n, uint32_t id) {
+	size_t lo = 0, hi = n;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (view->objs[mid].id < id) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo < n && view->objs[lo].id == id ? &view->objs[lo] : NULL;
+}
+
+static int _compare_obj(const void *a, const void *b) {
+	const struct v2d_repl_object *oa = a, *ob = b;
+	return (oa->id > ob->id) - (oa->id < ob->id);
+}
+
+// Marks despawned objects while building a view
+#define DEAD UINT32_MAX
+
+// Build the view resulting from applying entries to a base view
+// The server and client both use this, so they always agree on what the client has
+static bool _build_view(struct v2d_repl_view *dst, const struct v2d_repl_view *base, const struct v2d_repl_entry *entries, size_t n, uint32_t seq) {
+	dst->seq = 0;
+	dst->n = 0;
+	if (!v2d_array_reserve(&dst->objs, &dst->cap, sizeof *dst->objs, base->n + n)) return false;
+	if (base->n) memcpy(dst->objs, base->objs, base->n * sizeof *dst->objs);
+	dst->n = base->n;
+
+	bool spawned = false, despawned = false;
+	for (size_t i = 0; i < n; i++) {
+		struct v2d_repl_object *obj = _view_find(dst, base->n, entries[i].obj.id);
+		switch (entries[i].op) {
+		case V2D_REPL_SPAWN:
+			if (!obj) {
+				obj = &dst->objs[dst->n++];
+				spawned = true;
+			}
+			// fallthrough
+		case V2D_REPL_UPDATE:
+			if (obj) *obj = entries[i].obj;
+			break;
+		case V2D_REPL_DESPAWN:
+			if (obj) {
+				obj->n_words = DEAD;
+				despawned = true;
+			}
+			break;
+		}
+	}
+
+	if (despawned) {
+		size_t j = 0;
+		for (size_t i = 0; i < dst->n; i++) {
+			if (dst->objs[i].n_words != DEAD) dst->objs[j++] = dst->objs[i];
+		}
+		dst->n = j;
+	}
+	if (spawned) qsort(dst->objs, dst->n, sizeof *dst->objs, _compare_obj);
+
+	dst->seq = seq;
+	return true;
+}
+
+static const struct v2d_repl_view _empty_view = {0};
+
+// Return the view for a sequence number, or NULL if it's too old
+static const struct v2d_repl_view *_get_view(const struct v2d_repl_view *views, uint32_t seq, uint32_t newest) {
+	if (!seq) return &_empty_view;
+	if (newest - seq >= V2D_REPL_HISTORY) return NULL;
+	const struct v2d_repl_view *view = &views[seq % V2D_REPL_HISTORY];
+	return view->seq == seq ? view : NULL;
+}
+
+// Entries
+
+static void _write_entry(struct _bits *b, const struct v2d_repl_entry *e, const struct v2d_repl_object *base) {
+	_put_var(b, e->obj.id & SLOT_MASK);
+	_put(b, e->obj.id >> SLOT_BITS, 32 - SLOT_BITS);
+	_put(b, e->op, 2);
+
+	switch (e->op) {
+	case V2D_REPL_SPAWN:
+		_put_var(b, e->obj.tag);
+		_put_signed(b, e->obj.x);
+		_put_signed(b, e->obj.y);
+		_put_var(b, e->obj.n_words);
+		for (uint32_t i = 0; i < e->obj.n_words; i++) {
+			_put(b, e->obj.state[i], 32);
+		}
+		break;
+
+	case V2D_REPL_UPDATE:
+		if (e->obj.x != base->x || e->obj.y != base->y) {
+			_put(b, 1, 1);
+			_put_signed(b, e->obj.x - base->x);
+			_put_signed(b, e->obj.y - base->y);
+		} else {
+			_put(b, 0, 1);
+		}
+
+		// A mask of the changed words, followed by the differences
+		for (uint32_t i = 0; i < e->obj.n_words; i++) {
+			_put(b, e->obj.state[i] != base->state[i], 1);
+		}
+		for (uint32_t i = 0; i < e->obj.n_words; i++) {
+			if (e->obj.state[i] != base->state[i]) _put_signed(b, (int32_t)(e->obj.state[i] - base->state[i]));
+		}
+		break;
+
+	case V2D_REPL_DESPAWN:
+		break;
+	}
+}
+
+static bool _read_entry(struct _bits *b, struct v2d_repl_entry *e, const struct v2d_repl_view *base, uint32_t seq) {
+	uint32_t id = _get_var(b);
+	id |= _get(b, 32 - SLOT_BITS) << SLOT_BITS;
+	e->op = _get(b, 2);
+	e->obj.id = id;
+	e->obj.tick = seq;
+
+	switch (e->op) {
+	case V2D_REPL_SPAWN:
+		e->obj.tag = _get_var(b);
+		e->obj.x = _get_signed(b);
+		e->obj.y = _get_signed(b);
+		e->obj.n_words = _get_var(b);
+		if (e->obj.n_words > V2D_REPL_STATE_WORDS) return false;
+		memset(e->obj.state, 0, sizeof e->obj.state);
+		for (uint32_t i = 0; i < e->obj.n_words; i++) {
+			e->obj.state[i] = _get(b, 32);
+		}
+		break;
+
+	case V2D_REPL_UPDATE:;
+		const struct v2d_repl_object *prev = _view_find(base, base->n, id);
+		if (!prev) return false;
+		e->obj = *prev;
+		e->obj.tick = seq;
+
+		if (_get(b, 1)) {
+			e->obj.x += _get_signed(b);
+			e->obj.y += _get_signed(b);
+		}
+
+		uint32_t mask = 0;
+		for (uint32_t i = 0; i < e->obj.n_words; i++) {
+			mask |= _get(b, 1) << i;
+		}
+		for (uint32_t i = 0; i < e->obj.n_words; i++) {
+			if (mask & (1u << i)) e->obj.state[i] += (uint32_t)_get_signed(b);
+		}
+		break;
+
+	case V2D_REPL_DESPAWN:
+		break;
+
+	default:
+		return false;
+	}
+
+	return !b->overflow;
+}
+
+// Server
+
+v2d_repl_server_t *v2d_repl_server_new(struct v2d_repl_transport *transport, double precision) {
+	v2d_repl_server_t *server = v2d_alloc(sizeof *server);
+	if (!server) return NULL;
+	*server = (v2d_repl_server_t){
+		.transport = transport,
+		.precision = precision,
+		.budget = V2D_REPL_MTU,
+	};
+	v2d_broad_init(&server->broad);
+
+	if (!v2d_array_reserve(&server->packet, &server->cap_packet, 1, server->budget)) {
+		v2d_repl_server_free(server);
+		return NULL;
+	}
+	return server;
+}
+
+static void _free_views(struct v2d_repl_view *views) {
+	for (int i = 0; i < V2D_REPL_HISTORY; i++) {
+		v2d_free(views[i].objs);
+	}
+}
+
+void v2d_repl_server_free(v2d_repl_server_t *server) {
+	for (size_t i = 0; i < server->n_peers; i++) {
+		_free_views(server->peers[i].views);
+	}
+	v2d_free(server->peers);
+	v2d_free(server->types);
+	v2d_free(server->slots);
+	v2d_free(server->state);
+	v2d_free(server->free_slots);
+	v2d_free(server->relevant);
+	v2d_free(server->entries);
+	v2d_free(server->packet);
+	v2d_broad_destroy(&server->broad);
+	v2d_free(server);
+}
+
+bool v2d_repl_register(v2d_repl_server_t *server, const struct v2d_repl_type *type) {
+	if (type->n_words > V2D_REPL_STATE_WORDS) return false;
+
+	for (size_t i = 0; i < server->n_types; i++) {
+		if (server->types[i].tag == type->tag) {
+			server->types[i] = *type;
+			return true;
+		}
+	}
+
+	if (!v2d_array_reserve(&server->types, &server->cap_types, sizeof *server->types, server->n_types + 1)) return false;
+	server->types[server->n_types++] = *type;
+	return true;
+}
+
+uint32_t v2d_repl_track(v2d_repl_server_t *server, v2d_ent_t *ent, uint32_t tag) {
+	uint32_t type = 0;
+	while (type < server->n_types && server->types[type].tag != tag) type++;
+	if (type == server->n_types) return V2D_REPL_ID_NONE;
+
+	uint32_t slot;
+	if (server->n_free) {
+		slot = server->free_slots[--server->n_free];
+	} else {
+		if (server->n_slots >= MAX_SLOTS) return V2D_REPL_ID_NONE;
+		size_t cap = server->cap_slots;
+		if (!v2d_array_reserve(&server->slots, &cap, sizeof *server->slots, server->n_slots + 1)) return V2D_REPL_ID_NONE;
+		if (!v2d_array_reserve(&server->free_slots, &server->cap_free, sizeof *server->free_slots, cap)) return V2D_REPL_ID_NONE;
+		if (!v2d_array_reserve(&server->state, &server->cap_state, sizeof *server->state, cap)) return V2D_REPL_ID_NONE;
+		server->cap_slots = cap;
+		slot = server->n_slots++;
+		server->slots[slot] = (struct v2d_repl_slot){.id = slot};
+	}
+
+	uint32_t proxy = v2d_broad_add(&server->broad, V2D_SHAPE_RECT_LIT(0, 0), (void *)(uintptr_t)slot);
+	if (proxy == V2D_PROXY_NONE) {
+		server->free_slots[server->n_free++] = slot;
+		return V2D_REPL_ID_NONE;
+	}
+
+	// Change the generation in the high bits, so clients never confuse this entity with the slot's previous one
+	struct v2d_repl_slot *s = &server->slots[slot];
+	s->id = (s->id & ~SLOT_MASK) + (1u << SLOT_BITS) + slot;
+	if (s->id == V2D_REPL_ID_NONE) s->id += 1u << SLOT_BITS;
+	s->ent = ent;
+	s->type = type;
+	s->proxy = proxy;
+	s->stamp = 0;
+	return s->id;
+}
+
+void v2d_repl_untrack(v2d_repl_server_t *server, uint32_t id) {
+	uint32_t slot = id & SLOT_MASK;
+	if (slot >= server->n_slots || server->slots[slot].id != id || !server->slots[slot].ent) return;
+
+	v2d_broad_del(&server->broad, server->slots[slot].proxy);
+	server->slots[slot].ent = NULL;
+	server->free_slots[server->n_free++] = slot;
+}
+
+static struct v2d_repl_peer *_find_peer(v2d_repl_server_t *server, uint32_t addr) {
+	for (size_t i = 0; i < server->n_peers; i++) {
+		if (server->peers[i].addr == addr) return &server->peers[i];
+	}
+	return NULL;
+}
+
+bool v2d_repl_add_peer(v2d_repl_server_t *server, uint32_t addr) {
+	if (_find_peer(server, addr)) return true;
+	if (!v2d_array_reserve(&server->peers, &server->cap_peers, sizeof *server->peers, server->n_peers + 1)) return false;
+	server->peers[server->n_peers++] = (struct v2d_repl_peer){.addr = addr, .radius = INFINITY};
+	return true;
+}
+
+void v2d_repl_del_peer(v2d_repl_server_t *server, uint32_t addr) {
+	struct v2d_repl_peer *peer = _find_peer(server, addr);
+	if (!peer) return;
+	_free_views(peer->views);
+	*peer = server->peers[--server->n_peers];
+}
+
+void v2d_repl_set_view(v2d_repl_server_t *server, uint32_t addr, v2d_vec_t view, double radius) {
+	struct v2d_repl_peer *peer = _find_peer(server, addr);
+	if (!peer) return;
+	peer->view = view;
+	peer->radius = radius;
+}
+
+static int32_t _quantize(double x, double precision) {
+	double q = round(x / precision);
+	if (q > INT32_MAX) return INT32_MAX;
+	if (q < INT32_MIN) return INT32_MIN;
+	return q;
+}
+
+static void _capture(v2d_repl_server_t *server) {
+	for (size_t i = 0; i < server->n_slots; i++) {
+		struct v2d_repl_slot *s = &server->slots[i];
+		if (!s->ent) continue;
+
+		const struct v2d_repl_type *type = &server->types[s->type];
+		struct v2d_repl_object *obj = &server->state[i];
+		*obj = (struct v2d_repl_object){.id = s->id, .tag = type->tag, .tick = server->seq, .n_words = type->n_words};
+
+		v2d_vec_t pos = type->pos(s->ent, type->ctx);
+		obj->x = _quantize(v2dvx(pos), server->precision);
+		obj->y = _quantize(v2dvy(pos), server->precision);
+		type->save(s->ent, obj->state, type->ctx);
+
+		v2d_broad_move(&server->broad, s->proxy, V2D_SHAPE_RECT_LIT(pos, 0));
+	}
+}
+
+static void _receive_acks(v2d_repl_server_t *server) {
+	unsigned char buf[4];
+	uint32_t from;
+	size_t len;
+	while ((len = server->transport->recv(server->transport, &from, buf, sizeof buf))) {
+		struct v2d_repl_peer *peer = _find_peer(server, from);
+		if (!peer || len != 4) continue;
+
+		uint32_t seq = buf[0] | buf[1] << 8 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+		if (seq > peer->baseline && seq <= server->seq && _get_view(peer->views, seq, server->seq)) {
+			peer->baseline = seq;
+		}
+	}
+}
+
+static int _compare_priority(const void *a, const void *b) {
+	const struct v2d_repl_entry *ea = a, *eb = b;
+	if (ea->priority != eb->priority) return ea->priority < eb->priority ? 1 : -1;
+	// Break ties by ID, so packets don't depend on qsort's behaviour
+	return (ea->obj.id > eb->obj.id) - (ea->obj.id < eb->obj.id);
+}
+
+static bool _add_entry(v2d_repl_server_t *server, enum v2d_repl_change op, double priority, const struct v2d_repl_object *obj) {
+	if (!v2d_array_reserve(&server->entries, &server->cap_entries, sizeof *server->entries, server->n_entries + 1)) return false;
+	server->entries[server->n_entries++] = (struct v2d_repl_entry){op, priority, *obj};
+	return true;
+}
+
+// Find the entities relevant to a peer, and mark them with a new stamp
+static bool _find_relevant(v2d_repl_server_t *server, struct v2d_repl_peer *peer, size_t *n_relevant) {
+	size_t n = 0;
+	if (isinf(peer->radius)) {
+		// Everything is relevant
+		if (!v2d_array_reserve(&server->relevant, &server->cap_relevant, sizeof *server->relevant, server->n_slots)) return false;
+		for (size_t i = 0; i < server->n_slots; i++) {
+			if (server->slots[i].ent) server->relevant[n++] = server->slots[i].proxy;
+		}
+	} else {
+		v2d_vec_t r = v2d_vec(peer->radius, peer->radius);
+		for (;;) {
+			n = v2d_broad_query(&server->broad, peer->view - r, peer->view + r, NULL, server->relevant, server->cap_relevant);
+			if (n <= server->cap_relevant) break;
+			if (!v2d_array_reserve(&server->relevant, &server->cap_relevant, sizeof *server->relevant, n)) return false;
+		}
+	}
+
+	// The query finds a square, so cut it down to a circle
+	server->stamp++;
+	*n_relevant = 0;
+	for (size_t i = 0; i < n; i++) {
+		uint32_t slot = (uintptr_t)server->broad.proxies[server->relevant[i]].data;
+		const struct v2d_repl_object *obj = &server->state[slot];
+		v2d_vec_t pos = v2d_vec(obj->x, obj->y) * server->precision;
+		if (v2d_vec_mag(pos - peer->view) > peer->radius) continue;
+
+		server->relevant[(*n_relevant)++] = slot;
+		server->slots[slot].stamp = server->stamp;
+	}
+	return true;
+}
+
+static bool _send_peer(v2d_repl_server_t *server, struct v2d_repl_peer *peer) {
+	const struct v2d_repl_view *base = _get_view(peer->views, peer->baseline, server->seq);
+	if (!base) {
+		// The acknowledged packet is too old to use, so start again from nothing
+		peer->baseline = 0;
+		base = &_empty_view;
+	}
+
+	size_t n_relevant;
+	if (!_find_relevant(server, peer, &n_relevant)) return false;
+
+	// Collect everything that differs from what the peer has
+	server->n_entries = 0;
+	for (size_t i = 0; i < base->n; i++) {
+		const struct v2d_repl_object *obj = &base->objs[i];
+		uint32_t slot = obj->id & SLOT_MASK;
+		if (slot < server->n_slots && server->slots[slot].id == obj->id && server->slots[slot].ent && server->slots[slot].stamp == server->stamp) continue;
+		if (!_add_entry(server, V2D_REPL_DESPAWN, INFINITY, obj)) return false;
+	}
+
+	double scale = isfinite(peer->radius) && peer->radius > 0 ? 1 / peer->radius : 0;
+	for (size_t i = 0; i < n_relevant; i++) {
+		const struct v2d_repl_object *obj = &server->state[server->relevant[i]];
+		v2d_vec_t pos = v2d_vec(obj->x, obj->y) * server->precision;
+		double dist = v2d_vec_mag(pos - peer->view);
+
+		const struct v2d_repl_object *prev = _view_find(base, base->n, obj->id);
+		if (prev && _obj_equal(prev, obj)) continue;
+
+		// Priority grows with time since the last update, and shrinks with distance
+		uint32_t age = server->seq - (prev ? prev->tick : 0);
+		double priority = age / (1 + dist * scale);
+		if (!_add_entry(server, prev ? V2D_REPL_UPDATE : V2D_REPL_SPAWN, priority, obj)) return false;
+	}
+
+	if (server->n_entries) qsort(server->entries, server->n_entries, sizeof *server->entries, _compare_priority);
+
+	// Pack as many entries as fit. The budget may have been raised since the last packet
+	if (!v2d_array_reserve(&server->packet, &server->cap_packet, 1, server->budget)) return false;
+	memset(server->packet, 0, server->budget);
+	struct _bits b = {server->packet, server->budget, 0, false};
+	_put(&b, server->seq, 32);
+	_put(&b, peer->baseline, 32);
+	size_t count_bit = b.bit;
+	_put(&b, 0, 16);
+
+	size_t n = 0;
+	for (; n < server->n_entries && n < UINT16_MAX; n++) {
+		size_t start = b.bit;
+		const struct v2d_repl_entry *e = &server->entries[n];
+		_write_entry(&b, e, e->op == V2D_REPL_UPDATE ? _view_find(base, base->n, e->obj.id) : NULL);
+		if (b.overflow) {
+			// Undo the partial entry
+			for (size_t bit = start; bit < b.bit && bit / 8 < b.cap; bit++) {
+				b.data[bit / 8] &= ~(1u << (bit % 8));
+			}
+			b.bit = start;
+			b.overflow = false;
+			break;
+		}
+	}
+
+	size_t end = b.bit;
+	b.bit = count_bit;
+	_put(&b, n, 16);
+
+	// Remember what the peer will have once it receives this packet
+	if (!_build_view(&peer->views[server->seq % V2D_REPL_HISTORY], base, server->entries, n, server->seq)) return false;
+
+	// A packet the transport couldn't send is recovered from like a lost one, but the caller still needs to know
+	size_t len = (end + 7) / 8;
+	if (!server->transport->send(server->transport, peer->addr, server->packet, len)) return false;
+	peer->bytes_sent += len;
+	return true;
+}
+
+bool v2d_repl_server_tick(v2d_repl_server_t *server) {
+	bool ok = true;
+	v2d_prof_zone("replicate") {
+		_receive_acks(server);
+
+		server->seq++;
+		// Sequence number 0 means "no packet", so skip it if it wraps around
+		if (!server->seq) server->seq++;
+
+		_capture(server);
+
+		// One peer failing doesn't stop the others from being sent their packets
+		for (size_t i = 0; i < server->n_peers; i++) {
+			if (!_send_peer(server, &server->peers[i])) ok = false;
+		}
+	}
+	return ok;
+}
+
+// Client
+
+v2d_repl_client_t *v2d_repl_client_new(struct v2d_repl_transport *transport, uint32_t server_addr, double precision) {
+	v2d_repl_client_t *client = v2d_alloc(sizeof *client);
+	if (!client) return NULL;
+	*client = (v2d_repl_client_t){
+		.transport = transport,
+		.server = server_addr,
+		.precision = precision,
+		.max_packet = V2D_REPL_MTU,
+	};
+
+	if (!v2d_array_reserve(&client->packet, &client->cap_packet, 1, client->max_packet)) {
+		v2d_free(client);
+		return NULL;
+	}
+	return client;
+}
+
+void v2d_repl_client_free(v2d_repl_client_t *client) {
+	_free_views(client->views);
+	v2d_free(client->scratch.objs);
+	v2d_free(client->entries);
+	v2d_free(client->packet);
+	v2d_free(client);
+}
+
+static void _notify(v2d_repl_client_t *client, const struct v2d_repl_view *old, const struct v2d_repl_view *new) {
+	if (!client->on_change) return;
+
+	size_t i = 0, j = 0;
+	while (i < old->n || j < new->n) {
+		if (j == new->n || (i < old->n && old->objs[i].id < new->objs[j].id)) {
+			client->on_change(client->ctx, &old->objs[i++], V2D_REPL_DESPAWN);
+		} else if (i == old->n || new->objs[j].id < old->objs[i].id) {
+			client->on_change(client->ctx, &new->objs[j++], V2D_REPL_SPAWN);
+		} else {
+			if (!_obj_equal(&old->objs[i], &new->objs[j])) client->on_change(client->ctx, &new->objs[j], V2D_REPL_UPDATE);
+			i++;
+			j++;
+		}
+	}
+}
+
+// Returns false on failure. Malformed and out-of-date packets are ignored, the same as lost ones
+static bool _receive(v2d_repl_client_t *client, size_t len) {
+	struct _bits b = {client->packet, len, 0, false};
+	uint32_t seq = _get(&b, 32);
+	uint32_t baseline = _get(&b, 32);
+	size_t n = _get(&b, 16);
+	if (b.overflow) return true;
+
+	// Ignore packets that arrive late, or that refer to a packet we no longer have
+	if (client->seq && seq - client->seq - 1 >= UINT32_MAX / 2) return true;
+	if (baseline && seq - baseline - 1 >= UINT32_MAX / 2) return true;
+	const struct v2d_repl_view *base = _get_view(client->views, baseline, seq);
+	if (!base) return true;
+
+	if (!v2d_array_reserve(&client->entries, &client->cap_entries, sizeof *client->entries, n)) return false;
+	for (size_t i = 0; i < n; i++) {
+		if (!_read_entry(&b, &client->entries[i], base, seq)) return true;
+	}
+
+	// Build the new view separately, since it may replace the current one in the history
+	if (!_build_view(&client->scratch, base, client->entries, n, seq)) return false;
+	const struct v2d_repl_view *old = client->seq ? &client->views[client->seq % V2D_REPL_HISTORY] : &_empty_view;
+	_notify(client, old, &client->scratch);
+
+	struct v2d_repl_view tmp = client->views[seq % V2D_REPL_HISTORY];
+	client->views[seq % V2D_REPL_HISTORY] = client->scratch;
+	client->scratch = tmp;
+	client->seq = seq;
+
+	unsigned char ack[4] = {seq, seq >> 8, seq >> 16, seq >> 24};
+	return client->transport->send(client->transport, client->server, ack, sizeof ack);
+}
+
+bool v2d_repl_client_poll(v2d_repl_client_t *client) {
+	if (!v2d_array_reserve(&client->packet, &client->cap_packet, 1, client->max_packet)) return false;
+
+	bool ok = true;
+	uint32_t from;
+	size_t len;
+	while ((len = client->transport->recv(client->transport, &from, client->packet, client->max_packet))) {
+		if (from != client->server) continue;
+		client->bytes_received += len;
+		if (!_receive(client, len)) ok = false;
+	}
+	return ok;
+}
+
+const struct v2d_repl_object *v2d_repl_client_find(const v2d_repl_client_t *client, uint32_t id) {
+	if (!client->seq) return NULL;
+	const struct v2d_repl_view *view = &client->views[client->seq % V2D_REPL_HISTORY];
+	return _view_find(view, view->n, id);
+}
+
+v2d_vec_t v2d_repl_client_pos(const v2d_repl_client_t *client, const struct v2d_repl_object *obj) {
+	return v2d_vec(obj->x, obj->y) * client->precision;
+}
+
+// Loopback transport
+
+void v2d_repl_loopback_init(struct v2d_repl_loopback *lb) {
+	*lb = (struct v2d_repl_loopback){0};
+}
+
+void v2d_repl_loopback_destroy(struct v2d_repl_loopback *lb) {
+	for (size_t i = 0; i < lb->n_packets; i++) {
+		v2d_free(lb->packets[i].data);
+	}
+	v2d_free(lb->packets);
+	*lb = (struct v2d_repl_loopback){0};
+}
+
+static bool _loopback_send(struct v2d_repl_transport *t, uint32_t to, const void *data, size_t len) {
+	struct v2d_repl_loopback *lb = t->ctx;
+	if (lb->drop_every && ++lb->n_sent % lb->drop_every == 0) return true;
+
+	if (!v2d_array_reserve(&lb->packets, &lb->cap_packets, sizeof *lb->packets, lb->n_packets + 1)) return false;
+	unsigned char *copy = v2d_alloc(len ? len : 1);
+	if (!copy) return false;
+	memcpy(copy, data, len);
+	lb->packets[lb->n_packets++] = (struct v2d_repl_packet){t->addr, to, copy, len};
+	return true;
+}
+
+static size_t _loopback_recv(struct v2d_repl_transport *t, uint32_t *from, void *buf, size_t cap) {
+	struct v2d_repl_loopback *lb = t->ctx;
+	size_t i = 0;
+	while (i < lb->n_packets) {
+		struct v2d_repl_packet p = lb->packets[i];
+		if (p.to != t->addr) {
+			i++;
+			continue;
+		}
+
+		memmove(&lb->packets[i], &lb->packets[i + 1], (lb->n_packets - i - 1) * sizeof *lb->packets);
+		lb->n_packets--;
+
+		// Packets that are too big are dropped, like on a real network
+		size_t len = p.len;
+		if (len <= cap) {
+			memcpy(buf, p.data, len);
+			*from = p.from;
+		}
+		v2d_free(p.data);
+		if (len <= cap) return len;
+	}
+	return 0;
+}
+
+struct v2d_repl_transport v2d_repl_loopback_transport(struct v2d_repl_loopback *lb, uint32_t addr) {
+	return (struct v2d_repl_transport){_loopback_send, _loopback_recv, lb, addr};
+}
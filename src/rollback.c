@@ -0,0 +1,239 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "v2d.h"
+
+#if V2D_ROLLBACK_FRAMES % V2D_ROLLBACK_KEYFRAME
+#error "V2D_ROLLBACK_KEYFRAME must divide V2D_ROLLBACK_FRAMES"
+#endif
+
+v2d_rollback_t *v2d_rollback_new(v2d_world_t *world, v2d_action_dispatcher_t dis, double dt) {
+	v2d_rollback_t *rb = v2d_alloc(sizeof *rb);
+	if (!rb) return NULL;
+	*rb = (v2d_rollback_t){
+		.world = world,
+		.dis = dis,
+		.dt = dt,
+	};
+
+	// One set of inputs for every frame, plus one for the live values
+	size_t n = dis.n_actions ? dis.n_actions : 1;
+	v2d_vec_t *inputs = v2d_alloc((V2D_ROLLBACK_FRAMES + 1) * n * sizeof *inputs);
+	if (!inputs) {
+		v2d_free(rb);
+		return NULL;
+	}
+	for (int i = 0; i < V2D_ROLLBACK_FRAMES; i++) {
+		rb->frames[i].inputs = inputs + i*n;
+	}
+	rb->live_inputs = inputs + V2D_ROLLBACK_FRAMES*n;
+
+	return rb;
+}
+
+void v2d_rollback_free(v2d_rollback_t *rb) {
+	for (int i = 0; i < V2D_ROLLBACK_FRAMES; i++) {
+		v2d_snap_buf_free(&rb->frames[i].state);
+	}
+	v2d_free(rb->frames[0].inputs);
+	v2d_snap_buf_free(&rb->scratch);
+	v2d_free(rb);
+}
+
+static struct v2d_rollback_frame *_frame(v2d_rollback_t *rb, uint32_t tick) {
+	struct v2d_rollback_frame *f = &rb->frames[tick % V2D_ROLLBACK_FRAMES];
+	return f->valid && f->tick == tick ? f : NULL;
+}
+
+// Deltas
+
+static bool _put_byte(struct v2d_snap_buf *buf, unsigned char byte) {
+	if (!v2d_array_reserve(&buf->data, &buf->cap, 1, buf->len + 1)) return false;
+	buf->data[buf->len++] = byte;
+	return true;
+}
+
+static bool _put_var(struct v2d_snap_buf *buf, size_t v) {
+	for (; v >= 0x80; v >>= 7) {
+		if (!_put_byte(buf, (v & 0x7f) | 0x80)) return false;
+	}
+	return _put_byte(buf, v);
+}
+
+static size_t _get_var(const unsigned char **p) {
+	size_t v = 0;
+	for (int shift = 0;; shift += 7) {
+		unsigned char byte = *(*p)++;
+		v |= (size_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return v;
+	}
+}
+
+static inline unsigned char _xor(const struct v2d_snap_buf *key, const unsigned char *data, size_t i) {
+	return data[i] ^ (i < key->len ? key->data[i] : 0);
+}
+
+// Encode the difference between a keyframe and a snapshot, as the snapshot's length followed by
+// alternating runs of unchanged bytes and XORed changed bytes
+static bool _encode_delta(struct v2d_snap_buf *out, const struct v2d_snap_buf *key, const struct v2d_snap_buf *snap) {
+	out->len = 0;
+	if (!_put_var(out, snap->len)) return false;
+
+	size_t i = 0;
+	while (i < snap->len) {
+		size_t start = i;
+		while (i < snap->len && !_xor(key, snap->data, i)) i++;
+		if (!_put_var(out, i - start)) return false;
+
+		// A changed run ends at the first pair of unchanged bytes, since a single one isn't worth a new run
+		start = i;
+		while (i < snap->len && (_xor(key, snap->data, i) || (i + 1 < snap->len && _xor(key, snap->data, i + 1)))) i++;
+		if (!_put_var(out, i - start)) return false;
+		if (!v2d_array_reserve(&out->data, &out->cap, 1, out->len + (i - start))) return false;
+		for (size_t j = start; j < i; j++) {
+			out->data[out->len++] = _xor(key, snap->data, j);
+		}
+	}
+	return true;
+}
+
+static bool _decode_delta(struct v2d_snap_buf *out, const struct v2d_snap_buf *key, const struct v2d_snap_buf *delta) {
+	const unsigned char *p = delta->data;
+	size_t len = _get_var(&p);
+	if (!v2d_array_reserve(&out->data, &out->cap, 1, len)) return false;
+	out->len = len;
+
+	size_t i = 0;
+	while (i < len) {
+		size_t same = _get_var(&p);
+		for (size_t end = i + same; i < end; i++) {
+			out->data[i] = i < key->len ? key->data[i] : 0;
+		}
+
+		size_t changed = _get_var(&p);
+		for (size_t end = i + changed; i < end; i++) {
+			out->data[i] = *p++ ^ (i < key->len ? key->data[i] : 0);
+		}
+	}
+	return true;
+}
+
+// Saving and restoring
+
+static bool _save(v2d_rollback_t *rb, uint32_t tick) {
+	struct v2d_rollback_frame *f = &rb->frames[tick % V2D_ROLLBACK_FRAMES];
+	f->valid = false;
+
+	for (size_t i = 0; i < rb->dis.n_actions; i++) {
+		f->inputs[i] = rb->dis.actions[i].value.pos;
+	}
+
+	// Keyframes are always stored in full, as is any frame whose keyframe has been forgotten
+	const struct v2d_rollback_frame *key = NULL;
+	if (tick % V2D_ROLLBACK_KEYFRAME) key = _frame(rb, tick - tick % V2D_ROLLBACK_KEYFRAME);
+
+	if (!key) {
+		if (!v2d_snap_write(&f->state, rb->world, NULL)) return false;
+	} else {
+		if (!v2d_snap_write(&rb->scratch, rb->world, NULL)) return false;
+		if (!_encode_delta(&f->state, &key->state, &rb->scratch)) return false;
+	}
+	f->delta = key != NULL;
+
+	f->tick = tick;
+	f->valid = true;
+	return true;
+}
+
+// Whether a tick's keyframe is still in the buffer, which a delta frame needs to be decoded
+// The keyframe's slot is reused up to V2D_ROLLBACK_KEYFRAME - 1 ticks before the frame's own
+static bool _in_window(const v2d_rollback_t *rb, uint32_t tick) {
+	return rb->tick - (tick - tick % V2D_ROLLBACK_KEYFRAME) < V2D_ROLLBACK_FRAMES;
+}
+
+bool v2d_rollback_restore(v2d_rollback_t *rb, uint32_t tick) {
+	if (!_in_window(rb, tick)) return false;
+	const struct v2d_rollback_frame *f = _frame(rb, tick);
+	if (!f) return false;
+
+	const struct v2d_snap_buf *state = &f->state;
+	if (f->delta) {
+		const struct v2d_rollback_frame *key = _frame(rb, tick - tick % V2D_ROLLBACK_KEYFRAME);
+		if (!key || !_decode_delta(&rb->scratch, &key->state, &f->state)) return false;
+		state = &rb->scratch;
+	}
+
+	v2d_snap_t snap;
+	if (!v2d_snap_open_mem(&snap, state->data, state->len)) return false;
+	v2d_world_clear_saved(rb->world);
+	bool ok = v2d_snap_load(&snap, rb->world, NULL);
+	v2d_snap_close(&snap);
+
+	// Forget the ticks after this one, so they can't be restored by mistake
+	for (uint32_t t = tick + 1; t != rb->tick + 1; t++) {
+		rb->frames[t % V2D_ROLLBACK_FRAMES].valid = false;
+	}
+
+	rb->tick = tick;
+	if (rb->resim && rb->resim_from >= tick) rb->resim = false;
+	return ok;
+}
+
+// Simulation
+
+static void _set_inputs(v2d_rollback_t *rb, const v2d_vec_t *inputs) {
+	for (size_t i = 0; i < rb->dis.n_actions; i++) {
+		rb->dis.actions[i].value.pos = inputs[i];
+	}
+}
+
+static bool _step(v2d_rollback_t *rb) {
+	if (!_save(rb, rb->tick)) return false;
+	v2d_loop_update_world(rb->world, rb->dt);
+	rb->tick++;
+	return true;
+}
+
+bool v2d_rollback_resimulate(v2d_rollback_t *rb) {
+	if (!rb->resim) return true;
+
+	bool ok = true;
+	v2d_prof_zone("rollback") {
+		uint32_t target = rb->tick, from = rb->resim_from;
+		for (size_t i = 0; i < rb->dis.n_actions; i++) {
+			rb->live_inputs[i] = rb->dis.actions[i].value.pos;
+		}
+
+		ok = v2d_rollback_restore(rb, from);
+		while (ok && rb->tick != target) {
+			// Restoring forgot these frames, but their inputs are still there
+			_set_inputs(rb, rb->frames[rb->tick % V2D_ROLLBACK_FRAMES].inputs);
+			ok = _step(rb);
+			rb->resim_ticks++;
+		}
+
+		_set_inputs(rb, rb->live_inputs);
+		rb->resim = false;
+	}
+	return ok;
+}
+
+bool v2d_rollback_tick(v2d_rollback_t *rb) {
+	if (!v2d_rollback_resimulate(rb)) return false;
+	return _step(rb);
+}
+
+bool v2d_rollback_set_input(v2d_rollback_t *rb, uint32_t tick, const char *action, v2d_vec_t value) {
+	if (tick >= rb->tick || !_in_window(rb, tick)) return false;
+	struct v2d_rollback_frame *f = _frame(rb, tick);
+	v2d_action_t *act = v2d_adis_find_action(rb->dis, action);
+	if (!f || !act) return false;
+
+	size_t i = act - rb->dis.actions;
+	if (f->inputs[i] == value) return true;
+	f->inputs[i] = value;
+
+	if (!rb->resim || tick < rb->resim_from) rb->resim_from = tick;
+	rb->resim = true;
+	return true;
+}
@@ -0,0 +1,451 @@
+// Needed for mmap
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include "v2d.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+// Registered serializers, along with scratch space used while writing
+struct _type {
+	struct v2d_snap_type t;
+	size_t count, cursor;
+	uint32_t section;
+};
+
+static struct _type *_types = NULL;
+static size_t _n_types = 0, _cap_types = 0;
+
+static struct _type *_find_type(uint32_t tag) {
+	for (size_t i = 0; i < _n_types; i++) {
+		if (_types[i].t.tag == tag) return &_types[i];
+	}
+	return NULL;
+}
+
+bool v2d_snap_register(const struct v2d_snap_type *type) {
+	if (!type->tag || type->tag >= V2D_SNAP_TAG_RESERVED) return false;
+
+	struct _type *t = _find_type(type->tag);
+	if (!t) {
+		if (!v2d_array_reserve(&_types, &_cap_types, sizeof *_types, _n_types + 1)) return false;
+		t = &_types[_n_types++];
+	}
+	*t = (struct _type){*type};
+	return true;
+}
+
+static uint64_t _hash_id(const char *id) {
+	uint64_t h = 0xcbf29ce484222325;
+	for (; *id; id++) {
+		h ^= (unsigned char)*id;
+		h *= 0x100000001b3;
+	}
+	return h;
+}
+
+// Writing
+
+static bool _write(struct v2d_snap_buf *buf, v2d_world_t *world, const v2d_action_dispatcher_t *dis) {
+	// Count the entities of each type
+	for (size_t i = 0; i < _n_types; i++) {
+		_types[i].count = _types[i].cursor = 0;
+	}
+
+	struct _type *last = NULL;
+	size_t n_ents = 0;
+	for (v2d_ent_cb_t *v2d_world_iterate(ent, world)) {
+		if (!ent->type) continue;
+		if (!last || last->t.tag != ent->type) last = _find_type(ent->type);
+		if (!last) continue;
+		last->count++;
+		n_ents++;
+	}
+
+	// Count the saved entities that are awake, whose update order is saved too
+	size_t n_awake = 0;
+	for (size_t i = 0; i < V2D_WORLD_LOD_LISTS; i++) {
+		for (struct v2d_world_entity_list *l = world->awake[i]; l; l = l->awake_next) {
+			n_awake += l->ent->type && _find_type(l->ent->type);
+		}
+	}
+
+	// Lay out the sections
+	uint32_t n_sections = 4 + (dis != NULL);
+	for (size_t i = 0; i < _n_types; i++) {
+		if (_types[i].count) n_sections++;
+	}
+
+	size_t offset = ALIGN(sizeof (struct v2d_snap_header) + n_sections * sizeof (struct v2d_snap_section));
+	struct v2d_snap_section sections[n_sections];
+	uint32_t s = 0;
+
+	uint32_t order_s = s;
+	sections[s++] = (struct v2d_snap_section){V2D_SNAP_TAG_ORDER, 0, sizeof (uint32_t), 0, n_ents, offset};
+	offset = ALIGN(offset + n_ents * sizeof (uint32_t));
+
+	uint32_t clock_s = s;
+	sections[s++] = (struct v2d_snap_section){V2D_SNAP_TAG_CLOCK, 0, sizeof (struct v2d_world_clock), 0, 1, offset};
+	offset = ALIGN(offset + sizeof (struct v2d_world_clock));
+
+	uint32_t schedule_s = s;
+	sections[s++] = (struct v2d_snap_section){V2D_SNAP_TAG_SCHEDULE, 0, sizeof (struct v2d_world_schedule), 0, n_ents, offset};
+	offset = ALIGN(offset + n_ents * sizeof (struct v2d_world_schedule));
+
+	uint32_t awake_s = s;
+	sections[s++] = (struct v2d_snap_section){V2D_SNAP_TAG_AWAKE, 0, sizeof (uint64_t), 0, n_awake, offset};
+	offset = ALIGN(offset + n_awake * sizeof (uint64_t));
+
+	uint32_t actions_s = s;
+	if (dis) {
+		sections[s++] = (struct v2d_snap_section){V2D_SNAP_TAG_ACTIONS, 0, sizeof (struct v2d_snap_action), 0, dis->n_actions, offset};
+		offset = ALIGN(offset + dis->n_actions * sizeof (struct v2d_snap_action));
+	}
+
+	for (size_t i = 0; i < _n_types; i++) {
+		struct _type *t = &_types[i];
+		if (!t->count) continue;
+		t->section = s;
+		sections[s++] = (struct v2d_snap_section){t->t.tag, t->t.version, t->t.record_size, 0, t->count, offset};
+		offset = ALIGN(offset + t->count * t->t.record_size);
+	}
+
+	buf->len = 0;
+	if (!v2d_array_reserve(&buf->data, &buf->cap, 1, offset)) return false;
+	buf->len = offset;
+
+	// Zero everything first, so padding is always the same and identical worlds give identical snapshots
+	memset(buf->data, 0, buf->len);
+	struct v2d_snap_header header = {{'V', '2', 'D', 'S'}, V2D_SNAP_VERSION, 0x01020304, n_sections};
+	memcpy(buf->data, &header, sizeof header);
+	memcpy(buf->data + sizeof header, sections, sizeof sections);
+
+	// Write the records
+	uint32_t *order = (uint32_t *)(buf->data + sections[order_s].offset);
+	struct v2d_world_schedule *schedule = (struct v2d_world_schedule *)(buf->data + sections[schedule_s].offset);
+	last = NULL;
+	for (v2d_ent_cb_t *v2d_world_iterate(ent, world)) {
+		if (!ent->type) continue;
+		if (!last || last->t.tag != ent->type) last = _find_type(ent->type);
+		if (!last) continue;
+
+		unsigned char *rec = buf->data + sections[last->section].offset + last->cursor++ * last->t.record_size;
+		last->t.save(ent, rec, last->t.ctx);
+		*order++ = last->section;
+		v2d_world_get_schedule(world, ent, schedule++);
+	}
+
+	v2d_world_get_clock(world, (struct v2d_world_clock *)(buf->data + sections[clock_s].offset));
+
+	// The awake entities in update order, identified by their seq
+	uint64_t *awake = (uint64_t *)(buf->data + sections[awake_s].offset);
+	for (size_t i = 0; i < V2D_WORLD_LOD_LISTS; i++) {
+		for (struct v2d_world_entity_list *l = world->awake[i]; l; l = l->awake_next) {
+			if (l->ent->type && _find_type(l->ent->type)) *awake++ = l->seq;
+		}
+	}
+
+	if (dis) {
+		struct v2d_snap_action *actions = (struct v2d_snap_action *)(buf->data + sections[actions_s].offset);
+		for (size_t i = 0; i < dis->n_actions; i++) {
+			actions[i] = (struct v2d_snap_action){
+				_hash_id(dis->actions[i].id),
+				v2dvx(dis->actions[i].value.pos),
+				v2dvy(dis->actions[i].value.pos),
+			};
+		}
+	}
+
+	return true;
+}
+
+bool v2d_snap_write(struct v2d_snap_buf *buf, v2d_world_t *world, const v2d_action_dispatcher_t *dis) {
+	bool ok;
+	v2d_prof_zone("snapshot write") {
+		ok = _write(buf, world, dis);
+	}
+	return ok;
+}
+
+void v2d_snap_buf_free(struct v2d_snap_buf *buf) {
+	v2d_free(buf->data);
+	*buf = (struct v2d_snap_buf){0};
+}
+
+bool v2d_snap_save(const char *path, v2d_world_t *world, const v2d_action_dispatcher_t *dis) {
+	struct v2d_snap_buf buf = {0};
+	if (!v2d_snap_write(&buf, world, dis)) return false;
+
+	SDL_RWops *rw = SDL_RWFromFile(path, "wb");
+	if (!rw) {
+		v2d_raise_error(V2D_ERROR_IO, SDL_GetError());
+		v2d_snap_buf_free(&buf);
+		return false;
+	}
+
+	bool ok = SDL_RWwrite(rw, buf.data, 1, buf.len) == buf.len;
+	if (SDL_RWclose(rw) < 0) ok = false;
+	if (!ok) v2d_raise_error(V2D_ERROR_IO, SDL_GetError());
+
+	v2d_snap_buf_free(&buf);
+	return ok;
+}
+
+// Reading
+
+bool v2d_snap_open_mem(v2d_snap_t *snap, const void *data, size_t len) {
+	*snap = (v2d_snap_t){data, len, .storage = V2D_SNAP_BORROWED};
+
+	const struct v2d_snap_header *header = data;
+	if (len < sizeof *header || memcmp(header->magic, "V2DS", 4)) {
+		v2d_raise_error(V2D_ERROR_FORMAT, "not a snapshot");
+		return false;
+	}
+	if (header->byte_order != 0x01020304) {
+		v2d_raise_error(V2D_ERROR_FORMAT, "snapshot was saved with a different byte order");
+		return false;
+	}
+	if (header->version != V2D_SNAP_VERSION) {
+		v2d_raise_error(V2D_ERROR_FORMAT, "unsupported snapshot version");
+		return false;
+	}
+	if (header->n_sections > (len - sizeof *header) / sizeof (struct v2d_snap_section)) {
+		v2d_raise_error(V2D_ERROR_FORMAT, "snapshot is truncated");
+		return false;
+	}
+
+	const struct v2d_snap_section *sections = (const void *)(header + 1);
+	for (uint32_t i = 0; i < header->n_sections; i++) {
+		const struct v2d_snap_section *s = &sections[i];
+		if (s->offset % 16 || s->offset > len || (s->record_size && s->count > (len - s->offset) / s->record_size)) {
+			v2d_raise_error(V2D_ERROR_FORMAT, "snapshot is truncated");
+			return false;
+		}
+		if (s->tag == V2D_SNAP_TAG_ORDER && s->record_size != sizeof (uint32_t)) {
+			v2d_raise_error(V2D_ERROR_FORMAT, "invalid snapshot entity order");
+			return false;
+		}
+		if (s->tag == V2D_SNAP_TAG_ACTIONS && s->record_size != sizeof (struct v2d_snap_action)) {
+			v2d_raise_error(V2D_ERROR_FORMAT, "invalid snapshot actions");
+			return false;
+		}
+		if ((s->tag == V2D_SNAP_TAG_CLOCK && (s->record_size != sizeof (struct v2d_world_clock) || s->count != 1))
+				|| (s->tag == V2D_SNAP_TAG_SCHEDULE && s->record_size != sizeof (struct v2d_world_schedule))
+				|| (s->tag == V2D_SNAP_TAG_AWAKE && s->record_size != sizeof (uint64_t))) {
+			v2d_raise_error(V2D_ERROR_FORMAT, "invalid snapshot schedule");
+			return false;
+		}
+	}
+
+	snap->header = header;
+	snap->sections = sections;
+	return true;
+}
+
+bool v2d_snap_open(v2d_snap_t *snap, const char *path) {
+#ifdef USE_MMAP
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		struct stat st;
+		void *data = MAP_FAILED;
+		if (!fstat(fd, &st) && st.st_size > 0) {
+			data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+
+		if (data != MAP_FAILED) {
+			if (!v2d_snap_open_mem(snap, data, st.st_size)) {
+				munmap(data, st.st_size);
+				return false;
+			}
+			snap->storage = V2D_SNAP_MAPPED;
+			return true;
+		}
+	}
+	// Fall back to reading the file, in case it can't be mapped
+#endif
+
+	SDL_RWops *rw = SDL_RWFromFile(path, "rb");
+	if (!rw) {
+		v2d_raise_error(V2D_ERROR_IO, SDL_GetError());
+		return false;
+	}
+
+	int64_t size = SDL_RWsize(rw);
+	void *data = size > 0 ? v2d_alloc(size) : NULL;
+	bool ok = data && SDL_RWread(rw, data, 1, size) == (size_t)size;
+	SDL_RWclose(rw);
+
+	if (!ok) {
+		if (data) v2d_raise_error(V2D_ERROR_IO, SDL_GetError());
+		v2d_free(data);
+		return false;
+	}
+
+	if (!v2d_snap_open_mem(snap, data, size)) {
+		v2d_free(data);
+		return false;
+	}
+	snap->storage = V2D_SNAP_ALLOCATED;
+	return true;
+}
+
+void v2d_snap_close(v2d_snap_t *snap) {
+	switch (snap->storage) {
+	case V2D_SNAP_BORROWED:
+		break;
+	case V2D_SNAP_MAPPED:
+#ifdef USE_MMAP
+		munmap((void *)snap->data, snap->len);
+#endif
+		break;
+	case V2D_SNAP_ALLOCATED:
+		v2d_free((void *)snap->data);
+		break;
+	}
+	*snap = (v2d_snap_t){0};
+}
+
+static const struct v2d_snap_section *_find_section(const v2d_snap_t *snap, uint32_t tag) {
+	for (uint32_t i = 0; i < snap->header->n_sections; i++) {
+		if (snap->sections[i].tag == tag) return &snap->sections[i];
+	}
+	return NULL;
+}
+
+const void *v2d_snap_records(const v2d_snap_t *snap, uint32_t tag, size_t *count) {
+	const struct v2d_snap_section *s = _find_section(snap, tag);
+	if (!s) return NULL;
+	*count = s->count;
+	return snap->data + s->offset;
+}
+
+// A loaded entity, found by the sequence number it was saved with
+struct _loaded {
+	uint64_t seq;
+	const struct v2d_world_schedule *sched;
+	v2d_ent_t *ent;
+};
+
+static int _compare_loaded(const void *a, const void *b) {
+	uint64_t x = ((const struct _loaded *)a)->seq, y = ((const struct _loaded *)b)->seq;
+	return (x > y) - (x < y);
+}
+
+static bool _load(const v2d_snap_t *snap, v2d_world_t *world, const v2d_action_dispatcher_t *dis) {
+	uint32_t n_sections = snap->header->n_sections;
+
+	if (dis) {
+		size_t n;
+		const struct v2d_snap_action *actions = v2d_snap_records(snap, V2D_SNAP_TAG_ACTIONS, &n);
+		for (size_t i = 0; actions && i < n; i++) {
+			for (size_t j = 0; j < dis->n_actions; j++) {
+				if (_hash_id(dis->actions[j].id) == actions[i].id_hash) {
+					dis->actions[j].value.pos = v2d_vec(actions[i].x, actions[i].y);
+					break;
+				}
+			}
+		}
+	}
+
+	size_t n_ents;
+	const uint32_t *order = v2d_snap_records(snap, V2D_SNAP_TAG_ORDER, &n_ents);
+	if (!order) n_ents = 0;
+
+	// Snapshots from before the schedule was saved leave the clock alone and wake every entity
+	size_t n_clock, n_sched, n_awake = 0;
+	const struct v2d_world_clock *clock = v2d_snap_records(snap, V2D_SNAP_TAG_CLOCK, &n_clock);
+	const struct v2d_world_schedule *schedule = v2d_snap_records(snap, V2D_SNAP_TAG_SCHEDULE, &n_sched);
+	const uint64_t *awake = v2d_snap_records(snap, V2D_SNAP_TAG_AWAKE, &n_awake);
+	if (schedule && n_sched != n_ents) {
+		v2d_raise_error(V2D_ERROR_FORMAT, "invalid snapshot schedule");
+		return false;
+	}
+
+	// Wake times are relative to the clock, so it has to be set first
+	if (clock) v2d_world_set_clock(world, clock);
+
+	// The number of sections comes from the file, so these can't go on the stack
+	size_t *cursor = v2d_alloc((n_sections ? n_sections : 1) * sizeof *cursor);
+	struct _type **types = v2d_alloc((n_sections ? n_sections : 1) * sizeof *types);
+	struct _loaded *ents = v2d_alloc((n_ents ? n_ents : 1) * sizeof *ents);
+	bool ok = cursor && types && ents;
+	size_t n_loaded = 0;
+
+	for (uint32_t i = 0; ok && i < n_sections; i++) {
+		const struct v2d_snap_section *sec = &snap->sections[i];
+		cursor[i] = sec->count;
+		types[i] = sec->tag < V2D_SNAP_TAG_RESERVED ? _find_type(sec->tag) : NULL;
+
+		// Smaller records than the serializer expects would have it read past the end of the section
+		if (types[i] && sec->record_size < types[i]->t.record_size) {
+			v2d_raise_error(V2D_ERROR_FORMAT, "snapshot records are too small");
+			ok = false;
+		}
+	}
+
+	// World insertion reverses the order, so go through the entities backwards
+	for (size_t i = n_ents; ok && i-- > 0;) {
+		uint32_t s = order[i];
+		if (s >= n_sections || !cursor[s]) {
+			v2d_raise_error(V2D_ERROR_FORMAT, "invalid snapshot entity order");
+			ok = false;
+			break;
+		}
+		const struct v2d_snap_section *sec = &snap->sections[s];
+		const unsigned char *rec = snap->data + sec->offset + --cursor[s] * sec->record_size;
+
+		if (!types[s]) {
+			v2d_warn("no serializer for entity type %lu", (unsigned long)sec->tag);
+			continue;
+		}
+		struct v2d_world_entity_list *head = world->entities;
+		if (!types[s]->t.load(world, rec, sec->version, types[s]->t.ctx)) ok = false;
+
+		// Entities the callback added directly get their schedule back
+		if (!schedule || world->entities == head) continue;
+		ents[n_loaded++] = (struct _loaded){schedule[i].seq, &schedule[i], world->entities->ent};
+		if (!v2d_world_set_schedule(world, world->entities->ent, &schedule[i])) {
+			v2d_raise_error(V2D_ERROR_FORMAT, "invalid snapshot schedule");
+			ok = false;
+		}
+	}
+
+	// Awake entities are linked at the front of their list, so relinking them last to first restores the update order
+	if (ok && awake && n_loaded) {
+		qsort(ents, n_loaded, sizeof *ents, _compare_loaded);
+		for (size_t i = n_awake; i-- > 0;) {
+			struct _loaded key = {awake[i], NULL, NULL};
+			struct _loaded *e = bsearch(&key, ents, n_loaded, sizeof *ents, _compare_loaded);
+			if (e && e->sched->awake) v2d_world_set_schedule(world, e->ent, e->sched);
+		}
+	}
+
+	// Adding the entities used up sequence numbers, so put the saved counter back
+	if (clock) v2d_world_set_clock(world, clock);
+
+	v2d_free(cursor);
+	v2d_free(types);
+	v2d_free(ents);
+	return ok;
+}
+
+bool v2d_snap_load(const v2d_snap_t *snap, v2d_world_t *world, const v2d_action_dispatcher_t *dis) {
+	bool ok;
+	v2d_prof_zone("snapshot load") {
+		ok = _load(snap, world, dis);
+	}
+	return ok;
+}
@@ -0,0 +1,242 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "v2d.h"
+
+// Enough for any tree that fits in memory, since each level pushes at most V2D_STATIC_NODE_SIZE nodes
+#define STACK_SIZE (V2D_STATIC_NODE_SIZE * 32)
+
+// --- Building ---
+
+// Something to be sorted into tiles, either a shape or a node
+struct _key {
+	double key;
+	uint32_t idx;
+};
+
+static int _key_cmp(const void *a, const void *b) {
+	double ka = ((const struct _key *)a)->key, kb = ((const struct _key *)b)->key;
+	return (ka > kb) - (ka < kb);
+}
+
+// Sort `n` boxes into Sort-Tile-Recursive order, so that each run of V2D_STATIC_NODE_SIZE forms a compact tile
+static void _str_order(struct _key *keys, size_t n, const v2d_vec_t *min, const v2d_vec_t *max, size_t stride) {
+	size_t groups = (n + V2D_STATIC_NODE_SIZE - 1) / V2D_STATIC_NODE_SIZE;
+	size_t slices = ceil(sqrt(groups));
+	size_t slice_size = slices * V2D_STATIC_NODE_SIZE;
+
+	// The boxes are fields of larger structs, so they're found by stepping through memory `stride` bytes at a time
+#define BOX(arr, i) (*(const v2d_vec_t *)((const char *)(arr) + (i) * stride))
+	for (size_t i = 0; i < n; i++) {
+		keys[i] = (struct _key){v2dvx(BOX(min, i)) + v2dvx(BOX(max, i)), i};
+	}
+	qsort(keys, n, sizeof *keys, _key_cmp);
+
+	for (size_t start = 0; start < n; start += slice_size) {
+		size_t len = n - start < slice_size ? n - start : slice_size;
+		for (size_t i = start; i < start + len; i++) {
+			uint32_t idx = keys[i].idx;
+			keys[i].key = v2dvy(BOX(min, idx)) + v2dvy(BOX(max, idx));
+		}
+		qsort(keys + start, len, sizeof *keys, _key_cmp);
+	}
+#undef BOX
+}
+
+// Add a node covering `count` boxes starting at `first`
+static void _add_node(v2d_static_t *index, uint32_t first, uint32_t count, bool leaf) {
+	struct v2d_static_node *node = index->nodes + index->n_nodes++;
+	*node = (struct v2d_static_node){.first = first, .count = count, .leaf = leaf};
+
+	for (uint32_t i = first; i < first + count; i++) {
+		v2d_vec_t min = leaf ? index->items[i].min : index->nodes[i].min;
+		v2d_vec_t max = leaf ? index->items[i].max : index->nodes[i].max;
+		if (i == first) {
+			node->min = min;
+			node->max = max;
+		} else {
+			node->min = v2d_vec(fmin(v2dvx(node->min), v2dvx(min)), fmin(v2dvy(node->min), v2dvy(min)));
+			node->max = v2d_vec(fmax(v2dvx(node->max), v2dvx(max)), fmax(v2dvy(node->max), v2dvy(max)));
+		}
+	}
+}
+
+static bool _build(v2d_static_t *index) {
+	size_t n = index->n_shapes;
+	if (!n) return true;
+
+	// Every level has at most 1/V2D_STATIC_NODE_SIZE as many nodes as the one below, rounded up
+	size_t max_nodes = 0;
+	for (size_t level = n; level > 1; level = (level + V2D_STATIC_NODE_SIZE - 1) / V2D_STATIC_NODE_SIZE) {
+		max_nodes += (level + V2D_STATIC_NODE_SIZE - 1) / V2D_STATIC_NODE_SIZE;
+	}
+	if (!max_nodes) max_nodes = 1;
+
+	struct _key *keys = v2d_alloc(n * sizeof *keys);
+	struct v2d_static_item *items = v2d_alloc(n * sizeof *items);
+	index->items = v2d_alloc(n * sizeof *index->items);
+	index->nodes = v2d_alloc(max_nodes * sizeof *index->nodes);
+	bool ok = keys && items && index->items && index->nodes;
+	if (ok) {
+		// Put the shapes into leaf order, then make a leaf for each run of them
+		for (size_t i = 0; i < n; i++) {
+			v2d_rect_t bounds = v2d_shape_bounds(index->shapes[i]);
+			items[i] = (struct v2d_static_item){bounds.pos, bounds.pos + bounds.dim, i};
+		}
+		_str_order(keys, n, &items->min, &items->max, sizeof *items);
+		for (size_t i = 0; i < n; i++) index->items[i] = items[keys[i].idx];
+
+		size_t level_start = 0;
+		for (size_t i = 0; i < n; i += V2D_STATIC_NODE_SIZE) {
+			_add_node(index, i, n - i < V2D_STATIC_NODE_SIZE ? n - i : V2D_STATIC_NODE_SIZE, true);
+		}
+
+		// Then group each level's nodes the same way until there's only one
+		while (index->n_nodes - level_start > 1) {
+			size_t level_len = index->n_nodes - level_start;
+			struct v2d_static_node *level = index->nodes + level_start;
+
+			_str_order(keys, level_len, &level->min, &level->max, sizeof *level);
+			// Each level has at most an eighth as many nodes as there are shapes, so the shapes' scratch space has room for it
+			struct v2d_static_node *sorted = (void *)items;
+			for (size_t i = 0; i < level_len; i++) sorted[i] = level[keys[i].idx];
+			memcpy(level, sorted, level_len * sizeof *level);
+
+			for (size_t i = 0; i < level_len; i += V2D_STATIC_NODE_SIZE) {
+				size_t count = level_len - i < V2D_STATIC_NODE_SIZE ? level_len - i : V2D_STATIC_NODE_SIZE;
+				_add_node(index, level_start + i, count, false);
+			}
+			level_start += level_len;
+		}
+	}
+
+	v2d_free(keys);
+	v2d_free(items);
+	return ok;
+}
+
+v2d_static_t *v2d_static_new(const v2d_shape_t *shapes, void *const *data, const v2d_filter_t *filters, size_t n) {
+	if (n >= V2D_PROXY_NONE) return NULL;
+
+	v2d_static_t *index = v2d_alloc(sizeof *index);
+	if (!index) return NULL;
+	*index = (v2d_static_t){.n_shapes = n};
+
+	bool ok = false;
+	v2d_prof_zone("static build") {
+		index->shapes = v2d_alloc(n * sizeof *index->shapes);
+		index->data = v2d_alloc(n * sizeof *index->data);
+		index->filters = v2d_alloc(n * sizeof *index->filters);
+		if ((index->shapes && index->data && index->filters) || !n) {
+			for (size_t i = 0; i < n; i++) {
+				index->shapes[i] = shapes[i];
+				index->data[i] = data ? data[i] : NULL;
+				index->filters[i] = filters ? filters[i] : V2D_FILTER_DEFAULT;
+			}
+			ok = _build(index);
+		}
+	}
+
+	if (!ok) {
+		v2d_static_free(index);
+		return NULL;
+	}
+	return index;
+}
+
+void v2d_static_free(v2d_static_t *index) {
+	if (!index) return;
+	v2d_free(index->shapes);
+	v2d_free(index->data);
+	v2d_free(index->filters);
+	v2d_free(index->items);
+	v2d_free(index->nodes);
+	v2d_free(index);
+}
+
+// --- Queries ---
+
+static inline bool _overlap(v2d_vec_t amin, v2d_vec_t amax, v2d_vec_t bmin, v2d_vec_t bmax) {
+	return v2dvx(amin) <= v2dvx(bmax) && v2dvx(bmin) <= v2dvx(amax) && v2dvy(amin) <= v2dvy(bmax) && v2dvy(bmin) <= v2dvy(amax);
+}
+
+void v2d_static_visit(const v2d_static_t *index, v2d_vec_t min, v2d_vec_t max, const v2d_filter_t *filter, v2d_static_visit_t fn, void *ctx) {
+	if (!index->n_nodes) return;
+
+	uint32_t stack[STACK_SIZE];
+	size_t top = 0;
+	stack[top++] = index->n_nodes - 1;
+
+	while (top) {
+		const struct v2d_static_node *node = index->nodes + stack[--top];
+		if (!_overlap(node->min, node->max, min, max)) continue;
+
+		if (!node->leaf) {
+			for (uint32_t i = 0; i < node->count; i++) stack[top++] = node->first + i;
+			continue;
+		}
+
+		for (uint32_t i = node->first; i < node->first + node->count; i++) {
+			const struct v2d_static_item *item = index->items + i;
+			if (!_overlap(item->min, item->max, min, max)) continue;
+			if (filter && !v2d_filter_query(*filter, index->filters[item->id])) continue;
+			if (!fn(index, item->id, ctx)) return;
+		}
+	}
+}
+
+struct _query_ctx {
+	uint32_t *out;
+	size_t max_out, n;
+};
+
+static bool _query_add(const v2d_static_t *index, uint32_t id, void *ctx) {
+	struct _query_ctx *q = ctx;
+	if (q->n < q->max_out) q->out[q->n] = id;
+	q->n++;
+	return true;
+}
+
+size_t v2d_static_query(const v2d_static_t *index, v2d_vec_t min, v2d_vec_t max, const v2d_filter_t *filter, uint32_t *out, size_t max_out) {
+	struct _query_ctx q = {out, max_out, 0};
+	v2d_static_visit(index, min, max, filter, _query_add, &q);
+	return q.n;
+}
+
+uint32_t v2d_static_raycast(const v2d_static_t *index, v2d_ray_t ray, const v2d_filter_t *filter, double *t) {
+	uint32_t best = V2D_PROXY_NONE;
+	double best_t = INFINITY;
+
+	if (index->n_nodes) {
+		uint32_t stack[STACK_SIZE];
+		size_t top = 0;
+		stack[top++] = index->n_nodes - 1;
+
+		while (top) {
+			// Skip nodes the ray misses, or only reaches after something already hit
+			// These are entry fractions, so a hit at 0 means the ray starts inside a shape and nothing can be nearer
+			const struct v2d_static_node *node = index->nodes + stack[--top];
+			if (!(v2d_raycast_rect_entry(ray, (v2d_rect_t){node->min, node->max - node->min}) < best_t)) continue;
+
+			if (!node->leaf) {
+				for (uint32_t i = 0; i < node->count; i++) stack[top++] = node->first + i;
+				continue;
+			}
+
+			for (uint32_t i = node->first; i < node->first + node->count; i++) {
+				uint32_t id = index->items[i].id;
+				if (filter && !v2d_filter_query(*filter, index->filters[id])) continue;
+				double hit = v2d_raycast_shape_entry(ray, index->shapes[id]);
+				if (hit < best_t) {
+					best_t = hit;
+					best = id;
+				}
+			}
+		}
+	}
+
+	if (t) *t = best_t;
+	return best;
+}
@@ -0,0 +1,70 @@
+#include <math.h>
+#include <string.h>
+#include "v2d.h"
+
+struct v2d_stats_counters v2d_stats_current = {0};
+
+static v2d_stats_t _stats = {0};
+
+v2d_stats_t v2d_stats_snapshot(void) {
+	return _stats;
+}
+
+void v2d_stats_end_frame(void) {
+	_stats.frames++;
+	_stats.frame = v2d_stats_current;
+
+	_stats.total.entities_updated += v2d_stats_current.entities_updated;
+	_stats.total.draw_calls += v2d_stats_current.draw_calls;
+	_stats.total.sdl_calls += v2d_stats_current.sdl_calls;
+	_stats.total.pairs_tested += v2d_stats_current.pairs_tested;
+	_stats.total.pairs_hit += v2d_stats_current.pairs_hit;
+	_stats.total.allocs += v2d_stats_current.allocs;
+
+	memset(&v2d_stats_current, 0, sizeof v2d_stats_current);
+}
+
+void v2d_stats_reset(void) {
+	memset(&_stats, 0, sizeof _stats);
+	memset(&v2d_stats_current, 0, sizeof v2d_stats_current);
+}
+
+// Layout of the overlay, in pixels
+#define BAR_HEIGHT 6
+#define BAR_GAP 3
+#define DECADE_WIDTH 40
+#define N_DECADES 6
+#define MARGIN 8
+
+void v2d_stats_draw_overlay(v2d_render_t *render) {
+	struct v2d_stats_counters c = _stats.frame;
+	uint64_t values[] = {c.entities_updated, c.draw_calls, c.sdl_calls, c.pairs_tested, c.pairs_hit, c.allocs};
+	const size_t n_values = sizeof values / sizeof *values;
+
+	// Draw in SDL screen coordinates
+	// With both transformations set to identity, world position (x, -y) is drawn at pixel (x, y)
+	v2d_transform_t camera_tr = render->camera_tr, screen_tr = render->screen_tr;
+	render->camera_tr = v2d_transform_new();
+	render->screen_tr = v2d_transform_new();
+
+	for (size_t i = 0; i < n_values; i++) {
+		double y = MARGIN + i * (BAR_HEIGHT + BAR_GAP);
+		double len = DECADE_WIDTH * log10(1 + values[i]);
+		if (len > DECADE_WIDTH * N_DECADES) len = DECADE_WIDTH * N_DECADES;
+
+		// Alternate colours so adjacent bars are easy to tell apart
+		if (i & 1) v2d_render_rgb(render, 0.3, 0.8, 1);
+		else v2d_render_rgb(render, 1, 0.8, 0.3);
+		v2d_render_fill_rect(render, v2d_vec(MARGIN, -y), v2d_vec(len, -BAR_HEIGHT));
+	}
+
+	// Tick marks for each power of ten
+	double height = n_values * (BAR_HEIGHT + BAR_GAP);
+	v2d_render_rgb(render, 0.5, 0.5, 0.5);
+	for (int i = 0; i <= N_DECADES; i++) {
+		v2d_render_draw_line(render, v2d_vec(MARGIN + i*DECADE_WIDTH, -MARGIN + BAR_GAP), v2d_vec(0, -height));
+	}
+
+	render->camera_tr = camera_tr;
+	render->screen_tr = screen_tr;
+}
@@ -0,0 +1,144 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "v2d.h"
+
+#define SLOT_MASK (V2D_TIMER_SLOTS - 1)
+
+// The furthest ahead a timer can be placed directly; later timers wait in the top level's furthest slot
+#define MAX_DELTA ((UINT64_C(1) << (V2D_TIMER_LEVELS * V2D_TIMER_SLOT_BITS)) - 1)
+
+void v2d_timer_wheel_init(v2d_timer_wheel_t *wheel, double resolution) {
+	*wheel = (v2d_timer_wheel_t){.resolution = resolution};
+}
+
+void v2d_timer_init(v2d_timer_t *timer, v2d_timer_callback_t fn, void *data) {
+	*timer = (v2d_timer_t){.fn = fn, .data = data};
+}
+
+static void _unlink(v2d_timer_t *timer) {
+	*timer->pprev = timer->next;
+	if (timer->next) timer->next->pprev = timer->pprev;
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
+
+static void _link(v2d_timer_t **head, v2d_timer_t *timer) {
+	timer->next = *head;
+	if (timer->next) timer->next->pprev = &timer->next;
+	timer->pprev = head;
+	*head = timer;
+}
+
+// Put a timer in the slot covering its due tick, at the lowest level that reaches that far
+static void _place(v2d_timer_wheel_t *wheel, v2d_timer_t *timer) {
+	uint64_t delta = timer->when - wheel->now;
+	uint64_t when = delta > MAX_DELTA ? wheel->now + MAX_DELTA : timer->when;
+
+	int level = 0;
+	while (level < V2D_TIMER_LEVELS - 1 && delta >> ((level + 1) * V2D_TIMER_SLOT_BITS)) level++;
+	_link(&wheel->slots[level][(when >> (level * V2D_TIMER_SLOT_BITS)) & SLOT_MASK], timer);
+}
+
+void v2d_timer_start_ticks(v2d_timer_wheel_t *wheel, v2d_timer_t *timer, uint64_t ticks) {
+	if (v2d_timer_pending(timer)) _unlink(timer);
+	else wheel->n_pending++;
+
+	timer->when = wheel->now + (ticks ? ticks : 1);
+	_place(wheel, timer);
+}
+
+void v2d_timer_start(v2d_timer_wheel_t *wheel, v2d_timer_t *timer, double seconds) {
+	// Time already accumulated towards the next tick counts towards the delay
+	double ticks = ceil((seconds + wheel->accumulator) / wheel->resolution);
+	v2d_timer_start_ticks(wheel, timer, ticks < 1 ? 1 : ticks < (double)UINT64_MAX ? (uint64_t)ticks : UINT64_MAX - wheel->now);
+}
+
+void v2d_timer_stop(v2d_timer_wheel_t *wheel, v2d_timer_t *timer) {
+	if (!v2d_timer_pending(timer)) return;
+	_unlink(timer);
+	wheel->n_pending--;
+}
+
+void v2d_timer_set_now(v2d_timer_wheel_t *wheel, uint64_t now) {
+	// Take every pending timer out of the wheel, keeping how long each had left
+	v2d_timer_t *pending = NULL;
+	for (int level = 0; level < V2D_TIMER_LEVELS; level++) {
+		for (int i = 0; i < V2D_TIMER_SLOTS; i++) {
+			while (wheel->slots[level][i]) {
+				v2d_timer_t *timer = wheel->slots[level][i];
+				_unlink(timer);
+				timer->when -= wheel->now;
+				timer->next = pending;
+				pending = timer;
+			}
+		}
+	}
+
+	wheel->now = now;
+	while (pending) {
+		v2d_timer_t *timer = pending;
+		pending = timer->next;
+		timer->when += now;
+		_place(wheel, timer);
+	}
+}
+
+// Move every timer in a slot down to the levels below
+static void _cascade(v2d_timer_wheel_t *wheel, int level) {
+	v2d_timer_t **slot = &wheel->slots[level][(wheel->now >> (level * V2D_TIMER_SLOT_BITS)) & SLOT_MASK];
+	v2d_timer_t *timer = *slot;
+	*slot = NULL;
+
+	while (timer) {
+		v2d_timer_t *next = timer->next;
+		_place(wheel, timer);
+		timer = next;
+	}
+}
+
+static size_t _tick(v2d_timer_wheel_t *wheel) {
+	wheel->now++;
+
+	// Find how many levels wrapped around, then cascade from the top down
+	int wrapped = 0;
+	while (wrapped < V2D_TIMER_LEVELS - 1 && !((wheel->now >> (wrapped * V2D_TIMER_SLOT_BITS)) & SLOT_MASK)) wrapped++;
+	for (int level = wrapped; level > 0; level--) _cascade(wheel, level);
+
+	// Move the due timers to a list of their own, so callbacks can start and stop any timer safely
+	v2d_timer_t *due = NULL, **slot = &wheel->slots[0][wheel->now & SLOT_MASK];
+	if (*slot) {
+		due = *slot;
+		due->pprev = &due;
+		*slot = NULL;
+	}
+
+	size_t fired = 0;
+	while (due) {
+		v2d_timer_t *timer = due;
+		_unlink(timer);
+		wheel->n_pending--;
+		timer->fn(timer, timer->data);
+		fired++;
+	}
+	return fired;
+}
+
+size_t v2d_timer_advance(v2d_timer_wheel_t *wheel, double seconds) {
+	size_t fired = 0;
+	v2d_prof_zone("timers") {
+		wheel->accumulator += seconds;
+		double ticks = floor(wheel->accumulator / wheel->resolution);
+		wheel->accumulator -= ticks * wheel->resolution;
+
+		for (; ticks >= 1; ticks--) {
+			// With nothing pending, there's nothing to fire or cascade
+			if (!wheel->n_pending) {
+				wheel->now += ticks;
+				break;
+			}
+			fired += _tick(wheel);
+		}
+	}
+	return fired;
+}
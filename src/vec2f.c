@@ -0,0 +1,151 @@
+#include <math.h>
+#include <stddef.h>
+#include "v2d/vec2f.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define USE_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define USE_NEON
+#include <arm_neon.h>
+#endif
+
+// Each SIMD loop processes 4 vectors at a time, and leaves any remainder to a scalar loop
+
+#if defined(USE_SSE)
+// Load 4 vectors and split them into their x and y components
+static inline void _load4(const v2d_vec2f_t *v, __m128 *x, __m128 *y) {
+	__m128 a = _mm_loadu_ps(&v[0].x), b = _mm_loadu_ps(&v[2].x);
+	*x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+	*y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+// Interleave 4 x and y components and store them as vectors
+static inline void _store4(v2d_vec2f_t *v, __m128 x, __m128 y) {
+	_mm_storeu_ps(&v[0].x, _mm_unpacklo_ps(x, y));
+	_mm_storeu_ps(&v[2].x, _mm_unpackhi_ps(x, y));
+}
+#endif
+
+void v2d_vec2f_dot_n(float *out, const v2d_vec2f_t *a, const v2d_vec2f_t *b, size_t n) {
+	size_t i = 0;
+
+#if defined(USE_SSE)
+	for (; i + 4 <= n; i += 4) {
+		__m128 ax, ay, bx, by;
+		_load4(a + i, &ax, &ay);
+		_load4(b + i, &bx, &by);
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)));
+	}
+#elif defined(USE_NEON)
+	for (; i + 4 <= n; i += 4) {
+		float32x4x2_t va = vld2q_f32(&a[i].x), vb = vld2q_f32(&b[i].x);
+		vst1q_f32(out + i, vmlaq_f32(vmulq_f32(va.val[0], vb.val[0]), va.val[1], vb.val[1]));
+	}
+#endif
+
+	for (; i < n; i++) {
+		out[i] = a[i].x*b[i].x + a[i].y*b[i].y;
+	}
+}
+
+void v2d_vec2f_mag2_n(float *out, const v2d_vec2f_t *v, size_t n) {
+	v2d_vec2f_dot_n(out, v, v, n);
+}
+
+void v2d_vec2f_norm_n(v2d_vec2f_t *out, const v2d_vec2f_t *v, size_t n) {
+	size_t i = 0;
+
+#if defined(USE_SSE)
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4) {
+		__m128 x, y;
+		_load4(v + i, &x, &y);
+		__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+		// Zero vectors would divide by zero, so mask them out
+		__m128 nonzero = _mm_cmpneq_ps(mag, zero);
+		__m128 inv = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1), mag), nonzero);
+		_store4(out + i, _mm_mul_ps(x, inv), _mm_mul_ps(y, inv));
+	}
+#elif defined(USE_NEON)
+	const float32x4_t zero = vdupq_n_f32(0);
+	for (; i + 4 <= n; i += 4) {
+		float32x4x2_t xy = vld2q_f32(&v[i].x);
+		float32x4_t mag2 = vmlaq_f32(vmulq_f32(xy.val[0], xy.val[0]), xy.val[1], xy.val[1]);
+		// Estimate 1/sqrt and refine it with two Newton-Raphson steps
+		float32x4_t inv = vrsqrteq_f32(mag2);
+		inv = vmulq_f32(inv, vrsqrtsq_f32(vmulq_f32(mag2, inv), inv));
+		inv = vmulq_f32(inv, vrsqrtsq_f32(vmulq_f32(mag2, inv), inv));
+		// Zero vectors would give infinity, so mask them out
+		uint32x4_t nonzero = vmvnq_u32(vceqq_f32(mag2, zero));
+		inv = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(inv), nonzero));
+		xy.val[0] = vmulq_f32(xy.val[0], inv);
+		xy.val[1] = vmulq_f32(xy.val[1], inv);
+		vst2q_f32(&out[i].x, xy);
+	}
+#endif
+
+	for (; i < n; i++) {
+		float mag = sqrtf(v[i].x*v[i].x + v[i].y*v[i].y);
+		float inv = mag == 0 ? 0 : 1 / mag;
+		out[i] = (v2d_vec2f_t){v[i].x * inv, v[i].y * inv};
+	}
+}
+
+void v2d_vec2f_rotate_n(v2d_vec2f_t *out, const v2d_vec2f_t *v, size_t n, float theta) {
+	float c = cosf(theta), s = sinf(theta);
+	size_t i = 0;
+
+#if defined(USE_SSE)
+	const __m128 vc = _mm_set1_ps(c), vs = _mm_set1_ps(s);
+	for (; i + 4 <= n; i += 4) {
+		__m128 x, y;
+		_load4(v + i, &x, &y);
+		__m128 rx = _mm_sub_ps(_mm_mul_ps(x, vc), _mm_mul_ps(y, vs));
+		__m128 ry = _mm_add_ps(_mm_mul_ps(x, vs), _mm_mul_ps(y, vc));
+		_store4(out + i, rx, ry);
+	}
+#elif defined(USE_NEON)
+	for (; i + 4 <= n; i += 4) {
+		float32x4x2_t xy = vld2q_f32(&v[i].x), r;
+		r.val[0] = vmlsq_n_f32(vmulq_n_f32(xy.val[0], c), xy.val[1], s);
+		r.val[1] = vmlaq_n_f32(vmulq_n_f32(xy.val[0], s), xy.val[1], c);
+		vst2q_f32(&out[i].x, r);
+	}
+#endif
+
+	for (; i < n; i++) {
+		v2d_vec2f_t p = v[i];
+		out[i] = (v2d_vec2f_t){p.x*c - p.y*s, p.x*s + p.y*c};
+	}
+}
+
+void v2d_vec2f_transform_n(v2d_vec2f_t *out, const v2d_vec2f_t *v, size_t n, v2d_transform_t tr) {
+	const float mx = v2dvx(tr.mul), my = v2dvy(tr.mul);
+	const float ax = v2dvx(tr.add), ay = v2dvy(tr.add);
+	size_t i = 0;
+
+#if defined(USE_SSE)
+	const __m128 vmx = _mm_set1_ps(mx), vmy = _mm_set1_ps(my);
+	const __m128 vax = _mm_set1_ps(ax), vay = _mm_set1_ps(ay);
+	for (; i + 4 <= n; i += 4) {
+		__m128 x, y;
+		_load4(v + i, &x, &y);
+		__m128 rx = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(x, vmx), _mm_mul_ps(y, vmy)), vax);
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, vmy), _mm_mul_ps(y, vmx)), vay);
+		_store4(out + i, rx, ry);
+	}
+#elif defined(USE_NEON)
+	for (; i + 4 <= n; i += 4) {
+		float32x4x2_t xy = vld2q_f32(&v[i].x), r;
+		r.val[0] = vmlsq_n_f32(vmlaq_n_f32(vdupq_n_f32(ax), xy.val[0], mx), xy.val[1], my);
+		r.val[1] = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(ay), xy.val[0], my), xy.val[1], mx);
+		vst2q_f32(&out[i].x, r);
+	}
+#endif
+
+	for (; i < n; i++) {
+		v2d_vec2f_t p = v[i];
+		out[i] = (v2d_vec2f_t){p.x*mx - p.y*my + ax, p.x*my + p.y*mx + ay};
+	}
+}
@@ -1,11 +1,49 @@
 #include <complex.h>
 #include <math.h>
+#include <stdbool.h>
 #include "v2d/vector.h"
 #include "v2d/transform.h"
 
+#if defined(__SSE2__) && !defined(V2D_VEC_FLOAT)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef V2D_DETERMINISTIC
+// sin and cos built from nothing but exactly rounded operations, so they give the same result everywhere
+// The polynomials are the minimax approximations from fdlibm, accurate on [-pi/4, pi/4]
+static inline double _sin_kernel(double x, double z) {
+	return x + x*z*(-1.66666666666666324348e-01 + z*(8.33333333332248946124e-03 + z*(-1.98412698298579493134e-04
+		+ z*(2.75573137070700676789e-06 + z*(-2.50507602534068634195e-08 + z*1.58969099521155010221e-10)))));
+}
+
+static inline double _cos_kernel(double z) {
+	return 1 - 0.5*z + z*z*(4.16666666666666019037e-02 + z*(-1.38888888888741095749e-03 + z*(2.48015872894767294178e-05
+		+ z*(-2.75573143513906633035e-07 + z*(2.08757232129817482790e-09 + z*-1.13596475577881948265e-11)))));
+}
+
+static v2d_vec_t cis(double theta) {
+	if (!isfinite(theta)) return v2d_vec(theta - theta, theta - theta);
+
+	// Reduce theta to [-pi/4, pi/4] plus a quadrant, subtracting n*pi/2 in two parts to keep the precision
+	double n = floor(theta * 6.36619772367581382433e-01 + 0.5);
+	double r = theta - n*1.57079632673412561417e+00 - n*6.07710050650619224932e-11;
+	double z = r*r, s = _sin_kernel(r, z), c = _cos_kernel(z);
+
+	int quadrant = fmod(n, 4);
+	if (quadrant < 0) quadrant += 4;
+	switch (quadrant) {
+	case 0: return v2d_vec(c, s);
+	case 1: return v2d_vec(-s, c);
+	case 2: return v2d_vec(-c, -s);
+	default: return v2d_vec(s, -c);
+	}
+}
+#else
 static inline v2d_vec_t cis(double theta) {
 	return v2d_vec(cos(theta), sin(theta));
 }
+#endif
 
 double v2d_vec_mag2(v2d_vec_t v) {
 	double x = creal(v), y = cimag(v);
@@ -14,7 +52,7 @@ double v2d_vec_mag2(v2d_vec_t v) {
 
 v2d_vec_t v2d_vec_norm(v2d_vec_t v) {
 	if (v == 0) return 0;
-	return v / v2d_vec_mag(v);
+	return v * (1 / v2d_vec_mag(v));
 }
 
 v2d_vec_t v2d_vec_dot(v2d_vec_t a, v2d_vec_t b) {
@@ -22,7 +60,7 @@ v2d_vec_t v2d_vec_dot(v2d_vec_t a, v2d_vec_t b) {
 }
 
 v2d_vec_t v2d_vec_rotate(v2d_vec_t v, double theta) {
-	return v * cis(theta);
+	return v2d_vec_mul(v, cis(theta));
 }
 
 // --- Implementation of transform.h ---
@@ -32,18 +70,18 @@ v2d_transform_t v2d_transform_new(void) {
 }
 
 v2d_transform_t v2d_tr_invert(v2d_transform_t tr) {
-	v2d_vec_t mul = 1/tr.mul, add = -tr.add * mul;
+	v2d_vec_t mul = conj(tr.mul) / v2d_vec_mag2(tr.mul), add = -v2d_vec_mul(tr.add, mul);
 	return (v2d_transform_t){mul, add};
 }
 
 v2d_transform_t v2d_tr_compose(v2d_transform_t a, v2d_transform_t b) {
-	return (v2d_transform_t){b.mul * a.mul, b.mul*a.add + b.add};
+	return (v2d_transform_t){v2d_vec_mul(b.mul, a.mul), v2d_vec_mul(b.mul, a.add) + b.add};
 }
 
 void v2d_tr_rotate(v2d_transform_t *tr, double theta) {
-	double _Complex mul = cis(theta);
-	tr->mul *= mul;
-	tr->add *= mul;
+	v2d_vec_t mul = cis(theta);
+	tr->mul = v2d_vec_mul(tr->mul, mul);
+	tr->add = v2d_vec_mul(tr->add, mul);
 }
 
 void v2d_tr_scale(v2d_transform_t *tr, double sf) {
@@ -54,3 +92,90 @@ void v2d_tr_scale(v2d_transform_t *tr, double sf) {
 void v2d_tr_translate(v2d_transform_t *tr, v2d_vec_t delta) {
 	tr->add += delta;
 }
+
+v2d_vec_t v2d_vec_cis(double theta) {
+	return cis(theta);
+}
+
+void v2d_tr_rotate_by(v2d_transform_t *tr, v2d_vec_t rot) {
+	tr->mul = v2d_vec_mul(tr->mul, rot);
+	tr->add = v2d_vec_mul(tr->add, rot);
+}
+
+// --- Bulk transformations ---
+
+#ifdef USE_SSE2
+// A vector fits exactly into an SSE register as (x, y), so one complex multiply-add is:
+//  (x, y)*(mx, mx) + (y, x)*(-my, my) + (ax, ay)
+static inline __m128d _transform_sse2(__m128d v, __m128d mre, __m128d mim, __m128d add) {
+	__m128d swapped = _mm_shuffle_pd(v, v, 1);
+	return _mm_add_pd(_mm_add_pd(_mm_mul_pd(v, mre), _mm_mul_pd(swapped, mim)), add);
+}
+
+// Split a transformation into the registers used by _transform_sse2
+static inline void _load_tr_sse2(v2d_transform_t tr, __m128d *mre, __m128d *mim, __m128d *add) {
+	*mre = _mm_set1_pd(v2dvx(tr.mul));
+	*mim = _mm_set_pd(v2dvy(tr.mul), -v2dvy(tr.mul));
+	*add = _mm_loadu_pd(v2d_vec_a(tr.add));
+}
+#endif
+
+void v2d_tr_apply_n(v2d_transform_t tr, v2d_vec_t *out, const v2d_vec_t *in, size_t n) {
+#ifdef USE_SSE2
+	__m128d mre, mim, add;
+	_load_tr_sse2(tr, &mre, &mim, &add);
+	for (size_t i = 0; i < n; i++) {
+		_mm_storeu_pd((double *)(out + i), _transform_sse2(_mm_loadu_pd((const double *)(in + i)), mre, mim, add));
+	}
+#else
+	for (size_t i = 0; i < n; i++) {
+		out[i] = v2d_transform(in[i], tr);
+	}
+#endif
+}
+
+void v2d_tr_apply_soa(v2d_transform_t tr, v2d_real_t *out_x, v2d_real_t *out_y, const v2d_real_t *in_x, const v2d_real_t *in_y, size_t n) {
+	// Written out in full so the compiler can vectorize it
+	const v2d_real_t mx = v2dvx(tr.mul), my = v2dvy(tr.mul);
+	const v2d_real_t ax = v2dvx(tr.add), ay = v2dvy(tr.add);
+	for (size_t i = 0; i < n; i++) {
+		v2d_real_t x = in_x[i], y = in_y[i];
+		out_x[i] = x*mx - y*my + ax;
+		out_y[i] = x*my + y*mx + ay;
+	}
+}
+
+void v2d_tr_apply_each(const v2d_transform_t *trs, v2d_vec_t *out, const v2d_vec_t *in, size_t n) {
+#ifdef USE_SSE2
+	for (size_t i = 0; i < n; i++) {
+		__m128d mre, mim, add;
+		_load_tr_sse2(trs[i], &mre, &mim, &add);
+		_mm_storeu_pd((double *)(out + i), _transform_sse2(_mm_loadu_pd((const double *)(in + i)), mre, mim, add));
+	}
+#else
+	for (size_t i = 0; i < n; i++) {
+		out[i] = v2d_transform(in[i], trs[i]);
+	}
+#endif
+}
+
+// --- Transformation hierarchies ---
+
+size_t v2d_tr_tree_update(struct v2d_tr_node *nodes, size_t n) {
+	size_t count = 0;
+
+	// Parents always come before their children, so a single pass is enough
+	for (size_t i = 0; i < n; i++) {
+		struct v2d_tr_node *node = nodes + i;
+		const struct v2d_tr_node *parent = node->parent < 0 ? NULL : nodes + node->parent;
+
+		node->changed = node->dirty || (parent && parent->changed);
+		if (!node->changed) continue;
+
+		node->world = parent ? v2d_tr_compose(node->local, parent->world) : node->local;
+		node->dirty = false;
+		count++;
+	}
+
+	return count;
+}
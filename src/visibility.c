@@ -0,0 +1,254 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "v2d.h"
+
+#define PI 3.14159265358979323846
+
+void v2d_vis_init(v2d_visibility_t *vis) {
+	*vis = (v2d_visibility_t){0};
+}
+
+void v2d_vis_destroy(v2d_visibility_t *vis) {
+	v2d_free(vis->poly);
+	v2d_free(vis->segs);
+	v2d_free(vis->events);
+	v2d_free(vis->active);
+	*vis = (v2d_visibility_t){0};
+}
+
+void v2d_vis_invalidate(v2d_visibility_t *vis) {
+	vis->valid = false;
+}
+
+// FNV-1a over the bits of a double
+static uint64_t _hash_real(uint64_t h, double x) {
+	unsigned char bytes[sizeof x];
+	memcpy(bytes, &x, sizeof x);
+	for (size_t i = 0; i < sizeof x; i++) {
+		h ^= bytes[i];
+		h *= 0x100000001b3;
+	}
+	return h;
+}
+
+static bool _in_range(v2d_shape_t s, v2d_vec_t origin, double range) {
+	v2d_rect_t b = v2d_shape_bounds(s);
+	return v2dvx(b.pos) <= v2dvx(origin) + range && v2dvx(b.pos) + v2dvx(b.dim) >= v2dvx(origin) - range
+		&& v2dvy(b.pos) <= v2dvy(origin) + range && v2dvy(b.pos) + v2dvy(b.dim) >= v2dvy(origin) - range;
+}
+
+static double _cross(v2d_vec_t a, v2d_vec_t b) {
+	return v2dvx(a)*v2dvy(b) - v2dvy(a)*v2dvx(b);
+}
+
+// Add an edge, given relative to the origin
+static bool _add_segment(v2d_visibility_t *vis, v2d_vec_t a, v2d_vec_t b) {
+	double c = _cross(a, b);
+	// Edges seen side-on from the origin can't block anything
+	if (fabs(c) < 1e-12) return true;
+	if (c < 0) {
+		v2d_vec_t tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	if (!v2d_array_reserve(&vis->segs, &vis->cap_segs, sizeof *vis->segs, vis->n_segs + 1)) return false;
+	vis->segs[vis->n_segs++] = (struct v2d_vis_segment){a, b};
+	return true;
+}
+
+static bool _add_rect(v2d_visibility_t *vis, v2d_vec_t lo, v2d_vec_t hi) {
+	v2d_vec_t p[4] = {
+		lo, v2d_vec(v2dvx(hi), v2dvy(lo)),
+		hi, v2d_vec(v2dvx(lo), v2dvy(hi)),
+	};
+	for (int i = 0; i < 4; i++) {
+		if (!_add_segment(vis, p[i], p[(i+1)%4])) return false;
+	}
+	return true;
+}
+
+static bool _add_circle(v2d_visibility_t *vis, v2d_vec_t center, double rad) {
+	// Use a polygon that surrounds the circle, so anything hidden by the circle stays hidden
+	rad /= cos(PI / V2D_VIS_CIRCLE_SIDES);
+	v2d_vec_t step = v2d_vec_cis(2*PI / V2D_VIS_CIRCLE_SIDES);
+	v2d_vec_t dir = 1, prev = center + rad;
+	for (int i = 0; i < V2D_VIS_CIRCLE_SIDES; i++) {
+		dir = v2d_vec_mul(dir, step);
+		v2d_vec_t cur = center + rad*dir;
+		if (!_add_segment(vis, prev, cur)) return false;
+		prev = cur;
+	}
+	return true;
+}
+
+static int _compare_event(const void *a, const void *b) {
+	const struct v2d_vis_event *ea = a, *eb = b;
+	return (ea->angle > eb->angle) - (ea->angle < eb->angle);
+}
+
+// Distance along a ray in direction `dir` to the line through a segment
+static double _ray_dist(struct v2d_vis_segment seg, v2d_vec_t dir) {
+	v2d_vec_t edge = seg.b - seg.a;
+	double denom = _cross(dir, edge);
+	if (denom == 0) return INFINITY;
+	return _cross(seg.a, edge) / denom;
+}
+
+// Find the active segment nearest the origin in direction `angle`
+static uint32_t _closest(v2d_visibility_t *vis, double angle) {
+	v2d_vec_t dir = v2d_vec_cis(angle);
+	uint32_t best = UINT32_MAX;
+	double best_dist = INFINITY;
+	for (size_t i = 0; i < vis->n_active; i++) {
+		double dist = _ray_dist(vis->segs[vis->active[i]], dir);
+		if (dist >= 0 && dist < best_dist) {
+			best_dist = dist;
+			best = vis->active[i];
+		}
+	}
+	return best;
+}
+
+static bool _emit(v2d_visibility_t *vis, uint32_t seg, double angle) {
+	v2d_vec_t dir = v2d_vec_cis(angle);
+	v2d_vec_t p = vis->origin + _ray_dist(vis->segs[seg], dir) * dir;
+
+	// Skip repeated points where two edges meet at a corner
+	if (vis->n_poly && v2d_vec_mag2(vis->poly[vis->n_poly - 1] - p) < 1e-18) return true;
+
+	if (!v2d_array_reserve(&vis->poly, &vis->cap_poly, sizeof *vis->poly, vis->n_poly + 1)) return false;
+	vis->poly[vis->n_poly++] = p;
+	return true;
+}
+
+static bool _sweep(v2d_visibility_t *vis) {
+	vis->n_poly = 0;
+	vis->n_events = 0;
+	vis->n_active = 0;
+	if (!vis->n_segs) return true;
+
+	if (!v2d_array_reserve(&vis->events, &vis->cap_events, sizeof *vis->events, 2*vis->n_segs)) return false;
+	if (!v2d_array_reserve(&vis->active, &vis->cap_active, sizeof *vis->active, vis->n_segs)) return false;
+
+	for (uint32_t i = 0; i < vis->n_segs; i++) {
+		double begin = carg(vis->segs[i].a), end = carg(vis->segs[i].b);
+		vis->events[vis->n_events++] = (struct v2d_vis_event){begin, i, true};
+		vis->events[vis->n_events++] = (struct v2d_vis_event){end, i, false};
+
+		// Segments crossing the start of the sweep are already active
+		if (begin > end) vis->active[vis->n_active++] = i;
+	}
+	qsort(vis->events, vis->n_events, sizeof *vis->events, _compare_event);
+
+	// The nearest segment can only change at an endpoint, so the segment is found
+	// halfway between consecutive endpoints, away from any ties at corners
+	double first = vis->events[0].angle, last = vis->events[vis->n_events - 1].angle;
+	uint32_t cur = _closest(vis, (first + last - 2*PI) / 2);
+
+	size_t i = 0;
+	while (i < vis->n_events) {
+		double angle = vis->events[i].angle;
+
+		// Apply every event at this angle
+		for (; i < vis->n_events && vis->events[i].angle - angle < 1e-12; i++) {
+			struct v2d_vis_event ev = vis->events[i];
+			if (ev.begin) {
+				vis->active[vis->n_active++] = ev.seg;
+			} else {
+				for (size_t j = 0; j < vis->n_active; j++) {
+					if (vis->active[j] == ev.seg) {
+						vis->active[j] = vis->active[--vis->n_active];
+						break;
+					}
+				}
+			}
+		}
+
+		double next = i < vis->n_events ? vis->events[i].angle : first + 2*PI;
+		uint32_t new = _closest(vis, (angle + next) / 2);
+		if (new != cur) {
+			if (!_emit(vis, cur, angle)) return false;
+			if (!_emit(vis, new, angle)) return false;
+			cur = new;
+		}
+	}
+
+	// The sweep started and ended in the same place, so the last point may repeat the first
+	if (vis->n_poly > 1 && v2d_vec_mag2(vis->poly[0] - vis->poly[vis->n_poly - 1]) < 1e-18) {
+		vis->n_poly--;
+	}
+
+	return true;
+}
+
+bool v2d_vis_compute(v2d_visibility_t *vis, v2d_vec_t origin, double range, const v2d_shape_t *occluders, size_t n) {
+	vis->changed = false;
+
+	// Hash everything that affects the result, so unchanged scenes can reuse the last polygon
+	uint64_t h = 0xcbf29ce484222325;
+	h = _hash_real(h, v2dvx(origin));
+	h = _hash_real(h, v2dvy(origin));
+	h = _hash_real(h, range);
+	for (size_t i = 0; i < n; i++) {
+		if (!_in_range(occluders[i], origin, range)) continue;
+		v2d_rect_t b = v2d_shape_bounds(occluders[i]);
+		h = _hash_real(h, occluders[i].type);
+		h = _hash_real(h, v2dvx(b.pos));
+		h = _hash_real(h, v2dvy(b.pos));
+		h = _hash_real(h, v2dvx(b.dim));
+		h = _hash_real(h, v2dvy(b.dim));
+	}
+	if (vis->valid && vis->hash == h) return true;
+
+	v2d_prof_zone("visibility") {
+		vis->valid = false;
+		vis->origin = origin;
+		vis->range = range;
+		vis->n_segs = 0;
+
+		// The edges of the range bound the polygon when nothing else does
+		bool ok = _add_rect(vis, v2d_vec(-range, -range), v2d_vec(range, range));
+
+		for (size_t i = 0; ok && i < n; i++) {
+			if (!_in_range(occluders[i], origin, range)) continue;
+			switch (occluders[i].type) {
+			case V2D_SHAPE_CIRCLE:
+				ok = _add_circle(vis, occluders[i].s.circle.pos - origin, occluders[i].s.circle.rad);
+				break;
+			case V2D_SHAPE_RECT:;
+				v2d_rect_t b = v2d_shape_bounds(occluders[i]);
+				ok = _add_rect(vis, b.pos - origin, b.pos + b.dim - origin);
+				break;
+			}
+		}
+
+		if (ok) ok = _sweep(vis);
+		if (ok) {
+			vis->valid = true;
+			vis->hash = h;
+			vis->changed = true;
+		} else {
+			vis->n_poly = 0;
+		}
+	}
+
+	return vis->valid;
+}
+
+bool v2d_vis_visible(const v2d_visibility_t *vis, v2d_vec_t p) {
+	// Even-odd rule
+	bool inside = false;
+	double px = v2dvx(p), py = v2dvy(p);
+	for (size_t i = 0, j = vis->n_poly - 1; i < vis->n_poly; j = i++) {
+		double xi = v2dvx(vis->poly[i]), yi = v2dvy(vis->poly[i]);
+		double xj = v2dvx(vis->poly[j]), yj = v2dvy(vis->poly[j]);
+		if ((yi > py) != (yj > py) && px < (xj - xi) * (py - yi) / (yj - yi) + xi) {
+			inside = !inside;
+		}
+	}
+	return inside;
+}
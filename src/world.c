@@ -1,43 +1,538 @@
+#include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "v2d.h"
 
+// How many entity list nodes to allocate at once
+#define NODE_CHUNK 256
+
+// The initial size of the entity index. Must be a power of two
+#define INDEX_MIN 64
+
+// The initial size of the command queue
+#define QUEUE_MIN 32
+
+// Marks a deleted slot in the entity index
+static struct v2d_world_entity_list _tombstone;
+
+// --- Entity index ---
+// This is an open addressing hash table with linear probing, keyed on the entity pointer
+
+static size_t _hash_entity(const v2d_ent_t *ent) {
+	// Fibonacci hashing. The low bits of a pointer are usually zero due to alignment, so shift them out first
+	return (size_t)(((uintptr_t)ent >> 4) * UINT64_C(11400714819323198485) >> 16);
+}
+
+// Find the index slot for an entity. If the entity isn't in the index, returns the slot it would go in
+static struct v2d_world_entity_list **_index_find(const v2d_world_t *world, const v2d_ent_t *ent) {
+	size_t mask = world->index_cap - 1;
+	struct v2d_world_entity_list **free_slot = NULL;
+
+	for (size_t i = _hash_entity(ent) & mask;; i = (i + 1) & mask) {
+		struct v2d_world_entity_list **slot = world->index + i;
+		if (!*slot) return free_slot ? free_slot : slot;
+		if (*slot == &_tombstone) {
+			if (!free_slot) free_slot = slot;
+		} else if ((*slot)->ent == ent) {
+			return slot;
+		}
+	}
+}
+
+// Resize the index, also clearing out any tombstones
+static bool _index_resize(v2d_world_t *world, size_t cap) {
+	struct v2d_world_entity_list **old = world->index;
+	size_t old_cap = world->index_cap;
+
+	world->index = v2d_alloc(cap * sizeof *world->index);
+	if (!world->index) {
+		world->index = old;
+		return false;
+	}
+	memset(world->index, 0, cap * sizeof *world->index);
+	world->index_cap = cap;
+	world->index_used = 0;
+
+	for (size_t i = 0; i < old_cap; i++) {
+		if (!old[i] || old[i] == &_tombstone) continue;
+		*_index_find(world, old[i]->ent) = old[i];
+		world->index_used++;
+	}
+
+	v2d_free(old);
+	return true;
+}
+
+// --- Sleeping ---
+
+static void _awake_link_to(v2d_world_t *world, struct v2d_world_entity_list *node, size_t list) {
+	node->list = list;
+	world->awake_count[list]++;
+
+	// Awake entities are added at the front, so one woken while its list is being updated won't be updated until the next tick
+	node->awake = true;
+	node->awake_prev = NULL;
+	node->awake_next = world->awake[list];
+	if (node->awake_next) node->awake_next->awake_prev = node;
+	world->awake[list] = node;
+}
+
+static void _awake_link(v2d_world_t *world, struct v2d_world_entity_list *node) {
+	// Stagger the bucket's entities by putting this one on the tick of the cycle with the fewest
+	size_t first = ((size_t)1 << node->lod) - 1, list = first;
+	for (size_t i = first + 1; i < first + ((size_t)1 << node->lod); i++) {
+		if (world->awake_count[i] < world->awake_count[list]) list = i;
+	}
+	_awake_link_to(world, node, list);
+}
+
+static void _awake_unlink(v2d_world_t *world, struct v2d_world_entity_list *node) {
+	if (!node->awake) return;
+	node->awake = false;
+	world->awake_count[node->list]--;
+	if (world->awake_cursor == node) world->awake_cursor = node->awake_next;
+	if (node->awake_prev) node->awake_prev->awake_next = node->awake_next;
+	else world->awake[node->list] = node->awake_next;
+	if (node->awake_next) node->awake_next->awake_prev = node->awake_prev;
+}
+
+// Timers that fire together do so in no particular order, so the entities they wake are linked afterwards by v2d_world_advance_timers
+static void _wake(v2d_timer_t *timer, void *data) {
+	v2d_world_t *world = data;
+	struct v2d_world_entity_list *node = (void *)((char *)timer - offsetof(struct v2d_world_entity_list, wake));
+	if (!v2d_array_reserve(&world->woken, &world->cap_woken, sizeof *world->woken, world->n_woken + 1)) {
+		_awake_link(world, node);
+		return;
+	}
+	node->waking = true;
+	world->woken[world->n_woken++] = node;
+}
+
+// Take a node out of the woken list, if it's waiting there
+static void _cancel_wake(v2d_world_t *world, struct v2d_world_entity_list *node) {
+	if (!node->waking) return;
+	node->waking = false;
+	for (size_t i = 0; i < world->n_woken; i++) {
+		if (world->woken[i] == node) world->woken[i] = NULL;
+	}
+}
+
+static int _compare_seq(const void *a, const void *b) {
+	const struct v2d_world_entity_list *x = *(void *const *)a, *y = *(void *const *)b;
+	return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+void v2d_world_advance_timers(v2d_world_t *world, double seconds) {
+	v2d_timer_advance(&world->timers, seconds);
+
+	size_t n = 0;
+	for (size_t i = 0; i < world->n_woken; i++) {
+		if (world->woken[i]) world->woken[n++] = world->woken[i];
+	}
+	world->n_woken = 0;
+	if (n) qsort(world->woken, n, sizeof *world->woken, _compare_seq);
+
+	for (size_t i = 0; i < n; i++) {
+		world->woken[i]->waking = false;
+		_awake_link(world, world->woken[i]);
+	}
+}
+
+static struct v2d_world_entity_list *_find_node(const v2d_world_t *world, const v2d_ent_t *entity) {
+	struct v2d_world_entity_list *node = *_index_find(world, entity);
+	return node == &_tombstone ? NULL : node;
+}
+
+bool v2d_world_sleep(v2d_world_t *world, v2d_ent_t *entity, double seconds) {
+	struct v2d_world_entity_list *node = _find_node(world, entity);
+	if (!node) return false;
+
+	_awake_unlink(world, node);
+	_cancel_wake(world, node);
+	if (isinf(seconds)) v2d_timer_stop(&world->timers, &node->wake);
+	else v2d_timer_start(&world->timers, &node->wake, seconds);
+	return true;
+}
+
+bool v2d_world_wake(v2d_world_t *world, v2d_ent_t *entity) {
+	struct v2d_world_entity_list *node = _find_node(world, entity);
+	if (!node) return false;
+	if (node->awake || node->waking) return true;
+
+	v2d_timer_stop(&world->timers, &node->wake);
+	_awake_link(world, node);
+	return true;
+}
+
+bool v2d_world_awake(const v2d_world_t *world, const v2d_ent_t *entity) {
+	struct v2d_world_entity_list *node = _find_node(world, entity);
+	return node && node->awake;
+}
+
+// --- Update frequency ---
+
+static void _set_lod(v2d_world_t *world, struct v2d_world_entity_list *node, unsigned lod) {
+	if (lod >= V2D_WORLD_LOD_BUCKETS) lod = V2D_WORLD_LOD_BUCKETS - 1;
+	if (node->lod == lod) return;
+
+	// Only awake entities are in a list. Sleeping ones will be put in the right one when they wake
+	bool awake = node->awake;
+	_awake_unlink(world, node);
+	node->lod = lod;
+	if (awake) _awake_link(world, node);
+}
+
+bool v2d_world_set_lod(v2d_world_t *world, v2d_ent_t *entity, unsigned lod) {
+	struct v2d_world_entity_list *node = _find_node(world, entity);
+	if (!node) return false;
+	_set_lod(world, node, lod);
+	return true;
+}
+
+void v2d_world_lod_camera(v2d_world_t *world, v2d_transform_t camera, const struct v2d_world_lod_config *conf) {
+	v2d_prof_zone("lod") for (struct v2d_world_entity_list *l = world->entities; l; l = l->next) {
+		v2d_vec_t pos;
+		if (!conf->pos(l->ent, &pos, conf->ctx)) continue;
+
+		// Compare squared distances to avoid a square root per entity
+		double dist2 = v2d_vec_mag2(v2d_transform(pos, camera));
+		unsigned lod = 0;
+		while (lod < V2D_WORLD_LOD_BUCKETS - 1 && dist2 > conf->distance[lod] * conf->distance[lod]) lod++;
+		_set_lod(world, l, lod);
+	}
+}
+
+// --- Layers ---
+
+bool v2d_world_set_layer(v2d_world_t *world, v2d_ent_t *entity, unsigned layer) {
+	struct v2d_world_entity_list *node = _find_node(world, entity);
+	if (!node || layer >= V2D_WORLD_LAYERS) return false;
+	world->layer_count[node->layer]--;
+	world->layer_count[layer]++;
+	node->layer = layer;
+	return true;
+}
+
+// --- Spatial queries ---
+
+bool v2d_world_set_shape(v2d_world_t *world, v2d_ent_t *entity, v2d_shape_t shape) {
+	struct v2d_world_entity_list *node = _find_node(world, entity);
+	if (!node) return false;
+
+	if (node->proxy != V2D_PROXY_NONE) {
+		v2d_broad_move(&world->spatial, node->proxy, shape);
+		return true;
+	}
+
+	node->proxy = v2d_broad_add(&world->spatial, shape, entity);
+	if (node->proxy == V2D_PROXY_NONE) return false;
+	// Queries only look at what entities are, not what they do, so none of them count as active pairs
+	v2d_broad_set_active(&world->spatial, node->proxy, false);
+	return true;
+}
+
+static void _clear_shape(v2d_world_t *world, struct v2d_world_entity_list *node) {
+	if (node->proxy == V2D_PROXY_NONE) return;
+	v2d_broad_del(&world->spatial, node->proxy);
+	node->proxy = V2D_PROXY_NONE;
+}
+
+void v2d_world_clear_shape(v2d_world_t *world, v2d_ent_t *entity) {
+	struct v2d_world_entity_list *node = _find_node(world, entity);
+	if (node) _clear_shape(world, node);
+}
+
+bool v2d_world_set_filter(v2d_world_t *world, v2d_ent_t *entity, v2d_filter_t filter) {
+	struct v2d_world_entity_list *node = _find_node(world, entity);
+	if (!node || node->proxy == V2D_PROXY_NONE) return false;
+	v2d_broad_set_filter(&world->spatial, node->proxy, filter);
+	return true;
+}
+
+struct _query_ctx {
+	v2d_ent_t **out;
+	size_t max_out, n;
+	v2d_shape_t shape;
+};
+
+static bool _query_add(v2d_broad_t *broad, uint32_t id, void *ctx) {
+	struct _query_ctx *q = ctx;
+	const struct v2d_broad_proxy *p = broad->proxies + id;
+	if (!v2d_collide_shape_shape(p->shape, q->shape)) return true;
+
+	if (q->n < q->max_out) q->out[q->n] = p->data;
+	q->n++;
+	return true;
+}
+
+size_t v2d_world_query_rect(v2d_world_t *world, v2d_rect_t rect, const v2d_filter_t *filter, v2d_ent_t **out, size_t max_out) {
+	v2d_rect_t bounds = v2d_shape_bounds(V2D_SHAPE_RECT_LIT(rect.pos, rect.dim));
+	struct _query_ctx q = {out, max_out, 0, V2D_SHAPE_RECT_LIT(bounds.pos, bounds.dim)};
+	v2d_broad_visit(&world->spatial, bounds.pos, bounds.pos + bounds.dim, filter, _query_add, &q);
+	return q.n;
+}
+
+size_t v2d_world_query_radius(v2d_world_t *world, v2d_vec_t center, double radius, const v2d_filter_t *filter, v2d_ent_t **out, size_t max_out) {
+	struct _query_ctx q = {out, max_out, 0, V2D_SHAPE_CIRCLE_LIT(center, radius)};
+	v2d_vec_t r = v2d_vec(radius, radius);
+	v2d_broad_visit(&world->spatial, center - r, center + r, filter, _query_add, &q);
+	return q.n;
+}
+
+size_t v2d_world_nearest(v2d_world_t *world, v2d_vec_t point, double max_dist, const v2d_filter_t *filter, size_t k, v2d_ent_t **out, double *dist) {
+	return v2d_broad_nearest(&world->spatial, point, max_dist, filter, k, NULL, out, dist);
+}
+
+v2d_ent_t *v2d_world_raycast(v2d_world_t *world, v2d_ray_t ray, const v2d_filter_t *filter, double *t) {
+	uint32_t id = v2d_broad_raycast(&world->spatial, ray, filter, t);
+	return id == V2D_PROXY_NONE ? NULL : world->spatial.proxies[id].data;
+}
+
+// --- Worlds ---
+
 v2d_world_t *v2d_world_new(void) {
-	v2d_world_t *world = malloc(sizeof *world);
+	v2d_world_t *world = v2d_alloc(sizeof *world);
+	if (!world) return NULL;
+
 	world->entities = NULL;
+	v2d_pool_init(&world->nodes, sizeof *world->entities, NODE_CHUNK);
+
+	world->index = NULL;
+	world->index_cap = world->index_used = 0;
+	if (!_index_resize(world, INDEX_MIN)) {
+		v2d_free(world);
+		return NULL;
+	}
+
+	world->queue = NULL;
+	world->queue_len = world->queue_cap = 0;
+
+	memset(world->awake, 0, sizeof world->awake);
+	memset(world->awake_count, 0, sizeof world->awake_count);
+	world->awake_cursor = NULL;
+	memset(world->layer_count, 0, sizeof world->layer_count);
+	world->ticks = 0;
+	world->time = 0;
+	world->next_seq = 0;
+	world->woken = NULL;
+	world->n_woken = world->cap_woken = 0;
+	v2d_timer_wheel_init(&world->timers, V2D_WORLD_TIMER_RESOLUTION);
+	v2d_broad_init(&world->spatial);
+
 	return world;
 }
 
+// Destroy an entity if the world owns it
+static void _release_entity(struct v2d_world_entity_list *node) {
+	if (!node->pool) return;
+	if (node->ent->destroy) node->ent->destroy(node->ent);
+	v2d_pool_free(node->pool, node->ent);
+}
+
 void v2d_world_free(v2d_world_t *world) {
 	if (!world) return;
 
 	struct v2d_world_entity_list *l = world->entities;
-	while (l) {
-		struct v2d_world_entity_list *next = l->next;
-		if (l->ent->destroy) l->ent->destroy(l->ent);
-		free(l);
-		l = next;
+	for (; l; l = l->next) {
+		if (l->pool) _release_entity(l);
+		else if (l->ent->destroy) l->ent->destroy(l->ent);
 	}
+
+	// Every node came from the pool, so they can all be freed at once
+	v2d_pool_destroy(&world->nodes);
+	v2d_free(world->index);
+	v2d_free(world->queue);
+	v2d_free(world->woken);
+	v2d_broad_destroy(&world->spatial);
+	v2d_free(world);
 }
 
-void v2d_world_add_entity(v2d_world_t *world, v2d_ent_t *entity) {
-	struct v2d_world_entity_list *head = world->entities;
-	world->entities = malloc(sizeof *world->entities);
-	world->entities->ent = entity;
-	world->entities->next = head;
+bool v2d_world_add_pooled(v2d_world_t *world, v2d_ent_t *entity, v2d_pool_t *pool) {
+	// Keep the load factor, including tombstones, below 1/2
+	if (2 * (world->index_used + 1) > world->index_cap) {
+		// If the index is mostly tombstones, rehashing at the same size is enough
+		size_t cap = world->index_cap;
+		size_t live = 0;
+		for (size_t i = 0; i < cap; i++) live += world->index[i] && world->index[i] != &_tombstone;
+		if (4 * (live + 1) > cap) cap *= 2;
+		if (!_index_resize(world, cap)) return false;
+	}
+
+	struct v2d_world_entity_list **slot = _index_find(world, entity);
+	if (*slot && *slot != &_tombstone) return true; // Already in the world
+
+	struct v2d_world_entity_list *node = v2d_pool_alloc(&world->nodes);
+	if (!node) return false;
+	node->ent = entity;
+	node->pool = pool;
+	node->prev = NULL;
+	node->next = world->entities;
+	if (node->next) node->next->prev = node;
+	world->entities = node;
+
+	v2d_timer_init(&node->wake, _wake, world);
+	node->waking = false;
+	node->seq = world->next_seq++;
+	node->lod = 0;
+	node->updated = world->time;
+	node->layer = 0;
+	world->layer_count[0]++;
+	node->proxy = V2D_PROXY_NONE;
+	_awake_link(world, node);
+
+	if (!*slot) world->index_used++;
+	*slot = node;
+	return true;
+}
+
+bool v2d_world_add_entity(v2d_world_t *world, v2d_ent_t *entity) {
+	return v2d_world_add_pooled(world, entity, NULL);
 }
 
-_Bool v2d_world_del_entity(v2d_world_t *world, v2d_ent_t *entity) {
-	struct v2d_world_entity_list *l = world->entities, *prev = NULL;
-	while (l) {
-		if (l->ent == entity) {
-			if (prev) {
-				prev->next = l->next;
-			} else {
-				world->entities = l->next;
+bool v2d_world_del_entity(v2d_world_t *world, v2d_ent_t *entity) {
+	struct v2d_world_entity_list **slot = _index_find(world, entity);
+	struct v2d_world_entity_list *node = *slot;
+	if (!node || node == &_tombstone) return false;
+	*slot = &_tombstone;
+
+	if (node->prev) node->prev->next = node->next;
+	else world->entities = node->next;
+	if (node->next) node->next->prev = node->prev;
+
+	_awake_unlink(world, node);
+	_cancel_wake(world, node);
+	v2d_timer_stop(&world->timers, &node->wake);
+	_clear_shape(world, node);
+	world->layer_count[node->layer]--;
+
+	_release_entity(node);
+	v2d_pool_free(&world->nodes, node);
+	return true;
+}
+
+void v2d_world_clear_saved(v2d_world_t *world) {
+	struct v2d_world_entity_list *l = world->entities, *next;
+	for (; l; l = next) {
+		next = l->next;
+		v2d_ent_cb_t *ent = l->ent;
+		if (!ent->type) continue;
+
+		// Pooled entities are destroyed by v2d_world_del_entity, but others must be destroyed here
+		bool pooled = l->pool != NULL;
+		v2d_world_del_entity(world, ent);
+		if (!pooled && ent->destroy) ent->destroy(ent);
+	}
+}
+
+// --- Saving ---
+
+void v2d_world_get_clock(const v2d_world_t *world, struct v2d_world_clock *clock) {
+	*clock = (struct v2d_world_clock){
+		.ticks = world->ticks,
+		.time = world->time,
+		.timer_now = world->timers.now,
+		.timer_accumulator = world->timers.accumulator,
+		.next_seq = world->next_seq,
+	};
+}
+
+void v2d_world_set_clock(v2d_world_t *world, const struct v2d_world_clock *clock) {
+	world->ticks = clock->ticks;
+	world->time = clock->time;
+	world->next_seq = clock->next_seq;
+
+	// Timers still pending, such as those of entities that aren't saved, keep the time they had left
+	v2d_timer_set_now(&world->timers, clock->timer_now);
+	world->timers.accumulator = clock->timer_accumulator;
+
+	// Entities that stay in the world mustn't have been updated in the future
+	for (struct v2d_world_entity_list *l = world->entities; l; l = l->next) {
+		if (l->updated > world->time) l->updated = world->time;
+	}
+}
+
+bool v2d_world_get_schedule(const v2d_world_t *world, const v2d_ent_t *entity, struct v2d_world_schedule *sched) {
+	const struct v2d_world_entity_list *node = _find_node(world, entity);
+	if (!node) return false;
+
+	*sched = (struct v2d_world_schedule){
+		.seq = node->seq,
+		.wake = v2d_timer_pending(&node->wake) ? node->wake.when - world->timers.now : 0,
+		.updated = node->updated,
+		.awake = node->awake || node->waking,
+		.lod = node->lod,
+		.list = node->list,
+		.layer = node->layer,
+	};
+	return true;
+}
+
+bool v2d_world_set_schedule(v2d_world_t *world, v2d_ent_t *entity, const struct v2d_world_schedule *sched) {
+	struct v2d_world_entity_list *node = _find_node(world, entity);
+	if (!node || sched->lod >= V2D_WORLD_LOD_BUCKETS || sched->layer >= V2D_WORLD_LAYERS) return false;
+
+	size_t first = ((size_t)1 << sched->lod) - 1;
+	if (sched->awake && (sched->list < first || sched->list >= first + ((size_t)1 << sched->lod))) return false;
+
+	_awake_unlink(world, node);
+	_cancel_wake(world, node);
+	v2d_timer_stop(&world->timers, &node->wake);
+
+	node->seq = sched->seq;
+	node->updated = sched->updated;
+	node->lod = sched->lod;
+	world->layer_count[node->layer]--;
+	world->layer_count[sched->layer]++;
+	node->layer = sched->layer;
+
+	if (sched->awake) _awake_link_to(world, node, sched->list);
+	else if (sched->wake) v2d_timer_start_ticks(&world->timers, &node->wake, sched->wake);
+	return true;
+}
+
+// --- Deferred changes ---
+
+static bool _queue_push(v2d_world_t *world, struct v2d_world_command cmd) {
+	if (world->queue_len == world->queue_cap) {
+		size_t cap = world->queue_cap ? world->queue_cap * 2 : QUEUE_MIN;
+		struct v2d_world_command *queue = v2d_alloc(cap * sizeof *queue);
+		if (!queue) return false;
+		if (world->queue) memcpy(queue, world->queue, world->queue_len * sizeof *queue);
+		v2d_free(world->queue);
+		world->queue = queue;
+		world->queue_cap = cap;
+	}
+
+	world->queue[world->queue_len++] = cmd;
+	return true;
+}
+
+bool v2d_world_defer_add(v2d_world_t *world, v2d_ent_t *entity, v2d_pool_t *pool) {
+	return _queue_push(world, (struct v2d_world_command){V2D_WORLD_CMD_ADD, entity, pool});
+}
+
+bool v2d_world_defer_del(v2d_world_t *world, v2d_ent_t *entity) {
+	return _queue_push(world, (struct v2d_world_command){V2D_WORLD_CMD_DEL, entity, NULL});
+}
+
+void v2d_world_flush(v2d_world_t *world) {
+	// Destructors may queue more changes, so the length must be re-read every iteration
+	for (size_t i = 0; i < world->queue_len; i++) {
+		struct v2d_world_command cmd = world->queue[i];
+		switch (cmd.type) {
+		case V2D_WORLD_CMD_ADD:
+			if (!v2d_world_add_pooled(world, cmd.ent, cmd.pool)) {
+				v2d_warn("failed to add deferred entity %p", cmd.ent);
 			}
-			free(l);
-			return true;
+			break;
+
+		case V2D_WORLD_CMD_DEL:
+			v2d_world_del_entity(world, cmd.ent);
+			break;
 		}
 	}
-	return false;
+	world->queue_len = 0;
 }